@@ -8,7 +8,12 @@
 #undef NELEMENTS
 #endif
 
+#ifdef _MSC_VER
 typedef unsigned __int64 NvU64;
+#else
+typedef unsigned long long NvU64;
+#define __debugbreak() __builtin_trap()
+#endif
 typedef unsigned NvU32;
 typedef unsigned short NvU16;
 
@@ -54,7 +59,8 @@ inline void nvAssert(T condition)
 // make n steps to the right from f
 inline float next_float(float f, NvU32 n = 1)
 {
-    NvU32 &fi = (NvU32 &)f;
+    NvU32 fi;
+    memcpy(&fi, &f, sizeof(fi));
     NvU32 fiNext;
     if (fi & 0x80000000)
     {
@@ -66,24 +72,21 @@ inline float next_float(float f, NvU32 n = 1)
         if (!(fiNext & 0x7f800000))
             fiNext |= 0x800000;
     }
+    float fNext;
+    memcpy(&fNext, &fiNext, sizeof(fNext));
 #if ASSERT_ONLY_CODE
-    float &fNext = (float &)fiNext;
     nvAssert(isnormal(fNext) && fNext > f);
 #endif
-    return (float &)fiNext;
+    return fNext;
 }
 // make n steps to the left from f
 inline float prev_float(float f, unsigned n = 1)
 {
+    unsigned fi;
+    memcpy(&fi, &f, sizeof(fi));
+    fi = f > 0 ? fi - n : fi + n;
     float fPrev;
-    if (f > 0)
-    {
-        (unsigned &)fPrev = (unsigned &)f - n;
-    }
-    else
-    {
-        (unsigned &)fPrev = (unsigned &)f + n;
-    }
+    memcpy(&fPrev, &fi, sizeof(fPrev));
     nvAssert(isnormal(fPrev) && fPrev < f);
     return fPrev;
 }
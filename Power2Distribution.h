@@ -1,6 +1,7 @@
 #pragma once
 
 #include "MyMisc.h"
+#include "simd.h"
 #include <algorithm>
 
 // generates power-of-two distribution around fMaxPDFLocation. it works like this: divide distance between 0
@@ -13,73 +14,6 @@ struct Power2Distribution
     static const NvU32 MAX_LEFT_EXPONENT = 5;
     static const NvU32 MAX_RIGHT_EXPONENT = 8;
 
-#if ASSERT_ONLY_CODE
-    // the integral from this function must be equal to 30 / 2 + 120 / 2 = 75
-    static double dbgF(double x)
-    {
-        if (x < 1) return 0;
-        if (x < 31) return (x - 1) / (31 - 1);
-        if (x < 151) return (151 - x) / (151 - 31);
-        return 0;
-    }
-    static bool dbgDoesTestPass()
-    {
-        // use generate() function to compute integral of function dbgF
-        double fMin[2] = { 1e38, 1e38 };
-        double fMax[2] = { -1e38, -1e38 };
-        double fPrevValue = 0, fPrevPrevValue = 0;
-        double fSum[2] = { 0, 0 };
-        double fWeightsSum[2] = { 0, 0 };
-        const NvU32 nSamples = 1024 * 16;
-        for (NvU32 u = 0; u < nSamples; ++u)
-        {
-            const double f01Number = u / (double)(nSamples - 1);
-            // uniform sampling
-            {
-                double fWeight = 1;
-                double fValue = f01Number * 152;
-
-                fMin[0] = std::min(fMin[0], fValue);
-                fMax[0] = std::max(fMax[0], fValue);
-                fSum[0] += dbgF(fValue) * fWeight;
-                fWeightsSum[0] += fWeight;
-            }
-            // fancy sampling
-            {
-                double fWeight;
-                double fValue = generate(f01Number, 31, fWeight);
-
-                bool isOnTheRight = fValue > 31;
-
-                if (fPrevPrevValue != 0)
-                {
-                    // as we go from left to right, distance between values decreases when we reach the middle and start increasing afterwards
-                    if (isOnTheRight)
-                    {
-                        nvAssert(fValue - fPrevValue >= (fPrevValue - fPrevPrevValue) / 1.1);
-                        nvAssert(fValue - fPrevValue <= (fPrevValue - fPrevPrevValue) * 2.1);
-                    }
-                    else
-                    {
-                        nvAssert(fValue - fPrevValue <= (fPrevValue - fPrevPrevValue) * 1.1);
-                        nvAssert(fValue - fPrevValue >= (fPrevValue - fPrevPrevValue) / 2.1);
-                    }
-                }
-                fPrevPrevValue = fPrevValue;
-                fPrevValue = fValue;
-
-                fMin[1] = std::min(fMin[1], fValue);
-                fMax[1] = std::max(fMax[1], fValue);
-                fSum[1] += dbgF(fValue) * fWeight;
-                fWeightsSum[1] += fWeight;
-            }
-        }
-        double fFinalValue[2] = { fSum[0] / fWeightsSum[0] * (fMax[0] - fMin[0]), fSum[1] / fWeightsSum[1] * (fMax[1] - fMin[1]) };
-        // fancy sampling comes out less presize than uniform one, but i hope it will work better for action-related functions
-        return abs(fFinalValue[0] - 75) < 0.01 && abs(fFinalValue[1] - 75) < 0.03;
-    }
-#endif
-
     static double generate(double fIn01Number, double fMaxPDFLocation, double& fOutWeight)
     {
         double fSmallestIntervalSize = fMaxPDFLocation / (1 << MAX_LEFT_EXPONENT);
@@ -107,4 +41,44 @@ struct Power2Distribution
         fOutWeight = (1 << uExponent);
         return fMaxPDFLocation + fSmallestIntervalSize * ((1 << uExponent) * (fIn01Number + 1) - 1);
     }
+
+    // generate() for n numbers at once. the same arithmetic, but both sides are computed and the needed one is
+    // selected, so there are no branches and it vectorizes. results are the same as the ones of scalar generate()
+    static void generate(const double* pIn01Numbers, double* pOut, double* pOutWeights, size_t n, double fMaxPDFLocation,
+        SimdLevel simdLevel = getMaxSimdLevel())
+    {
+        BatchKernel kernel = { pIn01Numbers, pOut, pOutWeights, fMaxPDFLocation };
+        simdFor(simdLevel, n, kernel);
+    }
+    // one vector of the batch - for kernels where every lane has its own fMaxPDFLocation
+    template <class V>
+    static V generate(V fIn01Number, V fMaxPDFLocation, V& fOutWeight)
+    {
+        const double fSplit = MAX_LEFT_EXPONENT / (double)(MAX_LEFT_EXPONENT + MAX_RIGHT_EXPONENT);
+        typename V::Mask isLeft = fIn01Number < V(fSplit);
+        V fLeftExponent = (V(1.) - fIn01Number / V(fSplit)) * V((double)MAX_LEFT_EXPONENT);
+        V fRightExponent = ((fIn01Number - V(fSplit)) / V(1 - fSplit)) * V((double)MAX_RIGHT_EXPONENT);
+        V fExponent = select(isLeft, fLeftExponent, fRightExponent);
+        V fExponentLimit = select(isLeft, V(MAX_LEFT_EXPONENT - 1.), V(MAX_RIGHT_EXPONENT - 1.));
+        V fIntExponent = min(floor(fExponent), fExponentLimit);
+        fOutWeight = V::pow2(fIntExponent);
+        V fSmallestIntervalSize = fMaxPDFLocation / V((double)(1 << MAX_LEFT_EXPONENT));
+        fSmallestIntervalSize = select(isLeft, V(0.) - fSmallestIntervalSize, fSmallestIntervalSize);
+        return fMaxPDFLocation + fSmallestIntervalSize * (fOutWeight * (fExponent - fIntExponent + V(1.)) - V(1.));
+    }
+
+private:
+    struct BatchKernel
+    {
+        template <class V>
+        void run(size_t u)
+        {
+            V fWeight;
+            generate(V::load(m_pIn01Numbers + u), V(m_fMaxPDFLocation), fWeight).store(m_pOut + u);
+            fWeight.store(m_pOutWeights + u);
+        }
+        const double* m_pIn01Numbers;
+        double* m_pOut, * m_pOutWeights;
+        double m_fMaxPDFLocation;
+    };
 };
\ No newline at end of file
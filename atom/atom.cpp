@@ -9,16 +9,55 @@
 #include <easy3d/util/logging.h>
 #include <easy3d/util/file_system.h>
 #include "../wave.h"
-#include "../Power2Distribution.h"
+#include "../frameStream.h"
+#include "../simulationThread.h"
 
 using namespace easy3d;
 
 struct MyModel : public Model
 {
-    MyModel()
+    // with sReplayPath frames written by the batch driver are shown instead of running the simulation. otherwise
+    // the simulation runs on its own thread and the viewer shows whatever step it has published last
+    MyModel(const char* sReplayPath)
     {
-        m_world.initialize();
-        m_world.readPoints((std::vector<float3>&)m_points);
+        if (sReplayPath)
+        {
+            m_isReplaying = m_reader.open(sReplayPath);
+            nvRelAssert(m_isReplaying);
+            m_reader.readFrame(m_frame);
+        }
+        else
+        {
+            m_world.initialize();
+            // so that there is something to show (and a bounding box) before the first step is published
+            collectFrame(m_world, m_frame);
+            m_topologyVersion = m_world.accessStorage().getTopologyVersion();
+            m_simulation.start(m_world);
+        }
+        setPoints(m_frame);
+    }
+    // returns true if any points have changed since the previous call. never waits for the simulation
+    bool updatePoints()
+    {
+        if (m_isReplaying)
+        {
+            // the last frame stays on the screen
+            if (!m_reader.readFrame(m_frame))
+                return false;
+            setPoints(m_frame);
+            return true;
+        }
+        if (!m_simulation.acquireSnapshot())
+            return false;
+        // boxes only change on split and merge. the simulation thread keeps the lines up to date as they change, here
+        // they are only copied for the upload
+        const SimulationSnapshot& snapshot = m_simulation.getSnapshot();
+        if (snapshot.m_topologyVersion == m_topologyVersion)
+            return false;
+        m_topologyVersion = snapshot.m_topologyVersion;
+        m_points.resize(snapshot.m_points.size());
+        memcpy(m_points.data(), snapshot.m_points.data(), snapshot.m_points.size() * sizeof(float3));
+        return true;
     }
 
     virtual std::vector<vec3>& points() override
@@ -34,33 +73,56 @@ struct MyModel : public Model
     {
         nvAssert(false);
     }
-    void makeSimulationStep() { m_world.makeSimulationStep(); }
 
 private:
+    void setPoints(const Frame& frame)
+    {
+        m_points.resize(frame.m_boxes.size() * 6);
+        for (size_t u = 0; u < frame.m_boxes.size(); ++u)
+        {
+            getBoxLines(frame.m_boxes[u], (float3*)&m_points[u * 6]);
+        }
+    }
+
     std::vector<vec3> m_points;
     World m_world;
+    // declared after m_world - stops the thread before the world goes away
+    SimulationThread m_simulation;
+    NvU32 m_topologyVersion = 0;
+    FrameReader m_reader;
+    Frame m_frame;
+    bool m_isReplaying = false;
 };
 
 struct MyViewer : public Viewer
 {
     MyViewer(const char* sName, MyModel *pModel) : Viewer(sName), m_pModel(pModel) { }
+    void setDrawable(LinesDrawable* pDrawable) { m_pDrawable = pDrawable; }
     virtual void pre_draw()
     {
-        m_pModel->makeSimulationStep();
+        // the buffer is uploaded as a whole, but only on frames where the tree has changed
+        if (m_pModel->updatePoints() && m_pDrawable)
+        {
+            m_pDrawable->update_vertex_buffer(m_pModel->points());
+        }
         Viewer::pre_draw();
     }
 
 private:
     MyModel* m_pModel;
+    LinesDrawable* m_pDrawable = nullptr;
 };
 
+// usage: atom [-replay <file written by batch -out>]
 int main(int argc, char** argv)
 {
-    nvAssert(Power2Distribution::dbgDoesTestPass());
-
     // initialize logging
     logging::initialize();
 
+    // before the current directory changes - replay path may be relative
+    const char* sReplayPath = argc > 2 && strcmp(argv[1], "-replay") == 0 ? argv[2] : nullptr;
+    MyModel* pMyModel = new MyModel(sReplayPath);
+
     // find directory with resources
     std::string dir = file_system::executable_directory();
     for (; ; )
@@ -73,8 +135,6 @@ int main(int argc, char** argv)
         dir = file_system::parent_directory(dir);
     }
 
-    MyModel* pMyModel = new MyModel;
-
     // Create the default Easy3D viewer.
     // Note: a viewer must be created before creating any drawables.
     MyViewer viewer("atom", pMyModel);
@@ -91,6 +151,7 @@ int main(int argc, char** argv)
     auto drawable = pMyModel->renderer()->add_lines_drawable("normals");
     // Upload the data to the GPU.
     drawable->update_vertex_buffer(pMyModel->points());
+    viewer.setDrawable(drawable);
 
     // We will draw the normal vectors in a uniform green color
     drawable->set_uniform_coloring(vec4(1.0f, 0.0f, 0.0f, 1.0f));
@@ -0,0 +1,209 @@
+#define _CRT_SECURE_NO_WARNINGS // fopen() is fine here
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../wave.h"
+#include "../frameStream.h"
+#include "../multiProcess.h"
+
+// headless driver: no viewer and nothing platform specific, so it runs on compute nodes. frames written with
+// -out can be replayed with "atom -replay <file>"
+static void printUsage()
+{
+	printf("usage: batch [options]\n"
+		"  -depth N      initial depth of the tree (3)\n"
+		"  -roots N      tile the domain into N x N x N roots, each of the given depth (1)\n"
+		"  -linear       use LinearStorage instead of Storage\n"
+		"  -load FILE    start from a snapshot instead of initialize()\n"
+		"  -steps N      number of simulation steps (100)\n"
+		"  -threads N    number of threads (1)\n"
+		"  -processes N  split the roots between N local processes, -threads is per process (1). only -depth, -roots,\n"
+		"                -steps and -threads can be used with it\n"
+		"  -seed N       seed of path sampling random numbers (0)\n"
+		"  -out FILE     write leaves of every step to FILE\n"
+		"  -every N      only write every N-th step (1)\n"
+		"  -chunk N      frames per compressed chunk (16)\n"
+		"  -save FILE    write a snapshot after the last step\n"
+		"  -stats FILE   write counters and timers of every step to FILE, one JSON object per line\n"
+		"  -trace FILE   record a timeline of the steps and write it to FILE for chrome://tracing or Perfetto\n");
+}
+
+struct Options
+{
+	NvU32 depth = 3, nRootsPerDim = 1, nSteps = 100, nThreads = 1, nProcesses = 1, writeEvery = 1, nFramesPerChunk = 16;
+	NvU64 seed = 0;
+	bool isLinear = false;
+	const char* sLoadPath = nullptr;
+	const char* sOutPath = nullptr;
+	const char* sSavePath = nullptr;
+	const char* sStatsPath = nullptr;
+	const char* sTracePath = nullptr;
+};
+
+static bool parseOptions(int argc, char** argv, Options& options)
+{
+	for (int i = 1; i < argc; ++i)
+	{
+		const char* sArg = argv[i];
+		const char* sValue = i + 1 < argc ? argv[i + 1] : nullptr;
+		if (strcmp(sArg, "-linear") == 0)
+		{
+			options.isLinear = true;
+			continue;
+		}
+		if (!sValue)
+			return false;
+		++i;
+		if (strcmp(sArg, "-depth") == 0) options.depth = (NvU32)atoi(sValue);
+		else if (strcmp(sArg, "-roots") == 0) options.nRootsPerDim = mymax(1, atoi(sValue));
+		else if (strcmp(sArg, "-steps") == 0) options.nSteps = (NvU32)atoi(sValue);
+		else if (strcmp(sArg, "-threads") == 0) options.nThreads = (NvU32)atoi(sValue);
+		else if (strcmp(sArg, "-processes") == 0) options.nProcesses = mymax(1, atoi(sValue));
+		else if (strcmp(sArg, "-seed") == 0) options.seed = strtoull(sValue, nullptr, 10);
+		else if (strcmp(sArg, "-every") == 0) options.writeEvery = mymax(1, atoi(sValue));
+		else if (strcmp(sArg, "-chunk") == 0) options.nFramesPerChunk = mymax(1, atoi(sValue));
+		else if (strcmp(sArg, "-load") == 0) options.sLoadPath = sValue;
+		else if (strcmp(sArg, "-out") == 0) options.sOutPath = sValue;
+		else if (strcmp(sArg, "-save") == 0) options.sSavePath = sValue;
+		else if (strcmp(sArg, "-stats") == 0) options.sStatsPath = sValue;
+		else if (strcmp(sArg, "-trace") == 0) options.sTracePath = sValue;
+		else return false;
+	}
+	return true;
+}
+
+static int runProcesses(const Options& options)
+{
+	MultiProcessParams params;
+	params.m_nProcesses = options.nProcesses;
+	params.m_nRootsPerDim = options.nRootsPerDim;
+	params.m_depth = options.depth;
+	params.m_nSteps = options.nSteps;
+	params.m_nThreadsPerProcess = options.nThreads;
+	std::vector<MultiProcessStep> steps;
+	if (!runMultiProcess(params, steps))
+	{
+		fprintf(stderr, "running %u processes failed\n", options.nProcesses);
+		return 1;
+	}
+	double fSeconds = 0;
+	for (NvU32 uStep = 0; uStep < steps.size(); ++uStep)
+	{
+		const MultiProcessStep& step = steps[uStep];
+		fSeconds += step.m_fWallMs / 1000;
+		if (steps.size() >= 10 && (uStep + 1) % (steps.size() / 10) == 0)
+		{
+			printf("step %u, %.3f s, %llu leaves, %llu ghost leaves, exchanged %.1f KB in %.3f ms\n", uStep + 1, fSeconds,
+				(unsigned long long)step.m_nLeaves, (unsigned long long)step.m_nGhostLeaves, step.m_nSentBytes / 1e3, step.m_fMaxExchangeMs);
+		}
+	}
+	printf("%u steps in %.3f s, %.1f steps/s\n", options.nSteps, fSeconds, options.nSteps / fSeconds);
+	return 0;
+}
+
+static double getSeconds(std::chrono::high_resolution_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	if (!parseOptions(argc, argv, options) || (options.isLinear && options.nRootsPerDim > 1))
+	{
+		printUsage();
+		return 1;
+	}
+	if (options.nProcesses > 1)
+	{
+		if (options.isLinear || options.sLoadPath || options.sOutPath || options.sSavePath || options.sStatsPath || options.sTracePath)
+		{
+			printUsage();
+			return 1;
+		}
+		return runProcesses(options);
+	}
+	setTraceThreadName("main");
+	setTraceEnabled(options.sTracePath != nullptr);
+	auto start = std::chrono::high_resolution_clock::now();
+	World world;
+	world.setNThreads(options.nThreads);
+	if (options.sLoadPath)
+	{
+		if (options.isLinear || !world.loadSnapshot(options.sLoadPath))
+		{
+			fprintf(stderr, "can't load snapshot %s\n", options.sLoadPath);
+			return 1;
+		}
+	}
+	else
+	{
+		world.initialize(options.depth, options.isLinear ? STORAGE_LINEAR : STORAGE_POINTER, options.nRootsPerDim);
+	}
+	world.setSeed(options.seed);
+	printf("tree ready in %.3f s\n", getSeconds(start));
+
+	FrameWriter writer;
+	if (options.sOutPath && !writer.open(options.sOutPath, options.nFramesPerChunk))
+	{
+		fprintf(stderr, "can't open %s\n", options.sOutPath);
+		return 1;
+	}
+	FILE* pStatsFile = nullptr;
+	if (options.sStatsPath && !(pStatsFile = fopen(options.sStatsPath, "w")))
+	{
+		fprintf(stderr, "can't open %s\n", options.sStatsPath);
+		return 1;
+	}
+	start = std::chrono::high_resolution_clock::now();
+	for (NvU32 uStep = 0; uStep < options.nSteps; ++uStep)
+	{
+		world.makeSimulationStep();
+		if (pStatsFile)
+		{
+			world.getStepStats().writeJson(pStatsFile);
+		}
+		if (options.sOutPath && uStep % options.writeEvery == 0)
+		{
+			writer.addFrame(world);
+		}
+		if (options.nSteps >= 10 && (uStep + 1) % (options.nSteps / 10) == 0)
+		{
+			printf("step %u, %.3f s\n", uStep + 1, getSeconds(start));
+		}
+	}
+	double fStepSeconds = getSeconds(start);
+	if (pStatsFile && fclose(pStatsFile) != 0)
+	{
+		fprintf(stderr, "failed writing %s\n", options.sStatsPath);
+		return 1;
+	}
+	printf("%u steps in %.3f s, %.1f steps/s\n", options.nSteps, fStepSeconds, options.nSteps / fStepSeconds);
+
+	if (options.sOutPath)
+	{
+		if (!writer.close())
+		{
+			fprintf(stderr, "failed writing %s\n", options.sOutPath);
+			return 1;
+		}
+		printf("frames: %.1f MB raw, %.1f MB written (%.2fx), simulation waited for I/O %.3f ms\n", writer.getNRawBytes() / 1e6,
+			writer.getNWrittenBytes() / 1e6, (double)writer.getNRawBytes() / writer.getNWrittenBytes(), writer.getBlockedMilliseconds());
+	}
+	if (options.sSavePath && (options.isLinear || !world.saveSnapshot(options.sSavePath)))
+	{
+		fprintf(stderr, "can't save snapshot %s\n", options.sSavePath);
+		return 1;
+	}
+	if (options.sTracePath)
+	{
+		setTraceEnabled(false);
+		if (!writeChromeTrace(options.sTracePath))
+		{
+			fprintf(stderr, "can't write %s\n", options.sTracePath);
+			return 1;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,219 @@
+#define _CRT_SECURE_NO_WARNINGS // fopen() is fine here
+#include <string>
+#include <vector>
+#include <stdlib.h>
+#include "bench.h"
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <unistd.h>
+#endif
+
+struct BenchEntry
+{
+	const char* m_sName;
+	void (*m_pFunc)();
+};
+
+static const BenchEntry s_benches[] =
+{
+	{ "interactionLists", benchInteractionLists },
+	{ "farField", benchFarField },
+	{ "parallelStep", benchParallelStep },
+	{ "visitors", benchVisitors },
+	{ "linearStorage", benchLinearStorage },
+	{ "blockArray", benchBlockArray },
+	{ "gridLayout", benchGridLayout },
+	{ "pathKernel", benchPathKernel },
+	{ "power2Distribution", benchPower2Distribution },
+	{ "pathRandom", benchPathRandom },
+	{ "adaptivity", benchAdaptivity },
+	{ "compaction", benchCompaction },
+	{ "pointExtraction", benchPointExtraction },
+	{ "snapshot", benchSnapshot },
+	{ "suite", benchSuite },
+	{ "trace", benchTrace },
+	{ "timeGrids", benchTimeGrids },
+	{ "multiRoot", benchMultiRoot },
+	{ "multiProcess", benchMultiProcess },
+	{ "pairCache", benchPairCache },
+	{ "pathMath", benchPathMath },
+	{ "precision", benchPrecision },
+	{ "simulationThread", benchSimulationThread },
+};
+
+size_t getResidentBytes()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+	return counters.WorkingSetSize;
+#else
+	size_t nPages = 0, nResidentPages = 0;
+	FILE* pFile = fopen("/proc/self/statm", "r");
+	if (pFile)
+	{
+		if (fscanf(pFile, "%zu %zu", &nPages, &nResidentPages) != 2)
+		{
+			nResidentPages = 0;
+		}
+		fclose(pFile);
+	}
+	return nResidentPages * (size_t)sysconf(_SC_PAGESIZE);
+#endif
+}
+
+size_t getPhysicalBytes()
+{
+#ifdef _WIN32
+	MEMORYSTATUSEX status;
+	status.dwLength = sizeof(status);
+	GlobalMemoryStatusEx(&status);
+	return (size_t)status.ullTotalPhys;
+#else
+	return (size_t)sysconf(_SC_PHYS_PAGES) * (size_t)sysconf(_SC_PAGESIZE);
+#endif
+}
+
+struct BenchResult
+{
+	std::string m_sName, m_sUnit;
+	double m_fValue;
+	bool m_isLowerBetter;
+};
+static std::vector<BenchResult> s_results;
+
+void reportResult(const char* sName, double fValue, const char* sUnit, bool isLowerBetter)
+{
+	s_results.push_back({ sName, sUnit, fValue, isLowerBetter });
+}
+
+static bool writeJson(const char* sPath)
+{
+	FILE* pFile = fopen(sPath, "w");
+	if (!pFile)
+		return false;
+	fprintf(pFile, "{\n  \"results\": [\n");
+	for (size_t u = 0; u < s_results.size(); ++u)
+	{
+		const BenchResult& result = s_results[u];
+		fprintf(pFile, "    { \"name\": \"%s\", \"value\": %.17g, \"unit\": \"%s\", \"lowerIsBetter\": %s }%s\n", result.m_sName.c_str(),
+			result.m_fValue, result.m_sUnit.c_str(), result.m_isLowerBetter ? "true" : "false", u + 1 < s_results.size() ? "," : "");
+	}
+	fprintf(pFile, "  ]\n}\n");
+	return fclose(pFile) == 0;
+}
+
+// reads files written by writeJson() - only "name" and "value" of every result are needed
+static bool readJson(const char* sPath, std::vector<BenchResult>& results)
+{
+	FILE* pFile = fopen(sPath, "r");
+	if (!pFile)
+		return false;
+	std::string sText;
+	char buffer[4096];
+	for (size_t nRead; (nRead = fread(buffer, 1, sizeof(buffer), pFile)) > 0; )
+	{
+		sText.append(buffer, nRead);
+	}
+	fclose(pFile);
+	for (size_t uPos = 0; (uPos = sText.find("\"name\": \"", uPos)) != std::string::npos; )
+	{
+		uPos += 9;
+		size_t uEnd = sText.find('"', uPos), uValue = sText.find("\"value\":", uPos);
+		if (uEnd == std::string::npos || uValue == std::string::npos)
+			return false;
+		BenchResult result;
+		result.m_sName = sText.substr(uPos, uEnd - uPos);
+		result.m_fValue = strtod(sText.c_str() + uValue + 8, nullptr);
+		result.m_isLowerBetter = false;
+		results.push_back(result);
+		uPos = uEnd;
+	}
+	return true;
+}
+
+// returns number of results that are worse than the baseline by more than fThreshold (relative)
+static NvU32 compareWithBaseline(const std::vector<BenchResult>& baseline, double fThreshold)
+{
+	NvU32 nRegressions = 0;
+	printf("%32s %14s %14s %9s\n", "result", "baseline", "now", "change");
+	for (const BenchResult& result : s_results)
+	{
+		const BenchResult* pBase = nullptr;
+		for (const BenchResult& base : baseline)
+		{
+			if (base.m_sName == result.m_sName)
+			{
+				pBase = &base;
+			}
+		}
+		if (!pBase || pBase->m_fValue == 0)
+		{
+			printf("%32s %14s %14.4g %9s\n", result.m_sName.c_str(), "-", result.m_fValue, "new");
+			continue;
+		}
+		// positive change is always an improvement
+		double fChange = (result.m_fValue - pBase->m_fValue) / pBase->m_fValue * (result.m_isLowerBetter ? -1 : 1);
+		bool isRegression = fChange < -fThreshold;
+		nRegressions += isRegression ? 1 : 0;
+		printf("%32s %14.4g %14.4g %+8.1f%%%s\n", result.m_sName.c_str(), pBase->m_fValue, result.m_fValue, fChange * 100,
+			isRegression ? " REGRESSION" : "");
+	}
+	return nRegressions;
+}
+
+// usage: bench [name] [-json out.json] [-baseline baseline.json] [-threshold 0.25]
+// runs all benchmarks or only the ones which name contains the argument. with -baseline the exit code is 1
+// if any result is worse than in the baseline by more than the threshold
+int main(int argc, char** argv)
+{
+	const char* sFilter = nullptr, * sJsonPath = nullptr, * sBaselinePath = nullptr;
+	// timings on a shared machine easily move by 15%, so a smaller default gives false alarms
+	double fThreshold = 0.25;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "-json") == 0 && i + 1 < argc)
+		{
+			sJsonPath = argv[++i];
+		}
+		else if (strcmp(argv[i], "-baseline") == 0 && i + 1 < argc)
+		{
+			sBaselinePath = argv[++i];
+		}
+		else if (strcmp(argv[i], "-threshold") == 0 && i + 1 < argc)
+		{
+			fThreshold = atof(argv[++i]);
+		}
+		else
+		{
+			sFilter = argv[i];
+		}
+	}
+	for (NvU32 u = 0; u < ARRAY_ELEMENT_COUNT(s_benches); ++u)
+	{
+		if (sFilter && !strstr(s_benches[u].m_sName, sFilter))
+			continue;
+		printf("=== %s\n", s_benches[u].m_sName);
+		s_benches[u].m_pFunc();
+	}
+	if (sJsonPath && !writeJson(sJsonPath))
+	{
+		fprintf(stderr, "can't write %s\n", sJsonPath);
+		return 1;
+	}
+	if (sBaselinePath)
+	{
+		std::vector<BenchResult> baseline;
+		if (!readJson(sBaselinePath, baseline))
+		{
+			fprintf(stderr, "can't read %s\n", sBaselinePath);
+			return 1;
+		}
+		NvU32 nRegressions = compareWithBaseline(baseline, fThreshold);
+		printf("%u regressions with threshold %.0f%%\n", nRegressions, fThreshold * 100);
+		return nRegressions > 0 ? 1 : 0;
+	}
+	return 0;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+#include "../MyMisc.h"
+
+struct BenchTimer
+{
+	BenchTimer() { reset(); }
+	void reset() { m_start = std::chrono::high_resolution_clock::now(); }
+	double getMilliseconds() const
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - m_start).count();
+	}
+private:
+	std::chrono::high_resolution_clock::time_point m_start;
+};
+
+// resident set size of the process
+size_t getResidentBytes();
+// physical memory of the machine
+size_t getPhysicalBytes();
+
+// results that go to the JSON file and are compared with the baseline. name must be unique and stay the same
+// between runs, otherwise there is nothing to compare with
+void reportResult(const char* sName, double fValue, const char* sUnit, bool isLowerBetter);
+
+// every bench*.cpp file implements one of those
+void benchInteractionLists();
+void benchFarField();
+void benchParallelStep();
+void benchVisitors();
+void benchLinearStorage();
+void benchBlockArray();
+void benchGridLayout();
+void benchPathKernel();
+void benchPower2Distribution();
+void benchPathRandom();
+void benchAdaptivity();
+void benchCompaction();
+void benchPointExtraction();
+void benchSnapshot();
+void benchSuite();
+void benchTrace();
+void benchTimeGrids();
+void benchMultiRoot();
+void benchMultiProcess();
+void benchPairCache();
+void benchPathMath();
+void benchPrecision();
+void benchSimulationThread();
@@ -0,0 +1,74 @@
+#include "bench.h"
+#include "../wave.h"
+
+static const NvU32 N_STEPS = 10000;
+static const NvU32 N_STEPS_PER_TURN = 1000;
+
+// gaussian blob going around a circle - the region that needs fine leaves moves every step. leaf gets the
+// amplitude at the point of its box closest to the blob, so leaves much bigger than the blob still see it
+struct SetFrontVisitor : public Storage::InlineVisitor
+{
+	SetFrontVisitor(Storage& storage, const float3& vCenter) : m_storage(storage), m_vCenter(vCenter) { }
+	bool notifyEntering(GridElem& elem, const float3Box& box)
+	{
+		if (!elem.hasChildren())
+		{
+			float3 vDelta;
+			for (NvU32 uDim = 0; uDim < 3; ++uDim)
+			{
+				vDelta[uDim] = m_vCenter[uDim] < box[0][uDim] ? box[0][uDim] - m_vCenter[uDim] :
+					(m_vCenter[uDim] > box[1][uDim] ? m_vCenter[uDim] - box[1][uDim] : 0.f);
+			}
+			float fAmplitude = expf(-dot(vDelta, vDelta) / (0.1f * 0.1f));
+			m_storage.setTimePhase(elem, makefloat2(fAmplitude, 0.f));
+			++m_nLeaves;
+		}
+		++m_nNodes;
+		return true;
+	}
+	NvU32 m_nNodes = 0, m_nLeaves = 0;
+private:
+	Storage& m_storage;
+	float3 m_vCenter;
+};
+
+void benchAdaptivity()
+{
+	printf("front moving for %u steps, one turn every %u steps\n", N_STEPS, N_STEPS_PER_TURN);
+	printf("%16s %8s %10s %10s %10s %10s %10s\n", "kind", "step", "leaves", "used", "allocated", "RSS MB", "us/step");
+	// refine only is what Storage could do before children were recycled - the tree grows over everything the front has visited
+	for (NvU32 uKind = 0; uKind < 3; ++uKind)
+	{
+		const char* sKind = uKind == 0 ? "refine+coarsen" : (uKind == 1 ? "+compact" : "refine only");
+		size_t nRssBefore = getResidentBytes();
+		World world;
+		world.initialize(2);
+		AdaptParams params;
+		params.m_fRefineError = 0.01f;
+		params.m_fCoarsenError = uKind < 2 ? 0.004f : 0.f;
+		params.m_maxDepth = 7;
+		params.m_fMaxFragmentation = uKind == 1 ? 0.5f : 0.f;
+		world.setAdaptParams(params);
+		Storage& storage = world.accessStorage();
+		NvU32 maxUsed = 0;
+		NvU64 nChanges = 0;
+		BenchTimer timer;
+		for (NvU32 uStep = 1; uStep <= N_STEPS; ++uStep)
+		{
+			float fAngle = 2 * 3.14159265f * (float)uStep / N_STEPS_PER_TURN;
+			SetFrontVisitor setFront(storage, makefloat3(0.6f * cosf(fAngle), 0.6f * sinf(fAngle), 0.f));
+			storage.visit(0, setFront);
+			nvRelAssert(setFront.m_nNodes == storage.getNUsedChildren() + 1);
+			nChanges += world.adapt();
+			maxUsed = mymax(maxUsed, storage.getNUsedChildren());
+			if (uStep % 1000 == 0)
+			{
+				printf("%16s %8u %10u %10u %10u %10.1f %10.1f\n", sKind, uStep, setFront.m_nLeaves, storage.getNUsedChildren(),
+					storage.getNChildren(), (getResidentBytes() - nRssBefore) / 1e6, timer.getMilliseconds()); // ms per 1000 steps is us per step
+				timer.reset();
+			}
+		}
+		printf("%16s: %llu splits + merges, max used children %u, allocated %u (%.2fx)\n", sKind, (unsigned long long)nChanges,
+			maxUsed, storage.getNChildren(), (double)storage.getNChildren() / maxUsed);
+	}
+}
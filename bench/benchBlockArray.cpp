@@ -0,0 +1,107 @@
+#include "bench.h"
+#include "../wave.h"
+
+// the way BlockArray used to be: every block is a separate heap allocation owned by shared_ptr
+template <class T, NvU32 BLOCK_SIZE = 64>
+struct SharedBlockArray
+{
+	NvU32 size() const { return m_size; }
+	void resize(NvU32 size)
+	{
+		NvU32 nBlocks = NV_ALIGN_UP(size, BLOCK_SIZE) / BLOCK_SIZE;
+		m_nAllocations += nBlocks > m_pBlocks.size() ? nBlocks - (NvU32)m_pBlocks.size() : 0;
+		m_pBlocks.resize(nBlocks);
+		m_size = size;
+	}
+	inline T& operator[](NvU32 index) { return m_pBlocks[index / BLOCK_SIZE].p->data[index % BLOCK_SIZE]; }
+	NvU64 m_nAllocations = 0;
+private:
+	NvU32 m_size = 0;
+	struct Block
+	{
+		T data[BLOCK_SIZE];
+	};
+	struct BlockPtr
+	{
+		BlockPtr() { p = std::make_shared<Block>(); }
+		std::shared_ptr<Block> p;
+	};
+	std::vector<BlockPtr> m_pBlocks;
+};
+
+static const NvU32 N_NODES = 10000000;
+
+// same growth pattern as Storage::allocate8Children() - 64 elements at a time
+template <class ARRAY>
+static double grow(ARRAY& a)
+{
+	BenchTimer timer;
+	for (NvU32 u = 0; u < N_NODES; u += 8)
+	{
+		if (u >= a.size())
+		{
+			a.resize(a.size() + 64);
+		}
+		for (NvU32 uChild = 0; uChild < 8; ++uChild)
+		{
+			a[u + uChild].setFirstChild(u);
+		}
+	}
+	return timer.getMilliseconds();
+}
+
+template <class ARRAY>
+static double readAll(ARRAY& a, NvU64& uSum)
+{
+	BenchTimer timer;
+	for (NvU32 u = 0; u < N_NODES; ++u)
+	{
+		uSum += a[u].getFirstChild();
+	}
+	return timer.getMilliseconds();
+}
+
+void benchBlockArray()
+{
+	printf("%u nodes of %u bytes\n", N_NODES, (NvU32)sizeof(GridElem));
+	printf("%16s %12s %12s %12s %12s\n", "kind", "allocations", "RSS MB", "grow ms", "read ms");
+	NvU64 uSum = 0;
+	for (NvU32 uKind = 0; uKind < 3; ++uKind)
+	{
+		size_t nRssBefore = getResidentBytes();
+		BlockArray<GridElem> a;
+		a.setUseHugePages(uKind == 2);
+		BenchTimer timer;
+		if (uKind == 1)
+		{
+			a.reserve(N_NODES);
+		}
+		double fGrowMs = timer.getMilliseconds() + grow(a);
+		double fReadMs = readAll(a, uSum);
+		static const char* pNames[] = { "arena", "arena reserved", "arena huge" };
+		printf("%16s %12u %12.1f %12.1f %12.1f\n", pNames[uKind], a.getNSlabs(), (getResidentBytes() - nRssBefore) / 1048576., fGrowMs, fReadMs);
+	}
+	// last because memory of small allocations isn't necessarily returned to the OS after they are freed
+	{
+		size_t nRssBefore = getResidentBytes();
+		SharedBlockArray<GridElem> a;
+		double fGrowMs = grow(a);
+		double fReadMs = readAll(a, uSum);
+		printf("%16s %12llu %12.1f %12.1f %12.1f\n", "shared_ptr", a.m_nAllocations, (getResidentBytes() - nRssBefore) / 1048576., fGrowMs, fReadMs);
+	}
+	NvU64 nGroups = N_NODES / 8;
+	nvRelAssert(uSum == 4 * 32 * nGroups * (nGroups - 1));
+
+	// the whole tree: uniform depth 7 is 2396744 nodes, depth 8 - 19173960
+	for (NvU32 depth = 7; depth <= 8; ++depth)
+	{
+		size_t nRssBefore = getResidentBytes();
+		World world;
+		BenchTimer timer;
+		world.initialize(depth);
+		double fMs = timer.getMilliseconds();
+		const BlockArray<GridElem>& children = world.accessStorage().getChildren();
+		printf("initialize(%u): %u children, %u allocations, %.1f MB allocated, %.1f MB RSS, %.1f ms\n", depth, children.size(),
+			children.getNSlabs(), children.getAllocatedBytes() / 1048576., (getResidentBytes() - nRssBefore) / 1048576., fMs);
+	}
+}
@@ -0,0 +1,76 @@
+#include <random>
+#include <algorithm>
+#include "bench.h"
+#include "../wave.h"
+
+static const NvU32 DEPTH = 7;
+
+struct CollectLeaves : public Storage::InlineVisitor
+{
+	bool notifyEntering(GridElem& elem, const float3Box& box)
+	{
+		if (!elem.hasChildren())
+		{
+			m_leaves.push_back({ &elem, box });
+		}
+		return true;
+	}
+	std::vector<Storage::Subtree> m_leaves;
+};
+struct SumPhases : public Storage::InlineVisitor
+{
+	bool notifyEntering(GridElem& elem, const float3Box&)
+	{
+		m_fSum += elem.getTimePhase().x;
+		++m_nNodes;
+		return true;
+	}
+	double m_fSum = 0;
+	NvU64 m_nNodes = 0;
+};
+
+static double measureTraversal(Storage& storage, double& fSum)
+{
+	const NvU32 nRepeats = 5;
+	BenchTimer timer;
+	for (NvU32 u = 0; u < nRepeats; ++u)
+	{
+		SumPhases sumPhases;
+		storage.visit(0, sumPhases);
+		fSum += sumPhases.m_fSum;
+	}
+	return timer.getMilliseconds() / nRepeats;
+}
+
+// leaves of every level are split in random order, so groups of children end up scattered over the array - the way
+// they do after many steps of adaptation
+void benchCompaction()
+{
+	World world;
+	world.initialize(1);
+	Storage& storage = world.accessStorage();
+	std::mt19937 gen(1);
+	for (NvU32 depth = 1; depth < DEPTH; ++depth)
+	{
+		CollectLeaves collectLeaves;
+		storage.visit(0, collectLeaves);
+		std::shuffle(collectLeaves.m_leaves.begin(), collectLeaves.m_leaves.end(), gen);
+		for (const Storage::Subtree& leaf : collectLeaves.m_leaves)
+		{
+			leaf.m_pElem->split(world, storage, leaf.m_box);
+		}
+	}
+	printf("%u children, depth %u\n", storage.getNUsedChildren(), DEPTH);
+	printf("%12s %14s %14s %14s\n", "tree", "fragmentation", "traversal ms", "Mnodes/s");
+
+	double fSum = 0;
+	double fMs = measureTraversal(storage, fSum);
+	printf("%12s %14.3f %14.3f %14.1f\n", "fragmented", storage.computeFragmentation(), fMs, (storage.getNUsedChildren() + 1) / fMs / 1000);
+
+	BenchTimer timer;
+	storage.compact();
+	double fCompactMs = timer.getMilliseconds();
+	fMs = measureTraversal(storage, fSum);
+	printf("%12s %14.3f %14.3f %14.1f\n", "compacted", storage.computeFragmentation(), fMs, (storage.getNUsedChildren() + 1) / fMs / 1000);
+	printf("compact() took %.3f ms, checksum %f\n", fCompactMs, fSum);
+}
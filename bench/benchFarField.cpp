@@ -0,0 +1,74 @@
+#include <vector>
+#include "bench.h"
+#include "../wave.h"
+
+// gives leaves different amplitudes - otherwise errors of aggregated sources may cancel out
+static void setGaussianAmplitudes(Storage& storage, const InteractionLists& lists)
+{
+	for (NvU32 uSlot = 0; uSlot < lists.getNLeaves(); ++uSlot)
+	{
+		GridElem& elem = storage[lists.getLeafIndex(uSlot)];
+		float3 vCenter = elem.getCenter();
+		float fMagnitude = expf(-4 * dot(vCenter, vCenter));
+		elem.setTimePhase(makefloat2(fMagnitude * cosf(vCenter.x * 3), fMagnitude * sinf(vCenter.x * 3)));
+	}
+}
+
+void benchFarField()
+{
+	// accuracy against direct summation over all pairs
+	{
+		World world;
+		world.initialize(5);
+		world.makeSimulationStep();
+		Storage& storage = world.accessStorage();
+		const InteractionLists& lists = world.getInteractions();
+		setGaussianAmplitudes(storage, lists);
+
+		NvU32 nLeaves = lists.getNLeaves();
+		std::vector<double2> exact(nLeaves, makedouble2(0.));
+		for (NvU32 uSlot1 = 0; uSlot1 < nLeaves; ++uSlot1)
+		{
+			const GridElem& elem1 = storage[lists.getLeafIndex(uSlot1)];
+			for (NvU32 uSlot2 = 0; uSlot2 < nLeaves; ++uSlot2)
+			{
+				if (uSlot1 == uSlot2)
+					continue;
+				const GridElem& elem2 = storage[lists.getLeafIndex(uSlot2)];
+				const float2& timePhase = elem2.getTimePhase();
+				exact[uSlot1] += makedouble2((double)timePhase.x, (double)timePhase.y) * (1 / (double)length(elem1.getCenter() - elem2.getCenter()));
+			}
+		}
+
+		printf("%8s %14s %12s\n", "angle", "relRmsError", "ms");
+		const float fAngles[] = { 0.2f, 0.3f, 0.5f, 0.7f, 0.9f };
+		for (NvU32 u = 0; u < ARRAY_ELEMENT_COUNT(fAngles); ++u)
+		{
+			world.accessFarField().setOpeningAngle(fAngles[u]);
+			BenchTimer timer;
+			world.makeSimulationStep();
+			double fMs = timer.getMilliseconds();
+			double fErrSum = 0, fNormSum = 0;
+			for (NvU32 uSlot = 0; uSlot < nLeaves; ++uSlot)
+			{
+				fErrSum += lengthSquared(world.getLeafInfluence()[uSlot] - exact[uSlot]);
+				fNormSum += lengthSquared(exact[uSlot]);
+			}
+			printf("%8.2f %14.3e %12.3f\n", fAngles[u], sqrt(fErrSum / fNormSum), fMs);
+		}
+	}
+	// throughput - time per leaf should stay flat as the tree grows
+	printf("%6s %10s %12s %14s\n", "depth", "leaves", "ms", "ns/leaf");
+	for (NvU32 depth = 3; depth <= 7; ++depth)
+	{
+		World world;
+		world.initialize(depth);
+		world.makeSimulationStep();
+		NvU32 nLeaves = world.getInteractions().getNLeaves();
+		BenchTimer timer;
+		world.accessFarField().compute(world.accessStorage(), 0);
+		double fMs = timer.getMilliseconds();
+		printf("%6u %10u %12.3f %14.1f\n", depth, nLeaves, fMs, fMs * 1e6 / nLeaves);
+		fflush(stdout);
+	}
+}
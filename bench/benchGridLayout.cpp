@@ -0,0 +1,91 @@
+#include "bench.h"
+#include "../wave.h"
+
+// near field of every leaf - the same loop as in World, but without the far field and threads
+template <class ELEMS>
+static double nearField(const ELEMS& elems, const InteractionLists& lists, std::vector<double2>& result)
+{
+	BenchTimer timer;
+	result.resize(lists.getNLeaves());
+	for (NvU32 uSlot = 0; uSlot < lists.getNLeaves(); ++uSlot)
+	{
+		const auto& elemOfInterest = elems[lists.getLeafIndex(uSlot)];
+		double2 influence = makedouble2(0.);
+		const NvU32* pNeighbors = lists.getNeighbors(uSlot);
+		for (NvU32 u = 0, nNeighbors = lists.getNNeighbors(uSlot); u < nNeighbors; ++u)
+		{
+			const auto& elem = elems[lists.getLeafIndex(pNeighbors[u])];
+			const float2& timePhase = elem.getTimePhase();
+			double fInvDistance = 1 / (double)length(elemOfInterest.getCenter() - elem.getCenter());
+			influence += makedouble2((double)timePhase.x, (double)timePhase.y) * fInvDistance;
+		}
+		result[uSlot] = influence;
+	}
+	return timer.getMilliseconds();
+}
+
+// kernel that streams through all children: amplitude-weighted sum of centers
+static double streamAoS(const Storage& storage, float3& vSum)
+{
+	BenchTimer timer;
+	vSum = makefloat3(0.f);
+	for (NvU32 u = 0; u < storage.getNChildren(); ++u)
+	{
+		const GridElem& elem = storage[u];
+		vSum += elem.getCenter() * elem.getTimePhase().x;
+	}
+	return timer.getMilliseconds();
+}
+static double streamSoA(const GridSoA& soa, float3& vSum)
+{
+	BenchTimer timer;
+	float fSumX = 0, fSumY = 0, fSumZ = 0;
+	const float* pX = soa.m_centerX.data(), * pY = soa.m_centerY.data(), * pZ = soa.m_centerZ.data(), * pPhase = soa.m_phaseX.data();
+	for (NvU32 u = 0, n = soa.size(); u < n; ++u)
+	{
+		fSumX += pX[u] * pPhase[u];
+		fSumY += pY[u] * pPhase[u];
+		fSumZ += pZ[u] * pPhase[u];
+	}
+	vSum = makefloat3(fSumX, fSumY, fSumZ);
+	return timer.getMilliseconds();
+}
+
+void benchGridLayout()
+{
+	printf("%6s %10s %14s %14s %14s %14s\n", "depth", "leaves", "near AoS ms", "near SoA ms", "stream AoS ms", "stream SoA ms");
+	for (NvU32 depth = 5; depth <= 7; ++depth)
+	{
+		World world;
+		world.setStorageLayout(GRID_LAYOUT_SOA);
+		world.initialize(depth);
+		Storage& storage = world.accessStorage();
+		const GridSoA& soa = storage.getSoA();
+		// SoA must stay in sync with GridElem array
+		nvRelAssert(soa.size() == storage.getNChildren());
+		for (NvU32 u = 0; u < storage.getNChildren(); ++u)
+		{
+			const GridElem& elem = storage[u];
+			GridSoA::View view = soa[u];
+			nvRelAssert(all(view.getCenter() == elem.getCenter()) && all(view.getTimePhase() == elem.getTimePhase()));
+			nvRelAssert(view.hasChildren() == elem.hasChildren() && (!elem.hasChildren() || view.getFirstChild() == elem.getFirstChild()));
+			nvRelAssert(view.getParentIndex() == elem.getParentIndex() && view.isChildOfRoot() == elem.isChildOfRoot());
+		}
+		InteractionLists lists;
+		lists.build(storage, 0);
+
+		std::vector<double2> aosResult, soaResult;
+		double fNearAoSMs = nearField(storage, lists, aosResult);
+		double fNearSoAMs = nearField(soa, lists, soaResult);
+		for (NvU32 u = 0; u < lists.getNLeaves(); ++u)
+		{
+			nvRelAssert(all(aosResult[u] == soaResult[u]));
+		}
+
+		float3 vAoSSum, vSoASum;
+		double fStreamAoSMs = streamAoS(storage, vAoSSum);
+		double fStreamSoAMs = streamSoA(soa, vSoASum);
+		nvRelAssert(length(vAoSSum - vSoASum) <= 1e-3f * (1 + length(vAoSSum)));
+		printf("%6u %10u %14.3f %14.3f %14.3f %14.3f\n", depth, lists.getNLeaves(), fNearAoSMs, fNearSoAMs, fStreamAoSMs, fStreamSoAMs);
+	}
+}
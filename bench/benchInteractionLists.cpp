@@ -0,0 +1,85 @@
+#include "bench.h"
+#include "../wave.h"
+
+// the way neighbors used to be found: a separate walk from the root for every leaf
+static NvU64 countNeighborsPerLeafWalk(Storage& storage)
+{
+	struct FindNeighbors : public Storage::IVisitor
+	{
+		FindNeighbors(GridElem& elemOfInterest, const float3Box& boxOfInterest) : m_elemOfInterest(elemOfInterest), m_boxOfInterest(boxOfInterest) { }
+		virtual bool notifyEntering(GridElem& elem, const float3Box& box)
+		{
+			if (!doTouch(box, m_boxOfInterest))
+				return false;
+			if (elem.hasChildren())
+				return true;
+			if (&elem != &m_elemOfInterest)
+				++m_nNeighbors;
+			return false;
+		}
+		NvU64 m_nNeighbors = 0;
+	private:
+		GridElem& m_elemOfInterest;
+		const float3Box& m_boxOfInterest;
+	};
+	struct VisitLeaves : public Storage::IVisitor
+	{
+		VisitLeaves(Storage& storage) : m_storage(storage) { }
+		virtual bool notifyEntering(GridElem& elem, const float3Box& box)
+		{
+			if (elem.hasChildren())
+				return true;
+			FindNeighbors visitor(elem, box);
+			m_storage.visit(0, visitor);
+			m_nNeighbors += visitor.m_nNeighbors;
+			return false;
+		}
+		NvU64 m_nNeighbors = 0;
+	private:
+		Storage& m_storage;
+	};
+	VisitLeaves visitor(storage);
+	storage.visit(0, visitor);
+	return visitor.m_nNeighbors;
+}
+
+void benchInteractionLists()
+{
+	printf("%6s %10s %12s %12s %12s %14s\n", "depth", "leaves", "build ms", "near ms", "perLeaf ms", "neighbors");
+	for (NvU32 depth = 3; depth <= 8; ++depth)
+	{
+		World world;
+		world.initialize(depth);
+		Storage& storage = world.accessStorage();
+
+		BenchTimer timer;
+		NvU32 nLeaves, nPairs;
+		{
+			InteractionLists lists;
+			lists.build(storage, 0);
+			nLeaves = lists.getNLeaves();
+			nPairs = lists.getNPairs();
+		}
+		double fBuildMs = timer.getMilliseconds();
+
+		world.makeSimulationStep(); // builds lists inside of the world
+		// only the near field - far field, time grids and the rest of the step don't depend on how neighbors are found
+		const NvU32 nSteps = 4;
+		double fNearMs = 0;
+		for (NvU32 u = 0; u < nSteps; ++u)
+		{
+			world.makeSimulationStep();
+			const WorldStats& stats = world.getStepStats();
+			fNearMs += stats.m_fMs[TIMER_INTERACTIONS] + stats.m_fMs[TIMER_LEAF_INFLUENCE];
+		}
+		fNearMs /= nSteps;
+
+		timer.reset();
+		NvU64 nNeighbors = countNeighborsPerLeafWalk(storage);
+		double fPerLeafMs = timer.getMilliseconds();
+		nvRelAssert(nNeighbors == 2 * (NvU64)nPairs);
+
+		printf("%6u %10u %12.3f %12.3f %12.3f %14llu\n", depth, nLeaves, fBuildMs, fNearMs, fPerLeafMs, (unsigned long long)nNeighbors);
+		fflush(stdout);
+	}
+}
@@ -0,0 +1,195 @@
+#include <random>
+#include "bench.h"
+#include "../wave.h"
+
+struct CountLeaves : public Storage::InlineVisitor
+{
+	bool notifyEntering(GridElem& elem, const float3Box& box)
+	{
+		++m_nEntered;
+		if (!elem.hasChildren())
+		{
+			++m_nLeaves;
+			m_fVolume += (double)(box[1][0] - box[0][0]) * (box[1][1] - box[0][1]) * (box[1][2] - box[0][2]);
+		}
+		return true;
+	}
+	NvU64 m_nEntered = 0, m_nLeaves = 0;
+	double m_fVolume = 0;
+};
+
+// true if the box intersects sphere of given radius around the origin
+static bool crossesSphere(const float3Box& box, float fRadius)
+{
+	float fNear = 0, fFar = 0;
+	for (NvU32 uDim = 0; uDim < 3; ++uDim)
+	{
+		float fLo = fabsf(box[0][uDim]), fHi = fabsf(box[1][uDim]);
+		float fMin = (box[0][uDim] <= 0 && box[1][uDim] >= 0) ? 0 : mymin(fLo, fHi);
+		fNear += fMin * fMin;
+		fFar += mymax(fLo, fHi) * mymax(fLo, fHi);
+	}
+	return fNear <= fRadius * fRadius && fFar >= fRadius * fRadius;
+}
+
+// splits leaves crossing the sphere until they are maxDepth deep - typical adaptive refinement around a front
+struct SplitNearSphere : public Storage::InlineVisitor
+{
+	SplitNearSphere(World& world, Storage& storage, NvU32 maxDepth) : m_world(world), m_storage(storage), m_maxDepth(maxDepth) { }
+	bool notifyEntering(GridElem& elem, const float3Box& box)
+	{
+		if (m_depth == m_maxDepth || !crossesSphere(box, 0.7f))
+			return false;
+		if (!elem.hasChildren())
+		{
+			elem.split(m_world, m_storage, box);
+		}
+		++m_depth;
+		return true;
+	}
+	void notifyLeaving(GridElem&, const float3Box&)
+	{
+		--m_depth;
+	}
+private:
+	World& m_world;
+	Storage& m_storage;
+	NvU32 m_depth = 0, m_maxDepth;
+};
+
+// the way point is found in pointer-based storage: descent from the root comparing with the middle of the box
+static NvU32 locatePointPointer(const Storage& storage, const float3& vPoint)
+{
+	const GridElem* pElem = &storage.accessRoot(0);
+	float3Box box = storage.getRootBox(0);
+	NvU32 index = ~0U;
+	while (pElem->hasChildren())
+	{
+		float3 vMiddle = (box[0] + box[1]) / 2.f;
+		NvU32 uChild = (vPoint.x >= vMiddle.x ? 1 : 0) | (vPoint.y >= vMiddle.y ? 2 : 0) | (vPoint.z >= vMiddle.z ? 4 : 0);
+		index = pElem->getFirstChild() + uChild;
+		pElem = &storage[index];
+		box = Storage::computeChildBox(box, vMiddle, uChild);
+	}
+	return index;
+}
+
+void benchLinearStorage()
+{
+	printf("traversal\n%6s %10s %14s %14s %14s %14s\n", "depth", "leaves", "ptr ms", "linear ms", "ptr Mnodes/s", "lin Mnodes/s");
+	for (NvU32 depth = 4; depth <= 7; ++depth)
+	{
+		World pointerWorld, linearWorld;
+		pointerWorld.initialize(depth, STORAGE_POINTER);
+		linearWorld.initialize(depth, STORAGE_LINEAR);
+		const NvU32 nRepeats = 5;
+		CountLeaves pointerCount, linearCount;
+		BenchTimer timer;
+		for (NvU32 u = 0; u < nRepeats; ++u)
+		{
+			pointerWorld.accessStorage().visit(0, pointerCount);
+		}
+		double fPointerMs = timer.getMilliseconds() / nRepeats;
+		timer.reset();
+		for (NvU32 u = 0; u < nRepeats; ++u)
+		{
+			linearWorld.accessLinearStorage().visit(0, linearCount);
+		}
+		double fLinearMs = timer.getMilliseconds() / nRepeats;
+		nvRelAssert(pointerCount.m_nEntered == linearCount.m_nEntered && pointerCount.m_nLeaves == linearCount.m_nLeaves);
+		nvRelAssert(fabs(linearCount.m_fVolume / nRepeats - 8) < 1e-6);
+		printf("%6u %10llu %14.3f %14.3f %14.1f %14.1f\n", depth, pointerCount.m_nLeaves / nRepeats, fPointerMs, fLinearMs,
+			pointerCount.m_nEntered / nRepeats / fPointerMs / 1000, linearCount.m_nEntered / nRepeats / fLinearMs / 1000);
+	}
+
+	printf("point location (1M random points)\n%6s %10s %14s %14s\n", "depth", "leaves", "ptr ms", "linear ms");
+	std::mt19937 gen(1);
+	std::uniform_real_distribution<float> coord(-1.f, 1.f);
+	std::vector<float3> points(1 << 20);
+	for (float3& vPoint : points)
+	{
+		vPoint = makefloat3(coord(gen), coord(gen), coord(gen));
+	}
+	for (NvU32 depth = 4; depth <= 7; ++depth)
+	{
+		World pointerWorld, linearWorld;
+		pointerWorld.initialize(depth, STORAGE_POINTER);
+		linearWorld.initialize(depth, STORAGE_LINEAR);
+		const Storage& storage = pointerWorld.accessStorage();
+		const LinearStorage& linearStorage = linearWorld.accessLinearStorage();
+		NvU64 uPointerSum = 0, uLinearSum = 0;
+		BenchTimer timer;
+		for (const float3& vPoint : points)
+		{
+			uPointerSum += locatePointPointer(storage, vPoint);
+		}
+		double fPointerMs = timer.getMilliseconds();
+		timer.reset();
+		for (const float3& vPoint : points)
+		{
+			uLinearSum += linearStorage.locatePoint(0, vPoint);
+		}
+		double fLinearMs = timer.getMilliseconds();
+		// leaves are numbered differently, so only check that every found leaf contains its point
+		for (NvU32 u = 0; u < 1000; ++u)
+		{
+			NvU32 index = linearStorage.locatePoint(0, points[u]);
+			float3Box box = linearStorage.computeBox(0, linearStorage.getCode(index), linearStorage.getLevel(index));
+			nvRelAssert(!any(points[u] < box[0]) && !any(points[u] > box[1]));
+		}
+		printf("%6u %10u %14.3f %14.3f (checksums %llu %llu)\n", depth, linearStorage.getNLeaves(), fPointerMs, fLinearMs, uPointerSum, uLinearSum);
+	}
+
+	printf("refinement\n%12s %10s %14s %14s\n", "kind", "leaves", "ptr ms", "linear ms");
+	for (NvU32 depth = 5; depth <= 7; ++depth)
+	{
+		World pointerWorld, linearWorld;
+		BenchTimer timer;
+		pointerWorld.initialize(depth, STORAGE_POINTER);
+		double fPointerMs = timer.getMilliseconds();
+		timer.reset();
+		linearWorld.initialize(depth, STORAGE_LINEAR);
+		double fLinearMs = timer.getMilliseconds();
+		char sKind[32];
+		sprintf(sKind, "uniform %u", depth);
+		printf("%12s %10u %14.3f %14.3f\n", sKind, linearWorld.accessLinearStorage().getNLeaves(), fPointerMs, fLinearMs);
+	}
+	for (NvU32 depth = 8; depth <= 10; ++depth)
+	{
+		World pointerWorld, linearWorld;
+		pointerWorld.initialize(0, STORAGE_POINTER);
+		linearWorld.initialize(0, STORAGE_LINEAR);
+		BenchTimer timer;
+		SplitNearSphere splitVisitor(pointerWorld, pointerWorld.accessStorage(), depth);
+		pointerWorld.accessStorage().visit(0, splitVisitor);
+		double fPointerMs = timer.getMilliseconds();
+		timer.reset();
+		LinearStorage& linearStorage = linearWorld.accessLinearStorage();
+		float fMinWidth = 2.f / (1 << depth);
+		for (NvU32 u = 0; u < depth; ++u)
+		{
+			linearStorage.refine(0, [&](const GridElem&, const float3Box& box)
+			{
+				return box[1][0] - box[0][0] > fMinWidth && crossesSphere(box, 0.7f);
+			});
+		}
+		double fLinearMs = timer.getMilliseconds();
+		CountLeaves pointerCount;
+		pointerWorld.accessStorage().visit(0, pointerCount);
+		nvRelAssert(pointerCount.m_nLeaves == linearStorage.getNLeaves());
+		char sKind[32];
+		sprintf(sKind, "sphere %u", depth);
+		printf("%12s %10u %14.3f %14.3f\n", sKind, linearStorage.getNLeaves(), fPointerMs, fLinearMs);
+	}
+
+	// both backends must give the same near-field result
+	for (NvU32 depth = 3; depth <= 5; ++depth)
+	{
+		World pointerWorld, linearWorld;
+		pointerWorld.initialize(depth, STORAGE_POINTER);
+		linearWorld.initialize(depth, STORAGE_LINEAR);
+		pointerWorld.makeSimulationStep();
+		linearWorld.makeSimulationStep();
+		nvRelAssert(pointerWorld.getInteractions().getNPairs() == linearWorld.getInteractions().getNPairs());
+	}
+}
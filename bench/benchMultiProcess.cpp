@@ -0,0 +1,85 @@
+#include <vector>
+#include "bench.h"
+#include "../wave.h"
+#include "../multiProcess.h"
+
+// leaves of a worker see far away parts of other workers only through aggregated sources, so influence differs
+// from one process a little - by about the error of the far field itself
+static void checkSameAsOneProcess(NvU32 nProcesses, NvU32 nRootsPerDim, NvU32 depth)
+{
+	MultiProcessParams params;
+	params.m_nProcesses = nProcesses;
+	params.m_nRootsPerDim = nRootsPerDim;
+	params.m_depth = depth;
+	params.m_nSteps = 2;
+	std::vector<MultiProcessStep> steps;
+	nvRelAssert(runMultiProcess(params, steps));
+
+	World world;
+	world.initialize(depth, STORAGE_POINTER, nRootsPerDim);
+	for (NvU32 uStep = 0; uStep < params.m_nSteps; ++uStep)
+	{
+		world.makeSimulationStep();
+		double2 influenceSum = makedouble2(0.);
+		double fInfluenceNorm = 0;
+		for (const double2& influence : world.getLeafInfluence())
+		{
+			influenceSum += influence;
+			fInfluenceNorm += length(influence);
+		}
+		const MultiProcessStep& step = steps[uStep];
+		nvRelAssert(step.m_nLeaves == world.getInteractions().getNLeaves());
+		double fNormRelDiff = fabs(step.m_fInfluenceNorm - fInfluenceNorm) / fInfluenceNorm;
+		double fSumRelDiff = length(step.m_influenceSum - influenceSum) / length(influenceSum);
+		nvRelAssert(fNormRelDiff < 1e-3 && fSumRelDiff < 1e-3);
+		printf("%u processes vs 1, step %u: %llu leaves, %llu ghost leaves, norm relDiff %.3e, sum relDiff %.3e\n", nProcesses,
+			uStep, (unsigned long long)step.m_nLeaves, (unsigned long long)step.m_nGhostLeaves, fNormRelDiff, fSumRelDiff);
+	}
+}
+
+static void printScaling(const char* sKind, NvU32 nProcesses, NvU32 nRootsPerDim, NvU32 depth, double& fOneProcessMs)
+{
+	MultiProcessParams params;
+	params.m_nProcesses = nProcesses;
+	params.m_nRootsPerDim = nRootsPerDim;
+	params.m_depth = depth;
+	params.m_nSteps = 4;
+	std::vector<MultiProcessStep> steps;
+	nvRelAssert(runMultiProcess(params, steps));
+	// the first step builds interaction lists
+	double fWallMs = 1e30, fExchangeMs = 1e30;
+	for (NvU32 uStep = 1; uStep < steps.size(); ++uStep)
+	{
+		fWallMs = mymin(fWallMs, steps[uStep].m_fWallMs);
+		fExchangeMs = mymin(fExchangeMs, steps[uStep].m_fMaxExchangeMs);
+	}
+	if (nProcesses == 1)
+	{
+		fOneProcessMs = fWallMs;
+	}
+	const MultiProcessStep& last = steps.back();
+	printf("%8s %10u %8u %10llu %12llu %12.1f %12.3f %12.3f %10.2f\n", sKind, nProcesses, nRootsPerDim * nRootsPerDim * nRootsPerDim,
+		(unsigned long long)last.m_nLeaves, (unsigned long long)last.m_nGhostLeaves, last.m_nSentBytes / 1e3, fExchangeMs, fWallMs,
+		fOneProcessMs / fWallMs);
+	fflush(stdout);
+	char sName[64];
+	snprintf(sName, sizeof(sName), "multiProcess.%s.p%u", sKind, nProcesses);
+	reportResult(sName, fWallMs, "ms", true);
+}
+
+void benchMultiProcess()
+{
+	checkSameAsOneProcess(4, 2, 3);
+
+	// speedup is the time of one process divided by the time of n - for weak scaling 1 means perfect scaling
+	printf("%8s %10s %8s %10s %12s %12s %12s %12s %10s\n", "scaling", "processes", "roots", "leaves", "ghost leaves",
+		"sent KB", "exchange ms", "step ms", "speedup");
+	double fOneProcessMs = 0;
+	for (NvU32 nProcesses = 1; nProcesses <= 8; nProcesses *= 2)
+	{
+		printScaling("strong", nProcesses, 4, 3, fOneProcessMs);
+	}
+	// the same number of leaves per process. tilings are cubes, so only 1 and 8 processes can have the same work each
+	printScaling("weak", 1, 2, 3, fOneProcessMs);
+	printScaling("weak", 8, 4, 3, fOneProcessMs);
+}
@@ -0,0 +1,100 @@
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include "bench.h"
+#include "../wave.h"
+
+// slots of all leaves ordered by their centers, so leaves of differently built trees can be matched
+static std::vector<NvU32> sortLeavesByCenter(World& world)
+{
+	const Storage& storage = world.accessStorage();
+	const InteractionLists& lists = world.getInteractions();
+	std::vector<NvU32> slots(lists.getNLeaves());
+	for (NvU32 u = 0; u < slots.size(); ++u)
+	{
+		slots[u] = u;
+	}
+	std::sort(slots.begin(), slots.end(), [&](NvU32 uSlot1, NvU32 uSlot2)
+	{
+		const float3& vCenter1 = storage[lists.getLeafIndex(uSlot1)].getCenter();
+		const float3& vCenter2 = storage[lists.getLeafIndex(uSlot2)].getCenter();
+		if (vCenter1.x != vCenter2.x) return vCenter1.x < vCenter2.x;
+		if (vCenter1.y != vCenter2.y) return vCenter1.y < vCenter2.y;
+		return vCenter1.z < vCenter2.z;
+	});
+	return slots;
+}
+
+// 8 roots of depth n cover exactly the same leaves as one root of depth n + 1. every leaf must get the same
+// neighbors (halo included) and the same influence
+static void checkSameAsOneRoot(NvU32 depth)
+{
+	World oneRoot, tiled;
+	oneRoot.initialize(depth + 1);
+	tiled.initialize(depth, STORAGE_POINTER, 2);
+	oneRoot.makeSimulationStep();
+	tiled.makeSimulationStep();
+	const InteractionLists& lists1 = oneRoot.getInteractions();
+	const InteractionLists& lists8 = tiled.getInteractions();
+	nvRelAssert(tiled.accessStorage().getNRoots() == 8);
+	nvRelAssert(lists1.getNLeaves() == lists8.getNLeaves() && lists1.getNPairs() == lists8.getNPairs());
+
+	std::vector<NvU32> slots1 = sortLeavesByCenter(oneRoot), slots8 = sortLeavesByCenter(tiled);
+	double fMaxRelDiff = 0;
+	for (NvU32 u = 0; u < slots1.size(); ++u)
+	{
+		nvRelAssert(lists1.getNNeighbors(slots1[u]) == lists8.getNNeighbors(slots8[u]));
+		const double2& influence1 = oneRoot.getLeafInfluence()[slots1[u]];
+		const double2& influence8 = tiled.getLeafInfluence()[slots8[u]];
+		fMaxRelDiff = mymax(fMaxRelDiff, length(influence1 - influence8) / length(influence1));
+	}
+	nvRelAssert(fMaxRelDiff < 1e-6);
+	printf("1 root of depth %u and 8 roots of depth %u: %u leaves, %u pairs, maxRelDiff %.3e\n", depth + 1, depth,
+		lists1.getNLeaves(), lists1.getNPairs(), fMaxRelDiff);
+}
+
+void benchMultiRoot()
+{
+	checkSameAsOneRoot(2);
+
+	// the same leaves split between 1, 8 and 64 roots
+	const NvU32 totalDepth = 5, nSteps = 3;
+	NvU32 nMaxThreads = mymax(std::thread::hardware_concurrency(), 1U);
+	printf("total depth %u\n", totalDepth);
+	printf("%8s %8s %10s %14s %12s %10s\n", "roots", "threads", "leaves", "first step ms", "step ms", "speedup");
+	double fOneRootMs[2] = { };
+	for (NvU32 nRootsPerDim = 1, rootDepth = 0; nRootsPerDim <= 4; nRootsPerDim *= 2, ++rootDepth)
+	{
+		for (NvU32 uThreads = 0; uThreads < (nMaxThreads > 1 ? 2U : 1U); ++uThreads)
+		{
+			NvU32 nThreads = uThreads ? nMaxThreads : 1;
+			World world;
+			world.initialize(totalDepth - rootDepth, STORAGE_POINTER, nRootsPerDim);
+			world.setNThreads(nThreads);
+			// the first step builds interaction lists
+			BenchTimer timer;
+			world.makeSimulationStep();
+			double fFirstMs = timer.getMilliseconds();
+			double fStepMs = 1e30;
+			for (NvU32 u = 0; u < nSteps; ++u)
+			{
+				timer.reset();
+				world.makeSimulationStep();
+				fStepMs = mymin(fStepMs, timer.getMilliseconds());
+			}
+			if (nRootsPerDim == 1)
+			{
+				fOneRootMs[uThreads] = fStepMs;
+			}
+			printf("%8u %8u %10u %14.3f %12.3f %10.2f\n", world.accessStorage().getNRoots(), nThreads,
+				world.getInteractions().getNLeaves(), fFirstMs, fStepMs, fOneRootMs[uThreads] / fStepMs);
+			fflush(stdout);
+			if (uThreads == 0)
+			{
+				char sName[64];
+				snprintf(sName, sizeof(sName), "multiRoot.roots%u", nRootsPerDim * nRootsPerDim * nRootsPerDim);
+				reportResult(sName, fStepMs, "ms", true);
+			}
+		}
+	}
+}
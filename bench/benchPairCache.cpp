@@ -0,0 +1,158 @@
+#include <vector>
+#include "bench.h"
+#include "../wave.h"
+#include "../pathKernel.h"
+
+static void checkSame(const std::vector<double2>& values1, const std::vector<double2>& values2)
+{
+	nvRelAssert(values1.size() == values2.size());
+	for (NvU32 u = 0; u < values1.size(); ++u)
+	{
+		nvRelAssert(values1[u].x == values2[u].x && values1[u].y == values2[u].y);
+	}
+}
+
+static void checkSameInfluence(const World& world1, const World& world2)
+{
+	checkSame(world1.getLeafInfluence(), world2.getLeafInfluence());
+	checkSame(world1.getLeafPathSums(), world2.getLeafPathSums());
+}
+
+// split and merge change pairs - the cache must be dropped and filled again, otherwise influence would differ
+static void checkInvalidation()
+{
+	World cached, uncached;
+	uncached.setUsePairCache(false);
+	World* pWorlds[2] = { &cached, &uncached };
+	for (World* pWorld : pWorlds)
+	{
+		pWorld->setPathSamples(4);
+		pWorld->initialize(3);
+		pWorld->makeSimulationStep();
+		pWorld->makeSimulationStep();
+	}
+	checkSameInfluence(cached, uncached);
+	NvU32 leafIndex = cached.getInteractions().getLeafIndex(cached.getInteractions().getNLeaves() / 3);
+	for (World* pWorld : pWorlds)
+	{
+		Storage& storage = pWorld->accessStorage();
+		storage[leafIndex].split(*pWorld, storage, storage.computeBox(storage[leafIndex]));
+		pWorld->makeSimulationStep();
+		pWorld->makeSimulationStep();
+	}
+	checkSameInfluence(cached, uncached);
+	for (World* pWorld : pWorlds)
+	{
+		Storage& storage = pWorld->accessStorage();
+		storage[leafIndex].merge(*pWorld, storage);
+		pWorld->makeSimulationStep();
+		pWorld->makeSimulationStep();
+	}
+	checkSameInfluence(cached, uncached);
+	nvRelAssert(!cached.getLeafPathSums().empty());
+	printf("influence and path sums with and without the cache are the same after split and merge\n");
+}
+
+// the same split of generatePathTime() for code that samples paths between pairs that don't move
+static void benchPathGeometry()
+{
+	const NvU32 nPairs = 1 << 16, nSamples = 16;
+	std::vector<float3> fromPoints(nPairs), toPoints(nPairs);
+	for (NvU32 u = 0; u < nPairs; ++u)
+	{
+		fromPoints[u] = makefloat3((float)(u % 97) + 1, (float)(u % 89) + 2, (float)(u % 83) + 3) / 128.f;
+		toPoints[u] = fromPoints[u] + makefloat3(0.125f, (float)(u % 7) / 64, -(float)(u % 5) / 64);
+	}
+	std::vector<PathGeometry> geometries(nPairs);
+	double fSum[2] = { };
+	BenchTimer timer;
+	for (NvU32 uSample = 0; uSample < nSamples; ++uSample)
+	{
+		for (NvU32 u = 0; u < nPairs; ++u)
+		{
+			double fAction, fTime, fWeight;
+			generatePathTime(fromPoints[u], toPoints[u], (u * 0.618034 + uSample * 0.1) - (NvU32)(u * 0.618034 + uSample * 0.1), fAction, fTime, fWeight);
+			fSum[0] += fAction * fWeight + fTime;
+		}
+	}
+	double fFullMs = timer.getMilliseconds();
+	timer.reset();
+	for (NvU32 u = 0; u < nPairs; ++u)
+	{
+		geometries[u] = computePathGeometry(fromPoints[u], toPoints[u]);
+	}
+	for (NvU32 uSample = 0; uSample < nSamples; ++uSample)
+	{
+		for (NvU32 u = 0; u < nPairs; ++u)
+		{
+			double fAction, fTime, fWeight;
+			generatePathTime(geometries[u], (u * 0.618034 + uSample * 0.1) - (NvU32)(u * 0.618034 + uSample * 0.1), fAction, fTime, fWeight);
+			fSum[1] += fAction * fWeight + fTime;
+		}
+	}
+	double fCachedMs = timer.getMilliseconds();
+	nvRelAssert(fSum[0] == fSum[1]);
+	printf("%u pairs x %u samples: generatePathTime %.3f ms, with cached geometry %.3f ms (%.2fx)\n", nPairs, nSamples,
+		fFullMs, fCachedMs, fFullMs / fCachedMs);
+	reportResult("pairCache.pathGeometry", fCachedMs, "ms", true);
+}
+
+// the same, but the cached geometry is used by path sampling of the world
+static void benchPathSampling()
+{
+	const NvU32 depth = 4, nSamples = 4, nSteps = 5;
+	printf("%6s %10s %10s %16s %12s\n", "samples", "leaves", "cache", "pathSampling ms", "step ms");
+	for (NvU32 uCache = 0; uCache < 2; ++uCache)
+	{
+		World world;
+		world.setUsePairCache(uCache == 1);
+		world.setPathSamples(nSamples);
+		world.initialize(depth);
+		world.makeSimulationStep();
+		double fStepMs = 1e30, fSamplingMs = 1e30;
+		for (NvU32 uStep = 0; uStep < nSteps; ++uStep)
+		{
+			BenchTimer timer;
+			world.makeSimulationStep();
+			fStepMs = mymin(fStepMs, timer.getMilliseconds());
+			fSamplingMs = mymin(fSamplingMs, world.getStepStats().m_fMs[TIMER_PATH_SAMPLING]);
+		}
+		printf("%6u %10u %10s %16.3f %12.3f\n", nSamples, world.getInteractions().getNLeaves(), uCache ? "on" : "off", fSamplingMs, fStepMs);
+		fflush(stdout);
+		reportResult(uCache ? "pairCache.pathSampling.on" : "pairCache.pathSampling.off", fStepMs, "ms", true);
+	}
+}
+
+void benchPairCache()
+{
+	checkInvalidation();
+	benchPathGeometry();
+	benchPathSampling();
+
+	const NvU32 nSteps = 5;
+	printf("%6s %10s %10s %16s %12s\n", "depth", "leaves", "cache", "leafInfluence ms", "step ms");
+	for (NvU32 depth = 4; depth <= 5; ++depth)
+	{
+		for (NvU32 uCache = 0; uCache < 2; ++uCache)
+		{
+			World world;
+			world.setUsePairCache(uCache == 1);
+			world.initialize(depth);
+			// the first step builds interaction lists and fills the cache
+			world.makeSimulationStep();
+			double fStepMs = 1e30, fInfluenceMs = 1e30;
+			for (NvU32 uStep = 0; uStep < nSteps; ++uStep)
+			{
+				BenchTimer timer;
+				world.makeSimulationStep();
+				fStepMs = mymin(fStepMs, timer.getMilliseconds());
+				fInfluenceMs = mymin(fInfluenceMs, world.getStepStats().m_fMs[TIMER_LEAF_INFLUENCE]);
+			}
+			printf("%6u %10u %10s %16.3f %12.3f\n", depth, world.getInteractions().getNLeaves(), uCache ? "on" : "off", fInfluenceMs, fStepMs);
+			fflush(stdout);
+			char sName[64];
+			snprintf(sName, sizeof(sName), "pairCache.depth%u.%s", depth, uCache ? "on" : "off");
+			reportResult(sName, fStepMs, "ms", true);
+		}
+	}
+}
@@ -0,0 +1,45 @@
+#include <vector>
+#include <thread>
+#include "bench.h"
+#include "../wave.h"
+
+void benchParallelStep()
+{
+	World world;
+	world.initialize(6);
+	world.makeSimulationStep();
+	std::vector<double2> serialInfluence = world.getLeafInfluence();
+
+	NvU32 nMaxThreads = mymax(std::thread::hardware_concurrency(), 1U);
+	printf("%8s %12s %10s %14s\n", "threads", "step ms", "speedup", "maxRelDiff");
+	double fSerialMs = 0;
+	for (NvU32 nThreads = 1; ; nThreads = mymin(nThreads * 2, nMaxThreads))
+	{
+		world.setNThreads(nThreads);
+		world.makeSimulationStep(); // warm up
+		const NvU32 nSteps = 4;
+		BenchTimer timer;
+		for (NvU32 u = 0; u < nSteps; ++u)
+		{
+			world.makeSimulationStep();
+		}
+		double fStepMs = timer.getMilliseconds() / nSteps;
+		if (nThreads == 1)
+		{
+			fSerialMs = fStepMs;
+		}
+
+		// the order of summation differs between threads, so results may differ in last bits only
+		double fMaxRelDiff = 0;
+		const std::vector<double2>& influence = world.getLeafInfluence();
+		for (NvU32 u = 0; u < influence.size(); ++u)
+		{
+			fMaxRelDiff = mymax(fMaxRelDiff, length(influence[u] - serialInfluence[u]) / length(serialInfluence[u]));
+		}
+		nvRelAssert(fMaxRelDiff < 1e-6);
+		printf("%8u %12.3f %10.2f %14.3e\n", nThreads, fStepMs, fSerialMs / fStepMs, fMaxRelDiff);
+		fflush(stdout);
+		if (nThreads == nMaxThreads)
+			break;
+	}
+}
@@ -0,0 +1,57 @@
+#include <random>
+#include "bench.h"
+#include "../pathKernel.h"
+
+void benchPathKernel()
+{
+	const NvU32 nPairs = 1 << 20;
+	std::mt19937 gen(1);
+	std::uniform_real_distribution<float> coord(-1.f, 1.f);
+	std::uniform_real_distribution<double> uniform01(0., 1.);
+	std::vector<float> coords[6];
+	std::vector<double> f01Numbers(nPairs);
+	for (NvU32 u = 0; u < nPairs; ++u)
+	{
+		for (NvU32 uCoord = 0; uCoord < 6; ++uCoord)
+		{
+			coords[uCoord].push_back(coord(gen));
+		}
+		f01Numbers[u] = uniform01(gen);
+	}
+
+	std::vector<double> refAction(nPairs), refTime(nPairs), refWeight(nPairs);
+	BenchTimer timer;
+	for (NvU32 u = 0; u < nPairs; ++u)
+	{
+		float3 fromP = makefloat3(coords[0][u], coords[1][u], coords[2][u]);
+		float3 toP = makefloat3(coords[3][u], coords[4][u], coords[5][u]);
+		generatePathTime(fromP, toP, f01Numbers[u], refAction[u], refTime[u], refWeight[u]);
+	}
+	double fScalarMs = timer.getMilliseconds();
+	printf("%16s %12s %14s %14s\n", "kernel", "ms", "Mpairs/s", "maxRelDiff");
+	printf("%16s %12.3f %14.1f %14s\n", "generatePathTime", fScalarMs, nPairs / fScalarMs / 1000, "-");
+
+	std::vector<double> action(nPairs), time(nPairs), weight(nPairs);
+	PathBatch batch = { coords[0].data(), coords[1].data(), coords[2].data(), coords[3].data(), coords[4].data(), coords[5].data(),
+		f01Numbers.data(), action.data(), time.data(), weight.data(), nPairs };
+	static const char* pNames[] = { "batch scalar", "batch AVX2", "batch AVX-512" };
+	for (NvU32 uLevel = SIMD_SCALAR; uLevel <= (NvU32)getMaxSimdLevel(); ++uLevel)
+	{
+		const NvU32 nRepeats = 5;
+		timer.reset();
+		for (NvU32 uRepeat = 0; uRepeat < nRepeats; ++uRepeat)
+		{
+			generatePathTimes(batch, (SimdLevel)uLevel);
+		}
+		double fMs = timer.getMilliseconds() / nRepeats;
+		double fMaxRelDiff = 0;
+		for (NvU32 u = 0; u < nPairs; ++u)
+		{
+			nvRelAssert(weight[u] == refWeight[u]);
+			fMaxRelDiff = mymax(fMaxRelDiff, fabs(time[u] - refTime[u]) / fabs(refTime[u]));
+			fMaxRelDiff = mymax(fMaxRelDiff, fabs(action[u] - refAction[u]) / (fabs(refAction[u]) + fabs(refTime[u])));
+		}
+		nvRelAssert(fMaxRelDiff < 1e-10);
+		printf("%16s %12.3f %14.1f %14.3e\n", pNames[uLevel], fMs, nPairs / fMs / 1000, fMaxRelDiff);
+	}
+}
@@ -0,0 +1,165 @@
+#include <random>
+#include "bench.h"
+#include "../pathKernel.h"
+
+// log(a) if pB is null, otherwise log(a / b)
+template <class MATH>
+struct LogKernel
+{
+	LogKernel(const double* pA, const double* pB, double* pLog) : m_pA(pA), m_pB(pB), m_pLog(pLog) { }
+	template <class V>
+	void run(size_t u)
+	{
+		V a = V::load(m_pA + u);
+		(m_pB ? MATH::logRatio(a, V::load(m_pB + u)) : MATH::log(a)).store(m_pLog + u);
+	}
+private:
+	const double* m_pA, * m_pB;
+	double* m_pLog;
+};
+
+// a - b is exact when a / b is in [0.5, 2], so near 1 log1p() doesn't suffer from rounding of a / b. further
+// away rounding of a / b is small compared to log(a / b)
+static double getRefLogRatio(double a, double b)
+{
+	return a >= 0.5 * b && a <= 2 * b ? log1p((a - b) / b) : log(a / b);
+}
+
+// relative error against libm for every SIMD level. ratios close to 1 are where log is small and any absolute
+// error becomes big relative error.
+// policies that do round it (isRatioRounded) are allowed the error of log that one ulp of a / b gives - it's not theirs
+template <class MATH>
+static void checkLogAccuracy(const char* sName, double fMaxAllowedRelError, bool isRatioRounded)
+{
+	std::mt19937 gen(1);
+	std::uniform_real_distribution<double> exponent(-60., 60.), nearOne(-1e-3, 1e-3);
+	std::vector<double> x, b;
+	for (NvU32 u = 0; u < (1 << 18); ++u)
+	{
+		x.push_back(exp2(exponent(gen)));
+		x.push_back(1 + nearOne(gen));
+		x.push_back(1 + nearOne(gen) * 1e-9);
+	}
+	// both sides of the points where the mantissa is halved
+	for (double f : { 1.4142135623730951, 0.70710678118654757, 1., 2., 0.5 })
+	{
+		for (int i = -64; i <= 64; ++i)
+		{
+			x.push_back(f * (1 + i * 1e-15));
+		}
+	}
+	std::vector<double> a(x.size()), logs(x.size());
+	for (NvU32 u = 0; u < x.size(); ++u)
+	{
+		b.push_back(exp2(exponent(gen)));
+		a[u] = x[u] * b[u];
+	}
+	for (NvU32 uRatio = 0; uRatio < 2; ++uRatio)
+	{
+		printf("%8s %8s", sName, uRatio ? "ratio" : "log");
+		// one more level is MATH::log(double) itself
+		for (NvU32 uLevel = SIMD_SCALAR; uLevel <= (NvU32)getMaxSimdLevel() + 1; ++uLevel)
+		{
+			const double* pA = uRatio ? a.data() : x.data(), * pB = uRatio ? b.data() : nullptr;
+			if (uLevel > (NvU32)getMaxSimdLevel())
+			{
+				for (NvU32 u = 0; u < x.size(); ++u)
+				{
+					logs[u] = pB ? MATH::logRatio(pA[u], pB[u]) : MATH::log(pA[u]);
+				}
+			}
+			else
+			{
+				LogKernel<MATH> kernel(pA, pB, logs.data());
+				simdFor((SimdLevel)uLevel, x.size(), kernel);
+			}
+			double fMaxRelError = 0;
+			for (NvU32 u = 0; u < x.size(); ++u)
+			{
+				double fRef = pB ? getRefLogRatio(pA[u], pB[u]) : log(pA[u]);
+				double fError = fabs(logs[u] - fRef) - (pB && isRatioRounded ? 2.3e-16 : 0.);
+				fMaxRelError = mymax(fMaxRelError, fRef == 0 ? fabs(logs[u]) : mymax(fError, 0.) / fabs(fRef));
+			}
+			printf(" %14.3e", fMaxRelError);
+			fflush(stdout);
+			nvRelAssert(fMaxRelError < fMaxAllowedRelError);
+		}
+		printf(" %14.0e\n", fMaxAllowedRelError);
+	}
+}
+
+template <class MATH>
+static void benchPolicy(const char* sName, const PathBatch& batch, const double* pRefAction, const double* pRefTime, double fMaxAllowedRelDiff)
+{
+	const NvU32 nRepeats = 5;
+	BenchTimer timer;
+	for (NvU32 uRepeat = 0; uRepeat < nRepeats; ++uRepeat)
+	{
+		for (NvU32 u = 0; u < batch.m_n; ++u)
+		{
+			float3 fromP = makefloat3(batch.m_pFromX[u], batch.m_pFromY[u], batch.m_pFromZ[u]);
+			float3 toP = makefloat3(batch.m_pToX[u], batch.m_pToY[u], batch.m_pToZ[u]);
+			generatePathTime<MATH>(fromP, toP, batch.m_p01Numbers[u], batch.m_pAction[u], batch.m_pTime[u], batch.m_pWeight[u]);
+		}
+	}
+	double fScalarMs = timer.getMilliseconds() / nRepeats;
+	timer.reset();
+	for (NvU32 uRepeat = 0; uRepeat < nRepeats; ++uRepeat)
+	{
+		generatePathTimes<MATH>(batch);
+	}
+	double fBatchMs = timer.getMilliseconds() / nRepeats;
+	// the same measure of difference benchPathKernel() uses
+	double fMaxRelDiff = 0;
+	for (NvU32 u = 0; u < batch.m_n; ++u)
+	{
+		fMaxRelDiff = mymax(fMaxRelDiff, fabs(batch.m_pTime[u] - pRefTime[u]) / fabs(pRefTime[u]));
+		fMaxRelDiff = mymax(fMaxRelDiff, fabs(batch.m_pAction[u] - pRefAction[u]) / (fabs(pRefAction[u]) + fabs(pRefTime[u])));
+	}
+	nvRelAssert(fMaxRelDiff < fMaxAllowedRelDiff);
+	printf("%8s %14.1f %14.1f %14.3e\n", sName, batch.m_n / fScalarMs / 1000, batch.m_n / fBatchMs / 1000, fMaxRelDiff);
+	char sResult[64];
+	snprintf(sResult, sizeof(sResult), "pathMath.%s.scalar", sName);
+	reportResult(sResult, batch.m_n / fScalarMs / 1000, "Mpairs/s", false);
+	snprintf(sResult, sizeof(sResult), "pathMath.%s.batch", sName);
+	reportResult(sResult, batch.m_n / fBatchMs / 1000, "Mpairs/s", false);
+}
+
+void benchPathMath()
+{
+	printf("max relative error of log, allowed in the last column\n");
+	printf("%8s %8s %14s %14s %14s %14s\n", "math", "function", "SIMD_SCALAR", "SIMD_AVX2", "SIMD_AVX512", "double");
+	checkLogAccuracy<ExactPathMath>("exact", 1e-15, true);
+	checkLogAccuracy<FastPathMath>("fast", 1e-8, false);
+	checkLogAccuracy<TablePathMath>("table", 1e-9, true);
+
+	const NvU32 nPairs = 1 << 20;
+	std::mt19937 gen(1);
+	std::uniform_real_distribution<float> coord(-1.f, 1.f);
+	std::uniform_real_distribution<double> uniform01(0., 1.);
+	std::vector<float> coords[6];
+	std::vector<double> f01Numbers(nPairs);
+	for (NvU32 u = 0; u < nPairs; ++u)
+	{
+		for (NvU32 uCoord = 0; uCoord < 6; ++uCoord)
+		{
+			coords[uCoord].push_back(coord(gen));
+		}
+		f01Numbers[u] = uniform01(gen);
+	}
+	std::vector<double> refAction(nPairs), refTime(nPairs), refWeight(nPairs);
+	for (NvU32 u = 0; u < nPairs; ++u)
+	{
+		float3 fromP = makefloat3(coords[0][u], coords[1][u], coords[2][u]);
+		float3 toP = makefloat3(coords[3][u], coords[4][u], coords[5][u]);
+		generatePathTime(fromP, toP, f01Numbers[u], refAction[u], refTime[u], refWeight[u]);
+	}
+	std::vector<double> action(nPairs), time(nPairs), weight(nPairs);
+	PathBatch batch = { coords[0].data(), coords[1].data(), coords[2].data(), coords[3].data(), coords[4].data(), coords[5].data(),
+		f01Numbers.data(), action.data(), time.data(), weight.data(), nPairs };
+	// time and action against generatePathTime() with libm, both the scalar function and the widest batch
+	printf("%8s %14s %14s %14s\n", "math", "scalar Mpairs/s", "batch Mpairs/s", "maxRelDiff");
+	benchPolicy<ExactPathMath>("exact", batch, refAction.data(), refTime.data(), 1e-10);
+	benchPolicy<FastPathMath>("fast", batch, refAction.data(), refTime.data(), 1e-6);
+	benchPolicy<TablePathMath>("table", batch, refAction.data(), refTime.data(), 1e-6);
+}
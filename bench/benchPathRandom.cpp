@@ -0,0 +1,108 @@
+#include <random>
+#include "bench.h"
+#include "../wave.h"
+#include "../pathKernel.h"
+
+// every leaf samples one path to each of its neighbors - random numbers come from (step, leaf, neighbor number)
+static void samplePaths(World& world, NvU64 step, std::vector<double>& leafSums)
+{
+	const InteractionLists& lists = world.getInteractions();
+	const Storage& storage = world.accessStorage();
+	leafSums.assign(lists.getNLeaves(), 0.);
+	std::unique_ptr<ThreadPool> pPool(world.getNThreads() > 1 ? new ThreadPool(world.getNThreads()) : nullptr);
+	parallelFor(pPool.get(), lists.getNLeaves(), [&](NvU32 uSlot)
+	{
+		NvU32 nNeighbors = lists.getNNeighbors(uSlot), leafIndex = lists.getLeafIndex(uSlot);
+		std::vector<float> coords[6];
+		std::vector<double> f01Numbers(nNeighbors), action(nNeighbors), time(nNeighbors), weight(nNeighbors);
+		const float3& vFrom = storage[leafIndex].getCenter();
+		for (NvU32 u = 0; u < nNeighbors; ++u)
+		{
+			const float3& vTo = storage[lists.getLeafIndex(lists.getNeighbors(uSlot)[u])].getCenter();
+			for (NvU32 uDim = 0; uDim < 3; ++uDim)
+			{
+				coords[uDim].push_back(vFrom[uDim]);
+				coords[3 + uDim].push_back(vTo[uDim]);
+			}
+		}
+		world.getPathRandom().generate01(step, leafIndex, 0, f01Numbers.data(), nNeighbors);
+		PathBatch batch = { coords[0].data(), coords[1].data(), coords[2].data(), coords[3].data(), coords[4].data(), coords[5].data(),
+			f01Numbers.data(), action.data(), time.data(), weight.data(), nNeighbors };
+		generatePathTimes(batch);
+		for (NvU32 u = 0; u < nNeighbors; ++u)
+		{
+			leafSums[uSlot] += action[u] * weight[u];
+		}
+	});
+}
+
+void benchPathRandom()
+{
+	// SIMD batches must give exactly the same numbers as one-at-a-time generation, for any start and length
+	PathRandom pathRandom(12345);
+	std::vector<double> numbers(1000);
+	for (NvU32 uFirst = 0; uFirst < 20; ++uFirst)
+	{
+		for (NvU32 uLevel = SIMD_SCALAR; uLevel <= (NvU32)getMaxSimdLevel(); ++uLevel)
+		{
+			NvU32 n = 37 + uFirst * 41;
+			pathRandom.generate01(7, 3, uFirst, numbers.data(), n, (SimdLevel)uLevel);
+			for (NvU32 u = 0; u < n; ++u)
+			{
+				nvRelAssert(numbers[u] == pathRandom.get01(7, 3, uFirst + u) && numbers[u] >= 0 && numbers[u] < 1);
+			}
+		}
+	}
+	// known answer from the Philox paper (Random123 kat_vectors): counter and key of all ones
+	{
+		NvU32 counter[4] = { 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff }, key[2] = { 0xffffffff, 0xffffffff }, out[4];
+		Philox4x32::generate(counter, key, out);
+		nvRelAssert(out[0] == 0x408f276d && out[1] == 0x41c83b0e && out[2] == 0xa20bc7c6 && out[3] == 0x6d5451fd);
+	}
+
+	const NvU32 nNumbers = 1 << 22;
+	numbers.resize(nNumbers);
+	printf("%16s %12s %14s\n", "generator", "ms", "Mnumbers/s");
+	double fCheckSum = 0;
+	{
+		std::mt19937_64 gen(1);
+		std::uniform_real_distribution<double> uniform01(0., 1.);
+		BenchTimer timer;
+		for (NvU32 u = 0; u < nNumbers; ++u)
+		{
+			numbers[u] = uniform01(gen);
+		}
+		double fMs = timer.getMilliseconds();
+		fCheckSum += numbers[nNumbers / 2];
+		printf("%16s %12.3f %14.1f\n", "mt19937_64", fMs, nNumbers / fMs / 1000);
+	}
+	static const char* pNames[] = { "philox scalar", "philox AVX2", "philox AVX-512" };
+	for (NvU32 uLevel = SIMD_SCALAR; uLevel <= (NvU32)getMaxSimdLevel(); ++uLevel)
+	{
+		BenchTimer timer;
+		pathRandom.generate01(1, 0, 0, numbers.data(), nNumbers, (SimdLevel)uLevel);
+		double fMs = timer.getMilliseconds();
+		fCheckSum += numbers[nNumbers / 2];
+		printf("%16s %12.3f %14.1f\n", pNames[uLevel], fMs, nNumbers / fMs / 1000);
+	}
+	nvRelAssert(fCheckSum > 0);
+
+	// sampling results must be bit-identical for any number of threads
+	World world;
+	world.setSeed(42);
+	world.initialize(5);
+	world.makeSimulationStep(); // builds interaction lists
+	std::vector<double> refSums, sums;
+	samplePaths(world, world.getStepIndex(), refSums);
+	printf("%8s %12s %10s\n", "threads", "sample ms", "identical");
+	for (NvU32 nThreads = 1; nThreads <= mymax(std::thread::hardware_concurrency(), 4U); nThreads *= 2)
+	{
+		world.setNThreads(nThreads);
+		BenchTimer timer;
+		samplePaths(world, world.getStepIndex(), sums);
+		double fMs = timer.getMilliseconds();
+		bool isIdentical = memcmp(sums.data(), refSums.data(), sums.size() * sizeof(double)) == 0;
+		nvRelAssert(isIdentical);
+		printf("%8u %12.3f %10s\n", nThreads, fMs, isIdentical ? "yes" : "no");
+	}
+}
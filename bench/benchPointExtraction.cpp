@@ -0,0 +1,97 @@
+#include <random>
+#include <array>
+#include <algorithm>
+#include "bench.h"
+#include "../wave.h"
+
+static const NvU32 N_FRAMES = 100;
+static const NvU32 N_SPLITS_PER_FRAME = 64;
+
+struct CollectLeafList : public Storage::InlineVisitor
+{
+	bool notifyEntering(GridElem& elem, const float3Box& box)
+	{
+		if (!elem.hasChildren())
+		{
+			m_leaves.push_back({ &elem, box });
+		}
+		return true;
+	}
+	std::vector<Storage::Subtree> m_leaves;
+};
+
+// leaves as sorted 6-point tuples, skipping degenerate ones - buffers with the same lines in any order compare equal
+static std::vector<std::array<float, 18>> getSortedLeaves(const std::vector<float3>& points)
+{
+	std::vector<std::array<float, 18>> leaves;
+	for (size_t u = 0; u < points.size(); u += 6)
+	{
+		std::array<float, 18> leaf;
+		for (NvU32 uPoint = 0; uPoint < 6; ++uPoint)
+		{
+			for (NvU32 uDim = 0; uDim < 3; ++uDim)
+			{
+				leaf[uPoint * 3 + uDim] = points[u + uPoint][uDim];
+			}
+		}
+		if (leaf[0] != leaf[3] || leaf[1] != leaf[4] || leaf[2] != leaf[5])
+		{
+			leaves.push_back(leaf);
+		}
+	}
+	std::sort(leaves.begin(), leaves.end());
+	return leaves;
+}
+
+// every frame a few leaves are split and the ones split on the previous frame are merged back - roughly what
+// adaptation does to a big tree when the front moves a little
+void benchPointExtraction()
+{
+	World world;
+	world.initialize(6);
+	Storage& storage = world.accessStorage();
+	CollectLeafList collectLeaves;
+	storage.visit(0, collectLeaves);
+	printf("%u leaves, %u splits and %u merges per frame\n", (NvU32)collectLeaves.m_leaves.size(), N_SPLITS_PER_FRAME, N_SPLITS_PER_FRAME);
+
+	std::vector<float3> fullPoints, points;
+	std::vector<World::PointRange> ranges;
+	world.updatePoints(points, ranges);
+	std::mt19937 gen(1);
+	std::vector<GridElem*> splitLeaves;
+	double fFullMs = 0, fIncrementalMs = 0;
+	NvU64 nChangedPoints = 0;
+	for (NvU32 uFrame = 0; uFrame < N_FRAMES; ++uFrame)
+	{
+		for (GridElem* pElem : splitLeaves)
+		{
+			pElem->merge(world, storage);
+		}
+		splitLeaves.clear();
+		for (NvU32 u = 0; u < N_SPLITS_PER_FRAME; ++u)
+		{
+			const Storage::Subtree& leaf = collectLeaves.m_leaves[gen() % collectLeaves.m_leaves.size()];
+			if (leaf.m_pElem->hasChildren())
+				continue;
+			leaf.m_pElem->split(world, storage, leaf.m_box);
+			splitLeaves.push_back(leaf.m_pElem);
+		}
+
+		BenchTimer timer;
+		fullPoints.clear();
+		world.readPoints(fullPoints);
+		fFullMs += timer.getMilliseconds();
+
+		timer.reset();
+		world.updatePoints(points, ranges);
+		fIncrementalMs += timer.getMilliseconds();
+		for (const World::PointRange& range : ranges)
+		{
+			nChangedPoints += range.m_nPoints;
+		}
+	}
+	nvRelAssert(getSortedLeaves(points) == getSortedLeaves(fullPoints));
+	printf("%14s %12s %16s\n", "extraction", "ms/frame", "points/frame");
+	printf("%14s %12.3f %16zu\n", "readPoints", fFullMs / N_FRAMES, fullPoints.size());
+	printf("%14s %12.3f %16llu\n", "updatePoints", fIncrementalMs / N_FRAMES, (unsigned long long)(nChangedPoints / N_FRAMES));
+}
@@ -0,0 +1,145 @@
+#include <random>
+#include <algorithm>
+#include "bench.h"
+#include "../Power2Distribution.h"
+#include "../quasiRandom.h"
+
+// the integral of this function must be equal to 30 / 2 + 120 / 2 = 75
+static double testF(double x)
+{
+	if (x < 1) return 0;
+	if (x < 31) return (x - 1) / (31 - 1);
+	if (x < 151) return (151 - x) / (151 - 31);
+	return 0;
+}
+static const double TEST_INTEGRAL = 75, TEST_MAX_PDF_LOCATION = 31;
+
+// every one of 13 intervals gets the same share of samples, so the density of samples in the interval with weight w
+// is 1 / (13 * w * smallestIntervalSize) and the integral is the average of testF(x) * w * 13 * smallestIntervalSize
+static double integrate(const std::vector<double>& in01Numbers, std::vector<double>& values, std::vector<double>& weights)
+{
+	size_t n = in01Numbers.size();
+	values.resize(n);
+	weights.resize(n);
+	Power2Distribution::generate(in01Numbers.data(), values.data(), weights.data(), n, TEST_MAX_PDF_LOCATION);
+	double fSum = 0;
+	for (size_t u = 0; u < n; ++u)
+	{
+		fSum += testF(values[u]) * weights[u];
+	}
+	NvU32 nIntervals = Power2Distribution::MAX_LEFT_EXPONENT + Power2Distribution::MAX_RIGHT_EXPONENT;
+	return fSum / n * nIntervals * TEST_MAX_PDF_LOCATION / (1 << Power2Distribution::MAX_LEFT_EXPONENT);
+}
+
+void benchPower2Distribution()
+{
+	// batch results must be exactly the same as the scalar ones. also checks what dbgDoesTestPass() used to check:
+	// distance between neighboring values decreases towards fMaxPDFLocation and increases after it
+	const NvU32 nSamples = 1024 * 16;
+	std::vector<double> in01Numbers(nSamples), values(nSamples), weights(nSamples);
+	for (NvU32 u = 0; u < nSamples; ++u)
+	{
+		in01Numbers[u] = u / (double)(nSamples - 1);
+	}
+	for (NvU32 uLevel = SIMD_SCALAR; uLevel <= (NvU32)getMaxSimdLevel(); ++uLevel)
+	{
+		Power2Distribution::generate(in01Numbers.data(), values.data(), weights.data(), nSamples, TEST_MAX_PDF_LOCATION, (SimdLevel)uLevel);
+		for (NvU32 u = 0; u < nSamples; ++u)
+		{
+			double fWeight;
+			double fValue = Power2Distribution::generate(in01Numbers[u], TEST_MAX_PDF_LOCATION, fWeight);
+			nvRelAssert(fValue == values[u] && fWeight == weights[u]);
+			if (u < 2)
+				continue;
+			double fStep = values[u] - values[u - 1], fPrevStep = values[u - 1] - values[u - 2];
+			if (values[u] > TEST_MAX_PDF_LOCATION)
+			{
+				nvRelAssert(fStep >= fPrevStep / 1.1 && fStep <= fPrevStep * 2.1);
+			}
+			else
+			{
+				nvRelAssert(fStep <= fPrevStep * 1.1 && fStep >= fPrevStep / 2.1);
+			}
+		}
+	}
+	// unscrambled Sobol sequence must put exactly one of the first 2^k numbers into every interval [j / 2^k, (j + 1) / 2^k)
+	for (NvU32 uDim = 0; uDim < SobolSequence::MAX_DIMENSIONS; ++uDim)
+	{
+		SobolSequence sobol(uDim);
+		std::vector<NvU32> cells(1024);
+		for (NvU32 u = 0; u < 1024; ++u)
+		{
+			cells[u] = (NvU32)(sobol.next() * 1024);
+		}
+		std::sort(cells.begin(), cells.end());
+		for (NvU32 u = 0; u < 1024; ++u)
+		{
+			nvRelAssert(cells[u] == u);
+		}
+	}
+
+	// absolute error of the integral. random and scrambled Sobol are averaged over several independent runs
+	printf("integration error\n%10s %12s %12s %12s %12s %12s\n", "samples", "random", "grid", "halton(3)", "sobol(1)", "sobol scr.");
+	const NvU32 nRuns = 16;
+	for (NvU32 n = 256; n <= (1 << 20); n *= 4)
+	{
+		in01Numbers.resize(n);
+		double fErrors[5] = { };
+		for (NvU32 uRun = 0; uRun < nRuns; ++uRun)
+		{
+			std::mt19937_64 gen(uRun);
+			std::uniform_real_distribution<double> uniform01(0., 1.);
+			for (double& f : in01Numbers)
+			{
+				f = uniform01(gen);
+			}
+			fErrors[0] += fabs(integrate(in01Numbers, values, weights) - TEST_INTEGRAL) / nRuns;
+			SobolSequence(1, (NvU32)gen()).generate(in01Numbers.data(), n);
+			fErrors[4] += fabs(integrate(in01Numbers, values, weights) - TEST_INTEGRAL) / nRuns;
+		}
+		for (NvU32 u = 0; u < n; ++u)
+		{
+			in01Numbers[u] = (u + 0.5) / n;
+		}
+		fErrors[1] = fabs(integrate(in01Numbers, values, weights) - TEST_INTEGRAL);
+		HaltonSequence(3).generate(in01Numbers.data(), n);
+		fErrors[2] = fabs(integrate(in01Numbers, values, weights) - TEST_INTEGRAL);
+		SobolSequence(1).generate(in01Numbers.data(), n);
+		fErrors[3] = fabs(integrate(in01Numbers, values, weights) - TEST_INTEGRAL);
+		printf("%10u %12.3e %12.3e %12.3e %12.3e %12.3e\n", n, fErrors[0], fErrors[1], fErrors[2], fErrors[3], fErrors[4]);
+	}
+
+	// throughput
+	const NvU32 nThroughputSamples = 1 << 22;
+	in01Numbers.resize(nThroughputSamples);
+	values.resize(nThroughputSamples);
+	weights.resize(nThroughputSamples);
+	printf("throughput\n%16s %12s %14s\n", "generator", "ms", "Msamples/s");
+	BenchTimer timer;
+	SobolSequence(1).generate(in01Numbers.data(), nThroughputSamples);
+	double fMs = timer.getMilliseconds();
+	printf("%16s %12.3f %14.1f\n", "sobol", fMs, nThroughputSamples / fMs / 1000);
+	timer.reset();
+	HaltonSequence(3).generate(in01Numbers.data(), nThroughputSamples);
+	fMs = timer.getMilliseconds();
+	printf("%16s %12.3f %14.1f\n", "halton", fMs, nThroughputSamples / fMs / 1000);
+	timer.reset();
+	double fCheckSum = 0;
+	for (NvU32 u = 0; u < nThroughputSamples; ++u)
+	{
+		values[u] = Power2Distribution::generate(in01Numbers[u], TEST_MAX_PDF_LOCATION, weights[u]);
+	}
+	fMs = timer.getMilliseconds();
+	fCheckSum += values[nThroughputSamples / 2];
+	printf("%16s %12.3f %14.1f\n", "generate()", fMs, nThroughputSamples / fMs / 1000);
+	static const char* pNames[] = { "batch scalar", "batch AVX2", "batch AVX-512" };
+	for (NvU32 uLevel = SIMD_SCALAR; uLevel <= (NvU32)getMaxSimdLevel(); ++uLevel)
+	{
+		timer.reset();
+		Power2Distribution::generate(in01Numbers.data(), values.data(), weights.data(), nThroughputSamples, TEST_MAX_PDF_LOCATION, (SimdLevel)uLevel);
+		fMs = timer.getMilliseconds();
+		fCheckSum += values[nThroughputSamples / 2];
+		printf("%16s %12.3f %14.1f\n", pNames[uLevel], fMs, nThroughputSamples / fMs / 1000);
+	}
+	nvRelAssert(fCheckSum > 0);
+}
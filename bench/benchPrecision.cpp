@@ -0,0 +1,57 @@
+#include <vector>
+#include "bench.h"
+#include "../wave.h"
+
+// every policy on the same tree. double is the reference for accuracy: its distances are rounded once and its sums
+// are long, so whatever the other two lose shows up as the difference to it
+void benchPrecision()
+{
+	const NvU32 depth = 5, nSteps = 5;
+	printf("%8s %8s %8s %16s %12s %14s %14s\n", "layout", "cache", "math", "leafInfluence ms", "step ms", "maxRelDiff", "rmsRelDiff");
+	for (NvU32 uLayout = 0; uLayout < 2; ++uLayout)
+	{
+		for (NvU32 uCache = 0; uCache < 2; ++uCache)
+		{
+			World world;
+			world.setStorageLayout(uLayout ? GRID_LAYOUT_SOA : GRID_LAYOUT_AOS);
+			world.setUsePairCache(uCache == 1);
+			world.initialize(depth);
+			std::vector<double2> refInfluence;
+			for (NvU32 uPrecision = PRECISION_COUNT; uPrecision-- > 0; )
+			{
+				world.setPrecision((Precision)uPrecision);
+				// the first step fills the cache
+				world.makeSimulationStep();
+				double fStepMs = 1e30, fInfluenceMs = 1e30;
+				for (NvU32 uStep = 0; uStep < nSteps; ++uStep)
+				{
+					BenchTimer timer;
+					world.makeSimulationStep();
+					fStepMs = mymin(fStepMs, timer.getMilliseconds());
+					fInfluenceMs = mymin(fInfluenceMs, world.getStepStats().m_fMs[TIMER_LEAF_INFLUENCE]);
+				}
+				const std::vector<double2>& influence = world.getLeafInfluence();
+				if (uPrecision == PRECISION_DOUBLE)
+				{
+					refInfluence = influence;
+				}
+				double fMaxRelDiff = 0, fSumRelDiff2 = 0;
+				for (NvU32 u = 0; u < influence.size(); ++u)
+				{
+					double fRelDiff = length(influence[u] - refInfluence[u]) / length(refInfluence[u]);
+					fMaxRelDiff = mymax(fMaxRelDiff, fRelDiff);
+					fSumRelDiff2 += fRelDiff * fRelDiff;
+				}
+				// float sums of ~100 terms can't be better than a few 1e-7
+				nvRelAssert(fMaxRelDiff < (uPrecision == PRECISION_FLOAT ? 1e-5 : 1e-6));
+				printf("%8s %8s %8s %16.3f %12.3f %14.3e %14.3e\n", uLayout ? "SoA" : "AoS", uCache ? "on" : "off",
+					getPrecisionName((Precision)uPrecision), fInfluenceMs, fStepMs, fMaxRelDiff, sqrt(fSumRelDiff2 / influence.size()));
+				fflush(stdout);
+				char sName[64];
+				snprintf(sName, sizeof(sName), "precision.%s.%s.%s", uLayout ? "soa" : "aos", uCache ? "cached" : "uncached",
+					getPrecisionName((Precision)uPrecision));
+				reportResult(sName, fInfluenceMs, "ms", true);
+			}
+		}
+	}
+}
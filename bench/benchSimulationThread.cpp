@@ -0,0 +1,171 @@
+#include <vector>
+#include <thread>
+#include <string.h>
+#include "bench.h"
+#include "../wave.h"
+#include "../simulationThread.h"
+
+static NvU64 computeChecksum(NvU64 stepIndex, const std::vector<float3>& points, const std::vector<float2>& timePhases)
+{
+	NvU64 checksum = stepIndex;
+	const float* pFloats[2] = { (const float*)points.data(), (const float*)timePhases.data() };
+	size_t nFloats[2] = { points.size() * 3, timePhases.size() * 2 };
+	for (NvU32 uArray = 0; uArray < 2; ++uArray)
+	{
+		for (size_t u = 0; u < nFloats[uArray]; ++u)
+		{
+			NvU32 word;
+			memcpy(&word, &pFloats[uArray][u], sizeof(word));
+			checksum = checksum * 0x100000001b3ULL + word;
+		}
+	}
+	return checksum;
+}
+
+// leaves of one octant get amplitude 1, the rest 0
+struct SetOctantVisitor : public Storage::InlineVisitor
+{
+	SetOctantVisitor(Storage& storage) : m_storage(storage) { }
+	bool notifyEntering(GridElem& elem, const float3Box& box)
+	{
+		if (!elem.hasChildren())
+		{
+			bool isInOctant = box[0].x >= 0 && box[0].y >= 0 && box[0].z >= 0;
+			m_storage.setTimePhase(elem, makefloat2(isInOctant ? 1.f : 0.f, 0.f));
+		}
+		return true;
+	}
+private:
+	Storage& m_storage;
+};
+
+// with isAdapting one octant is refined a level per step during the first steps while the tree is compacted, so
+// snapshots also have to pick up splits and moved elements in a part of the tree
+static void initializeWorld(World& world, NvU32 depth, bool isAdapting)
+{
+	if (!isAdapting)
+	{
+		world.initialize(depth);
+		return;
+	}
+	AdaptParams params;
+	params.m_fRefineError = 0.05f;
+	params.m_fCoarsenError = 0.02f;
+	params.m_maxDepth = depth + 3;
+	params.m_fMaxFragmentation = 0.2f;
+	world.setAdaptParams(params);
+	world.initialize(1);
+	SetOctantVisitor setOctant(world.accessStorage());
+	world.accessStorage().visit(0, setOctant);
+}
+
+enum ConsumerKind { CONSUMER_NONE, CONSUMER_BUSY, CONSUMER_60HZ, CONSUMER_COUNT };
+
+struct SeenSnapshot
+{
+	NvU64 m_stepIndex, m_checksum;
+};
+
+// steps per second of the simulation thread while the consumer does its thing for fDurationMs. CONSUMER_BUSY takes
+// snapshots as fast as it can and checksums each of them, CONSUMER_60HZ looks at the latest one once per frame of a
+// 60 Hz display - what the viewer does
+static double runThread(NvU32 depth, bool isAdapting, ConsumerKind kind, double fDurationMs, std::vector<SeenSnapshot>& seen)
+{
+	World world;
+	initializeWorld(world, depth, isAdapting);
+	SimulationThread simulation;
+	BenchTimer timer;
+	simulation.start(world);
+	while (timer.getMilliseconds() < fDurationMs)
+	{
+		if (kind == CONSUMER_NONE || kind == CONSUMER_60HZ)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(kind == CONSUMER_NONE ? 10 : 16));
+		}
+		if (kind != CONSUMER_NONE && simulation.acquireSnapshot())
+		{
+			const SimulationSnapshot& snapshot = simulation.getSnapshot();
+			nvRelAssert(snapshot.m_points.size() == snapshot.m_timePhases.size() * 6 && !snapshot.m_points.empty());
+			// only newer steps, never the same one twice
+			nvRelAssert(seen.empty() || snapshot.m_stepIndex > seen.back().m_stepIndex);
+			seen.push_back({ snapshot.m_stepIndex, kind == CONSUMER_BUSY ?
+				computeChecksum(snapshot.m_stepIndex, snapshot.m_points, snapshot.m_timePhases) : 0 });
+		}
+	}
+	simulation.stop();
+	double fMs = timer.getMilliseconds();
+	nvRelAssert(world.getStepIndex() == simulation.getNSteps());
+	return simulation.getNSteps() * 1000. / fMs;
+}
+
+// a torn snapshot (one the producer was still writing), a stale one or one that missed some changed ranges would not
+// match the leaves of the same step read from scratch on the calling thread
+static void checkSnapshots(NvU32 depth, bool isAdapting, const std::vector<SeenSnapshot>& seen)
+{
+	nvRelAssert(!seen.empty());
+	World world;
+	initializeWorld(world, depth, isAdapting);
+	std::vector<float3> points;
+	std::vector<float2> timePhases;
+	std::vector<World::PointRange> changedRanges;
+	NvU32 nChecked = 0;
+	for (const SeenSnapshot& snapshot : seen)
+	{
+		while (world.getStepIndex() < snapshot.m_stepIndex)
+		{
+			world.makeSimulationStep();
+		}
+		// restarting change tracking makes updatePoints() write everything
+		world.accessStorage().setTrackChanges(false);
+		world.updatePoints(points, changedRanges, &timePhases);
+		nvRelAssert(computeChecksum(snapshot.m_stepIndex, points, timePhases) == snapshot.m_checksum);
+		++nChecked;
+	}
+	printf("%u snapshots%s are the same as leaves read from scratch on the calling thread\n", nChecked, isAdapting ? " of adapting tree" : "");
+}
+
+void benchSimulationThread()
+{
+	const NvU32 depth = 3;
+	const double fDurationMs = 1000;
+	// what the viewer did before: step and update of the points on the render thread, so a frame can't be shorter than that
+	World world;
+	world.initialize(depth);
+	std::vector<float3> points;
+	std::vector<World::PointRange> changedRanges;
+	world.makeSimulationStep();
+	world.updatePoints(points, changedRanges);
+	BenchTimer timer;
+	NvU32 nSyncSteps = 0;
+	for (; timer.getMilliseconds() < fDurationMs; ++nSyncSteps)
+	{
+		world.makeSimulationStep();
+		world.updatePoints(points, changedRanges);
+	}
+	double fSyncRate = nSyncSteps * 1000. / timer.getMilliseconds();
+
+	printf("depth %u, %u leaves, %u hardware threads\n", depth, world.getInteractions().getNLeaves(), std::thread::hardware_concurrency());
+	printf("%12s %12s %12s %12s\n", "consumer", "steps/s", "snapshots", "vs calling");
+	printf("%12s %12.1f %12s %12s\n", "sync", fSyncRate, "-", "1.00x");
+	reportResult("simulationThread.sync", fSyncRate, "steps/s", false);
+	const char* pNames[CONSUMER_COUNT] = { "none", "busy", "60Hz" };
+	std::vector<SeenSnapshot> busySeen;
+	for (NvU32 uKind = 0; uKind < CONSUMER_COUNT; ++uKind)
+	{
+		std::vector<SeenSnapshot> seen;
+		double fRate = runThread(depth, false, (ConsumerKind)uKind, fDurationMs, seen);
+		printf("%12s %12.1f %12u %11.2fx\n", pNames[uKind], fRate, (NvU32)seen.size(), fRate / fSyncRate);
+		fflush(stdout);
+		char sName[64];
+		snprintf(sName, sizeof(sName), "simulationThread.%s", pNames[uKind]);
+		reportResult(sName, fRate, "steps/s", false);
+		if (uKind == CONSUMER_BUSY)
+		{
+			busySeen.swap(seen);
+		}
+	}
+	checkSnapshots(depth, false, busySeen);
+	busySeen.clear();
+	runThread(depth, true, CONSUMER_BUSY, fDurationMs / 4, busySeen);
+	checkSnapshots(depth, true, busySeen);
+}
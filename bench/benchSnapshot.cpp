@@ -0,0 +1,69 @@
+#include "bench.h"
+#include "../wave.h"
+
+static const NvU32 DEPTH = 7;
+static const char* SNAPSHOT_PATH = "benchSnapshot.bin";
+
+struct ChecksumVisitor : public Storage::InlineVisitor
+{
+	ChecksumVisitor(Storage& storage, bool shouldSetPhases) : m_storage(storage), m_shouldSetPhases(shouldSetPhases) { }
+	bool notifyEntering(GridElem& elem, const float3Box& box)
+	{
+		if (m_shouldSetPhases)
+		{
+			m_storage.setTimePhase(elem, makefloat2(elem.getCenter().x, elem.getCenter().y * elem.getCenter().z));
+		}
+		m_fSum += elem.getTimePhase().x + elem.getTimePhase().y * 3 + box[0].z * 7;
+		return true;
+	}
+	double m_fSum = 0;
+private:
+	Storage& m_storage;
+	bool m_shouldSetPhases;
+};
+
+void benchSnapshot()
+{
+	BenchTimer timer;
+	World world;
+	world.initialize(DEPTH);
+	world.setSeed(12345);
+	double fBuildMs = timer.getMilliseconds();
+	ChecksumVisitor setPhases(world.accessStorage(), true);
+	world.accessStorage().visit(0, setPhases);
+	size_t nBytes = world.accessStorage().getNChildren() * sizeof(GridElem);
+	printf("depth %u, %u children, %.1f MB of children\n", DEPTH, world.accessStorage().getNChildren(), nBytes / 1e6);
+	printf("%20s %12s %12s\n", "", "ms", "MB/s");
+	printf("%20s %12.3f\n", "initialize", fBuildMs);
+
+	timer.reset();
+	nvRelAssert(world.saveSnapshot(SNAPSHOT_PATH));
+	double fMs = timer.getMilliseconds();
+	printf("%20s %12.3f %12.1f\n", "save", fMs, nBytes / fMs / 1000);
+
+	timer.reset();
+	World loadedWorld;
+	nvRelAssert(loadedWorld.loadSnapshot(SNAPSHOT_PATH));
+	fMs = timer.getMilliseconds();
+	printf("%20s %12.3f %12.1f\n", "load (map)", fMs, nBytes / fMs / 1000);
+
+	// the first traversal pages everything in
+	for (NvU32 uPass = 0; uPass < 2; ++uPass)
+	{
+		timer.reset();
+		ChecksumVisitor checksum(loadedWorld.accessStorage(), false);
+		loadedWorld.accessStorage().visit(0, checksum);
+		fMs = timer.getMilliseconds();
+		printf("%20s %12.3f %12.1f\n", uPass == 0 ? "first traversal" : "second traversal", fMs, nBytes / fMs / 1000);
+		nvRelAssert(checksum.m_fSum == setPhases.m_fSum);
+	}
+	nvRelAssert(loadedWorld.getStepIndex() == world.getStepIndex() && loadedWorld.getPathRandom().getSeed() == 12345);
+
+	// writes go to copy-on-write pages, the file stays as it was
+	timer.reset();
+	ChecksumVisitor writePhases(loadedWorld.accessStorage(), true);
+	loadedWorld.accessStorage().visit(0, writePhases);
+	fMs = timer.getMilliseconds();
+	printf("%20s %12.3f %12.1f\n", "first write", fMs, nBytes / fMs / 1000);
+	remove(SNAPSHOT_PATH);
+}
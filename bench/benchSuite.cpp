@@ -0,0 +1,233 @@
+#include <random>
+#include "bench.h"
+#include "../wave.h"
+#include "../pathKernel.h"
+
+// fixed set of measurements that is run by "make bench-check" and compared against bench/baseline.json. names of
+// reported results must not change, otherwise they are compared with nothing
+
+static const NvU32 TRAVERSAL_DEPTH = 7, MAX_STEP_DEPTH = 5;
+
+// best of several runs - short measurements are too noisy to compare against a baseline otherwise
+template <class FUNC>
+static double measureBestMs(FUNC func)
+{
+	double fBestMs = 1e30, fTotalMs = 0;
+	for (NvU32 u = 0; u < 3 || (fTotalMs < 200 && u < 1000); ++u)
+	{
+		BenchTimer timer;
+		func();
+		double fMs = timer.getMilliseconds();
+		fBestMs = mymin(fBestMs, fMs);
+		fTotalMs += fMs;
+	}
+	return fBestMs;
+}
+
+// approximate bytes initialize(depth) needs: all levels of children plus some for the roots and interaction lists
+static size_t getTreeBytes(NvU32 depth)
+{
+	size_t nElems = 0;
+	for (NvU32 u = 1; u <= depth; ++u)
+	{
+		nElems = nElems * 8 + 8;
+	}
+	return nElems * sizeof(GridElem) * 2;
+}
+
+static void benchInitialize()
+{
+	char sName[64];
+	for (NvU32 depth = 3; depth <= 9; ++depth)
+	{
+		if (getTreeBytes(depth) > getPhysicalBytes() / 2)
+		{
+			printf("initialize(%u) skipped: needs about %.1f GB, machine has %.1f GB\n", depth, getTreeBytes(depth) / 1e9, getPhysicalBytes() / 1e9);
+			continue;
+		}
+		NvU32 nChildren = 0;
+		double fMs = measureBestMs([&]()
+		{
+			World world;
+			world.initialize(depth);
+			nChildren = world.accessStorage().getNChildren();
+		});
+		printf("initialize(%u): %u children, %.3f ms\n", depth, nChildren, fMs);
+		snprintf(sName, sizeof(sName), "initialize.depth%u", depth);
+		reportResult(sName, nChildren / fMs / 1000, "Mnodes/s", false);
+	}
+}
+
+struct SuiteVirtual : public Storage::IVisitor
+{
+	virtual bool notifyEntering(GridElem& elem, const float3Box&)
+	{
+		m_fSum += elem.getCenter().x;
+		++m_nNodes;
+		return true;
+	}
+	virtual void notifyLeaving(GridElem&, const float3Box&) { }
+	NvU64 m_nNodes = 0;
+	double m_fSum = 0;
+};
+struct SuiteInline : public Storage::InlineVisitor
+{
+	bool notifyEntering(GridElem& elem, const float3Box&)
+	{
+		m_fSum += elem.getCenter().x;
+		++m_nNodes;
+		return true;
+	}
+	NvU64 m_nNodes = 0;
+	double m_fSum = 0;
+};
+
+template <class VISITOR>
+static void benchVisitor(Storage& storage, VISITOR& visitor, const NvU64& nNodes, const char* sName)
+{
+	NvU32 nRepeats = 0;
+	double fMs = measureBestMs([&]()
+	{
+		storage.visit(0, visitor);
+		++nRepeats;
+	});
+	double fRate = nNodes / nRepeats / fMs / 1000;
+	printf("%24s %12.3f ms %10.1f Mnodes/s\n", sName, fMs, fRate);
+	reportResult(sName, fRate, "Mnodes/s", false);
+}
+
+static void benchTraversals()
+{
+	World world;
+	world.initialize(TRAVERSAL_DEPTH);
+	Storage& storage = world.accessStorage();
+	SuiteVirtual suiteVirtual;
+	benchVisitor(storage, suiteVirtual, suiteVirtual.m_nNodes, "visit.virtual");
+	SuiteInline suiteInline;
+	benchVisitor(storage, suiteInline, suiteInline.m_nNodes, "visit.inline");
+
+	std::vector<float3> points;
+	double fMs = measureBestMs([&]() { world.readPoints(points); });
+	printf("%24s %12.3f ms\n", "readPoints", fMs);
+	reportResult("visit.readPoints", fMs, "ms", true);
+
+	std::vector<float3> slotPoints;
+	std::vector<World::PointRange> ranges;
+	BenchTimer timer;
+	world.updatePoints(slotPoints, ranges);
+	fMs = timer.getMilliseconds();
+	printf("%24s %12.3f ms\n", "updatePoints (all)", fMs);
+	reportResult("visit.updatePoints", fMs, "ms", true);
+
+	// thresholds nothing reaches, so this is the cost of the adaptation pass itself
+	AdaptParams params;
+	params.m_fRefineError = 1e30f;
+	params.m_fCoarsenError = 0;
+	world.setAdaptParams(params);
+	fMs = measureBestMs([&]() { nvRelAssert(world.adapt() == 0); });
+	printf("%24s %12.3f ms\n", "adapt (no changes)", fMs);
+	reportResult("visit.adapt", fMs, "ms", true);
+}
+
+static void benchAllocation()
+{
+	const NvU32 nGroups = 1 << 18;
+	std::vector<NvU32> indices(nGroups);
+	double fFreshMs = measureBestMs([&]()
+	{
+		Storage storage;
+		for (NvU32 u = 0; u < nGroups; ++u)
+		{
+			indices[u] = storage.allocate8Children();
+		}
+	});
+	printf("%24s %12.3f ms %10.1f Mgroups/s\n", "allocate8Children", fFreshMs, nGroups / fFreshMs / 1000);
+	reportResult("allocate8Children.fresh", nGroups / fFreshMs / 1000, "Mgroups/s", false);
+
+	Storage storage;
+	for (NvU32 u = 0; u < nGroups; ++u)
+	{
+		indices[u] = storage.allocate8Children();
+	}
+	// free and allocate again - groups come from the free list, the array doesn't grow
+	double fReuseMs = measureBestMs([&]()
+	{
+		for (NvU32 u = 0; u < nGroups; ++u)
+		{
+			storage.free8Children(indices[u]);
+		}
+		for (NvU32 u = 0; u < nGroups; ++u)
+		{
+			indices[u] = storage.allocate8Children();
+		}
+	});
+	nvRelAssert(storage.getNChildren() == nGroups * 8);
+	printf("%24s %12.3f ms %10.1f Mgroups/s\n", "allocate8Children (reuse)", fReuseMs, nGroups / fReuseMs / 1000);
+	reportResult("allocate8Children.reuse", nGroups / fReuseMs / 1000, "Mgroups/s", false);
+}
+
+static void benchPaths()
+{
+	const NvU32 nPairs = 1 << 20;
+	std::mt19937 gen(1);
+	std::uniform_real_distribution<float> coord(-1.f, 1.f);
+	std::uniform_real_distribution<double> uniform01(0., 1.);
+	std::vector<float> coords[6];
+	std::vector<double> f01Numbers(nPairs);
+	for (NvU32 u = 0; u < nPairs; ++u)
+	{
+		for (NvU32 uCoord = 0; uCoord < 6; ++uCoord)
+		{
+			coords[uCoord].push_back(coord(gen));
+		}
+		f01Numbers[u] = uniform01(gen);
+	}
+	std::vector<double> action(nPairs), time(nPairs), weight(nPairs);
+	double fMs = measureBestMs([&]()
+	{
+		for (NvU32 u = 0; u < nPairs; ++u)
+		{
+			float3 fromP = makefloat3(coords[0][u], coords[1][u], coords[2][u]);
+			float3 toP = makefloat3(coords[3][u], coords[4][u], coords[5][u]);
+			generatePathTime(fromP, toP, f01Numbers[u], action[u], time[u], weight[u]);
+		}
+	});
+	printf("%24s %12.3f ms %10.1f Mpairs/s\n", "generatePathTime", fMs, nPairs / fMs / 1000);
+	reportResult("generatePathTime.scalar", nPairs / fMs / 1000, "Mpairs/s", false);
+
+	PathBatch batch = { coords[0].data(), coords[1].data(), coords[2].data(), coords[3].data(), coords[4].data(), coords[5].data(),
+		f01Numbers.data(), action.data(), time.data(), weight.data(), nPairs };
+	fMs = measureBestMs([&]() { generatePathTimes(batch); });
+	printf("%24s %12.3f ms %10.1f Mpairs/s\n", "generatePathTimes", fMs, nPairs / fMs / 1000);
+	reportResult("generatePathTime.batch", nPairs / fMs / 1000, "Mpairs/s", false);
+}
+
+static void benchSteps()
+{
+	char sName[64];
+	for (NvU32 depth = 3; depth <= MAX_STEP_DEPTH; ++depth)
+	{
+		World world;
+		world.initialize(depth);
+		world.setSeed(1);
+		// the first step builds interaction lists and the far field tree, later ones reuse them
+		BenchTimer timer;
+		world.makeSimulationStep();
+		double fFirstMs = timer.getMilliseconds();
+		double fMs = measureBestMs([&]() { world.makeSimulationStep(); });
+		printf("makeSimulationStep(depth %u): first %.3f ms, then %.3f ms\n", depth, fFirstMs, fMs);
+		snprintf(sName, sizeof(sName), "step.depth%u.first", depth);
+		reportResult(sName, fFirstMs, "ms", true);
+		snprintf(sName, sizeof(sName), "step.depth%u", depth);
+		reportResult(sName, fMs, "ms", true);
+	}
+}
+
+void benchSuite()
+{
+	benchInitialize();
+	benchTraversals();
+	benchAllocation();
+	benchPaths();
+	benchSteps();
+}
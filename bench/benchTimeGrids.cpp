@@ -0,0 +1,123 @@
+#include "bench.h"
+#include "../wave.h"
+
+// every leaf must own exactly one grid, interior nodes none
+struct CheckGridsVisitor : public Storage::InlineVisitor
+{
+	CheckGridsVisitor(const Storage& storage) : m_storage(storage) { }
+	bool notifyEntering(GridElem& elem, const float3Box&)
+	{
+		NvU32 grid = m_storage.getTimeGrid(elem);
+		nvRelAssert(elem.hasChildren() == (grid == LeafTimeGrids::INVALID_GRID));
+		m_nLeaves += elem.hasChildren() ? 0 : 1;
+		return true;
+	}
+	NvU32 m_nLeaves = 0;
+private:
+	const Storage& m_storage;
+};
+
+static void checkGrids(World& world)
+{
+	Storage& storage = world.accessStorage();
+	CheckGridsVisitor check(storage);
+	storage.visit(0, check);
+	nvRelAssert(check.m_nLeaves == storage.getTimeGrids().getNUsedGrids());
+}
+
+static void checkSplitAndMerge()
+{
+	World world;
+	world.setTimeGrids(true, 0.1);
+	world.initialize(2);
+	for (NvU32 u = 0; u < N_TIME_SLOTS; ++u)
+	{
+		world.makeSimulationStep();
+	}
+	checkGrids(world);
+
+	Storage& storage = world.accessStorage();
+	LeafTimeGrids& timeGrids = storage.accessTimeGrids();
+	NvU32 leafIndex = world.getInteractions().getLeafIndex(0);
+	GridElem& leaf = storage[leafIndex];
+	NvU32 leafGrid = storage.getChildTimeGrid(leafIndex);
+	TimeBox boxes[N_TIME_SLOTS];
+	for (NvU32 uSlot = 0; uSlot < N_TIME_SLOTS; ++uSlot)
+	{
+		boxes[uSlot] = timeGrids.getBox(leafGrid, uSlot);
+		nvRelAssert(boxes[uSlot].m_weightsSum == 1);
+	}
+	leaf.split(world, storage, storage.computeBox(leaf));
+	for (NvU32 uChild = 0; uChild < 8; ++uChild)
+	{
+		for (NvU32 uSlot = 0; uSlot < N_TIME_SLOTS; ++uSlot)
+		{
+			TimeBox box = timeGrids.getBox(storage.getChildTimeGrid(leaf.getFirstChild() + uChild), uSlot);
+			nvRelAssert(box.m_posAmpSum.x == boxes[uSlot].m_posAmpSum.x && box.m_posAmpSum.y == boxes[uSlot].m_posAmpSum.y);
+		}
+	}
+	checkGrids(world);
+	// average of 8 equal grids is the same grid
+	leaf.merge(world, storage);
+	for (NvU32 uSlot = 0; uSlot < N_TIME_SLOTS; ++uSlot)
+	{
+		TimeBox box = timeGrids.getBox(storage.getChildTimeGrid(leafIndex), uSlot);
+		nvRelAssert(fabs(box.m_posAmpSum.x - boxes[uSlot].m_posAmpSum.x) <= 1e-12 * fabs(boxes[uSlot].m_posAmpSum.x));
+	}
+	checkGrids(world);
+	storage.compact();
+	checkGrids(world);
+}
+
+void benchTimeGrids()
+{
+	checkSplitAndMerge();
+
+	const NvU32 depth = 6;
+	World world;
+	world.setTimeGrids(true, 0.1);
+	world.initialize(depth);
+	LeafTimeGrids& timeGrids = world.accessStorage().accessTimeGrids();
+	size_t nSlots = (size_t)timeGrids.getNGrids() * N_TIME_SLOTS;
+	for (NvU32 u = 0; u < timeGrids.getNGrids(); ++u)
+	{
+		timeGrids.addToBox(u, u % N_TIME_SLOTS, makedouble2((double)u, 1.), 1.);
+	}
+	printf("depth %u, %u leaves, %zu time slots, %.1f MB\n", depth, timeGrids.getNUsedGrids(), nSlots, nSlots * 3 * sizeof(double) / 1e6);
+
+	static const char* pNames[] = { "scalar", "AVX2", "AVX-512" };
+	printf("%10s %12s %14s %14s\n", "rotation", "ms", "Mslots/s", "maxAbsDiff");
+	TimeBox refBox;
+	for (NvU32 uLevel = SIMD_SCALAR; uLevel <= (NvU32)getMaxSimdLevel(); ++uLevel)
+	{
+		// full turn in nRepeats rotations - every level must get back to where it started
+		const NvU32 nRepeats = 64;
+		LeafTimeGrids copy = timeGrids;
+		BenchTimer timer;
+		for (NvU32 u = 0; u < nRepeats; ++u)
+		{
+			copy.rotate(2 * 3.14159265358979323846 / nRepeats, (SimdLevel)uLevel);
+		}
+		double fMs = timer.getMilliseconds() / nRepeats;
+		double fMaxDiff = 0;
+		for (NvU32 u = 0; u < copy.getNGrids(); u += 97)
+		{
+			TimeBox box = copy.getBox(u, u % N_TIME_SLOTS);
+			fMaxDiff = mymax(fMaxDiff, fabs(box.m_posAmpSum.x - (double)u) + fabs(box.m_posAmpSum.y - 1.));
+		}
+		nvRelAssert(fMaxDiff < 1e-6);
+		printf("%10s %12.3f %14.1f %14.3e\n", pNames[uLevel], fMs, nSlots / fMs / 1000, fMaxDiff);
+	}
+
+	// cost of time grids in a whole step
+	for (NvU32 uUseGrids = 0; uUseGrids < 2; ++uUseGrids)
+	{
+		World stepWorld;
+		stepWorld.setTimeGrids(uUseGrids == 1, 0.1);
+		stepWorld.initialize(4);
+		stepWorld.makeSimulationStep();
+		BenchTimer timer;
+		stepWorld.makeSimulationStep();
+		printf("step at depth 4 %s time grids: %.3f ms\n", uUseGrids ? "with" : "without", timer.getMilliseconds());
+	}
+}
@@ -0,0 +1,67 @@
+#define _CRT_SECURE_NO_WARNINGS // fopen() is fine here
+#include "bench.h"
+#include "../wave.h"
+
+static const char* TRACE_PATH = "benchTrace.json";
+
+void benchTrace()
+{
+#if !WAVE_TRACE
+	printf("built with WAVE_TRACE=0\n");
+	return;
+#endif
+	const NvU32 nThreads = 4, nRounds = 5;
+	World world;
+	world.initialize(5);
+	world.setNThreads(nThreads);
+	world.makeSimulationStep();
+	setTraceThreadName("main");
+	clearTrace();
+
+	// steps with tracing off and on, interleaved so that both see the same state of the machine
+	double fBestMs[2] = { 1e30, 1e30 };
+	for (NvU32 uRound = 0; uRound < nRounds; ++uRound)
+	{
+		for (NvU32 uEnabled = 0; uEnabled < 2; ++uEnabled)
+		{
+			setTraceEnabled(uEnabled == 1);
+			BenchTimer timer;
+			world.makeSimulationStep();
+			fBestMs[uEnabled] = mymin(fBestMs[uEnabled], timer.getMilliseconds());
+		}
+	}
+	setTraceEnabled(false);
+	NvU64 nEventsPerStep = getNTraceEvents() / nRounds;
+	BenchTimer timer;
+	nvRelAssert(writeChromeTrace(TRACE_PATH));
+	double fWriteMs = timer.getMilliseconds();
+	remove(TRACE_PATH);
+	clearTrace();
+
+	// step times are too noisy to show overhead that small, so it is also estimated from the cost of one scope
+	const NvU32 nScopes = 1 << 20;
+	double fScopeNs[2];
+	for (NvU32 uEnabled = 0; uEnabled < 2; ++uEnabled)
+	{
+		setTraceEnabled(uEnabled == 1);
+		timer.reset();
+		for (NvU32 u = 0; u < nScopes; ++u)
+		{
+			WAVE_TRACE_SCOPE("bench");
+		}
+		fScopeNs[uEnabled] = timer.getMilliseconds() * 1e6 / nScopes;
+	}
+	setTraceEnabled(false);
+	clearTrace();
+
+	printf("depth 5, %u threads, %llu events per step\n", nThreads, (unsigned long long)nEventsPerStep);
+	printf("%20s %12s\n", "", "ms/step");
+	printf("%20s %12.3f\n", "tracing off", fBestMs[0]);
+	printf("%20s %12.3f\n", "tracing on", fBestMs[1]);
+	printf("measured overhead %.2f%%\n", (fBestMs[1] / fBestMs[0] - 1) * 100);
+	printf("scope costs %.1f ns enabled, %.1f ns disabled - estimated overhead %.4f%%\n", fScopeNs[1], fScopeNs[0],
+		nEventsPerStep * fScopeNs[1] * 1e-6 / fBestMs[0] * 100);
+	printf("trace of %u steps written in %.3f ms\n", nRounds, fWriteMs);
+	nvRelAssert(nEventsPerStep > 0);
+	reportResult("trace.scope", fScopeNs[1], "ns", true);
+}
@@ -0,0 +1,64 @@
+#include "bench.h"
+#include "../wave.h"
+
+// the same work done through the virtual interface and through the templated one
+struct CountVirtual : public Storage::IVisitor
+{
+	virtual bool notifyEntering(GridElem& elem, const float3Box&)
+	{
+		++m_nEntered;
+		m_fSum += elem.getCenter().x;
+		return true;
+	}
+	virtual void notifyLeaving(GridElem&, const float3Box&)
+	{
+		++m_nLeft;
+	}
+	NvU64 m_nEntered = 0, m_nLeft = 0;
+	double m_fSum = 0;
+};
+struct CountInline : public Storage::InlineVisitor
+{
+	bool notifyEntering(GridElem& elem, const float3Box&)
+	{
+		++m_nEntered;
+		m_fSum += elem.getCenter().x;
+		return true;
+	}
+	void notifyLeaving(GridElem&, const float3Box&)
+	{
+		++m_nLeft;
+	}
+	NvU64 m_nEntered = 0, m_nLeft = 0;
+	double m_fSum = 0;
+};
+
+void benchVisitors()
+{
+	World world;
+	world.initialize(7);
+	Storage& storage = world.accessStorage();
+
+	const NvU32 nRepeats = 5;
+	printf("%10s %12s %14s\n", "visitor", "ms", "Mnodes/s");
+	CountVirtual countVirtual;
+	BenchTimer timer;
+	for (NvU32 u = 0; u < nRepeats; ++u)
+	{
+		storage.visit(0, countVirtual);
+	}
+	double fVirtualMs = timer.getMilliseconds() / nRepeats;
+	printf("%10s %12.3f %14.1f\n", "virtual", fVirtualMs, countVirtual.m_nEntered / nRepeats / fVirtualMs / 1000);
+
+	CountInline countInline;
+	timer.reset();
+	for (NvU32 u = 0; u < nRepeats; ++u)
+	{
+		storage.visit(0, countInline);
+	}
+	double fInlineMs = timer.getMilliseconds() / nRepeats;
+	printf("%10s %12.3f %14.1f\n", "template", fInlineMs, countInline.m_nEntered / nRepeats / fInlineMs / 1000);
+
+	nvRelAssert(countVirtual.m_nEntered == countInline.m_nEntered && countVirtual.m_nLeft == countInline.m_nLeft);
+	nvRelAssert(countVirtual.m_fSum == countInline.m_fSum);
+}
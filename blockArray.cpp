@@ -0,0 +1,110 @@
+#include "MyMisc.h"
+#include "blockArray.h"
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+void* allocateSlab(size_t nBytes, bool useHugePages)
+{
+	if (useHugePages)
+	{
+		// needs SeLockMemoryPrivilege, without it the call fails and we fall back to normal pages
+		size_t nLargePageBytes = GetLargePageMinimum();
+		if (nLargePageBytes > 0)
+		{
+			void* p = VirtualAlloc(nullptr, NV_ALIGN_UP(nBytes, nLargePageBytes), MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+			if (p)
+				return p;
+		}
+	}
+	return VirtualAlloc(nullptr, nBytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+}
+void freeSlab(void* p, size_t nBytes)
+{
+	VirtualFree(p, 0, MEM_RELEASE);
+}
+void* mapFileSlab(const char* sPath, size_t nOffset, size_t nBytes)
+{
+	HANDLE hFile = CreateFileA(sPath, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return nullptr;
+	// touching pages past the end of the file would crash
+	LARGE_INTEGER fileBytes;
+	if (!GetFileSizeEx(hFile, &fileBytes) || (NvU64)fileBytes.QuadPart < (NvU64)nOffset + nBytes)
+	{
+		CloseHandle(hFile);
+		return nullptr;
+	}
+	HANDLE hMapping = CreateFileMappingA(hFile, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+	void* p = hMapping ? MapViewOfFile(hMapping, FILE_MAP_COPY, (DWORD)((NvU64)nOffset >> 32), (DWORD)nOffset, nBytes) : nullptr;
+	// the view keeps the file open
+	if (hMapping)
+	{
+		CloseHandle(hMapping);
+	}
+	CloseHandle(hFile);
+	return p;
+}
+void unmapFileSlab(void* p, size_t nBytes)
+{
+	UnmapViewOfFile(p);
+}
+#else
+void* allocateSlab(size_t nBytes, bool useHugePages)
+{
+	const size_t HUGE_PAGE_BYTES = 2 * 1024 * 1024;
+	if (!useHugePages)
+	{
+		void* p = mmap(nullptr, nBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		return p == MAP_FAILED ? nullptr : p;
+	}
+	// transparent huge pages are only used for aligned ranges, so map more than needed and cut the edges off
+	size_t nMappedBytes = nBytes + HUGE_PAGE_BYTES;
+	char* pMapped = (char*)mmap(nullptr, nMappedBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (pMapped == MAP_FAILED)
+		return nullptr;
+	char* p = (char*)NV_ALIGN_UP((size_t)pMapped, HUGE_PAGE_BYTES);
+	size_t nEndBytes = NV_ALIGN_UP(nBytes, (size_t)4096);
+	if (p > pMapped)
+	{
+		munmap(pMapped, p - pMapped);
+	}
+	if (pMapped + nMappedBytes > p + nEndBytes)
+	{
+		munmap(p + nEndBytes, pMapped + nMappedBytes - (p + nEndBytes));
+	}
+	madvise(p, nBytes, MADV_HUGEPAGE);
+	return p;
+}
+void freeSlab(void* p, size_t nBytes)
+{
+	munmap(p, nBytes);
+}
+void* mapFileSlab(const char* sPath, size_t nOffset, size_t nBytes)
+{
+	int fd = open(sPath, O_RDONLY);
+	if (fd < 0)
+		return nullptr;
+	// touching pages past the end of the file would crash
+	struct stat fileStat;
+	if (fstat(fd, &fileStat) != 0 || (NvU64)fileStat.st_size < (NvU64)nOffset + nBytes)
+	{
+		close(fd);
+		return nullptr;
+	}
+	void* p = mmap(nullptr, nBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, (off_t)nOffset);
+	// the mapping keeps the file open
+	close(fd);
+	return p == MAP_FAILED ? nullptr : p;
+}
+void unmapFileSlab(void* p, size_t nBytes)
+{
+	munmap(p, nBytes);
+}
+#endif
@@ -1,30 +1,166 @@
 #pragma once
 
 #include <vector>
-#include <memory>
+#include <new>
+#include <utility>
 
+// memory for BlockArray comes in big slabs directly from the OS. huge pages are only a hint - if the OS can't
+// give them, normal pages are used
+void* allocateSlab(size_t nBytes, bool useHugePages);
+void freeSlab(void* p, size_t nBytes);
+// copy-on-write mapping of a part of the file: pages are read when touched, writes never go to the file.
+// nOffset has to be a multiple of 64 KB (allocation granularity on Windows)
+void* mapFileSlab(const char* sPath, size_t nOffset, size_t nBytes);
+void unmapFileSlab(void* p, size_t nBytes);
+
+// array that never moves its elements: elements live in slabs which are never reallocated, so pointers and
+// references to elements stay valid while the array grows. every BLOCK_SIZE consecutive elements are guaranteed
+// to be in one slab. each new slab is as big as all previous ones together, so the number of allocations is
+// logarithmic. elements are constructed only when the array grows over them - pages that were never used don't
+// take physical memory. memory is only returned to the OS when the array is destroyed
 template <class T, NvU32 BLOCK_SIZE=64>
 struct BlockArray
 {
+	// smaller slabs are not worth a system call. 2 MB is also the size of a huge page
+	static const size_t MIN_SLAB_BYTES = 2 * 1024 * 1024;
+	static const size_t MAX_SLAB_BYTES = 1024 * 1024 * 1024;
+
+	BlockArray() { }
+	~BlockArray() { clear(); }
+	BlockArray(const BlockArray&) = delete;
+	BlockArray& operator=(const BlockArray&) = delete;
+	BlockArray(BlockArray&& other) { swap(other); }
+	BlockArray& operator=(BlockArray&& other)
+	{
+		BlockArray tmp(std::move(other));
+		swap(tmp);
+		return *this;
+	}
+
 	NvU32 size() const { return m_size; }
+	NvU32 capacity() const { return (NvU32)m_pBlocks.size() * BLOCK_SIZE; }
 	void resize(NvU32 size)
 	{
-		m_pBlocks.resize(NV_ALIGN_UP(size, BLOCK_SIZE) / BLOCK_SIZE);
+		reserve(size);
+		for ( ; m_nConstructed < size; ++m_nConstructed)
+		{
+			new (&(*this)[m_nConstructed]) T();
+		}
 		m_size = size;
 	}
-	inline T& operator[](NvU32 index) { return m_pBlocks[index / BLOCK_SIZE].p->data[index % 64]; }
-	inline const T& operator[](NvU32 index) const { return m_pBlocks[index / BLOCK_SIZE].p->data[index % 64]; }
+	// makes sure that growing up to the given size won't need any more allocations
+	void reserve(NvU32 size)
+	{
+		if (size > capacity())
+		{
+			addSlab(size - capacity());
+		}
+	}
+	// array must be empty. first nElems elements are taken from the file as they are (so T must be trivially
+	// copyable) - the file must have NV_ALIGN_UP(nElems, BLOCK_SIZE) elements starting at nOffset
+	bool mapFile(const char* sPath, size_t nOffset, NvU32 nElems)
+	{
+		nvAssert(m_slabs.empty());
+		Slab slab;
+		slab.m_nBytes = NV_ALIGN_UP((size_t)nElems, BLOCK_SIZE) * sizeof(T);
+		slab.m_isFileMapping = true;
+		slab.m_p = slab.m_nBytes ? (T*)mapFileSlab(sPath, nOffset, slab.m_nBytes) : nullptr;
+		if (!slab.m_p)
+			return nElems == 0;
+		for (size_t uBlock = 0; uBlock < slab.m_nBytes / sizeof(T) / BLOCK_SIZE; ++uBlock)
+		{
+			m_pBlocks.push_back(slab.m_p + uBlock * BLOCK_SIZE);
+		}
+		m_slabs.push_back(slab);
+		m_nAllocatedBytes += slab.m_nBytes;
+		m_size = m_nConstructed = nElems;
+		return true;
+	}
+	// calls func(pFirst, nElems) for runs of consecutive elements in memory that together cover
+	// NV_ALIGN_UP(size(), BLOCK_SIZE) elements. elements past size() may be unconstructed - only for bulk writes
+	template <class FUNC>
+	void forEachRun(FUNC func) const
+	{
+		NvU32 nBlocks = NV_ALIGN_UP(m_size, BLOCK_SIZE) / BLOCK_SIZE;
+		for (NvU32 uBlock = 0; uBlock < nBlocks; )
+		{
+			NvU32 uEnd = uBlock + 1;
+			while (uEnd < nBlocks && m_pBlocks[uEnd] == m_pBlocks[uEnd - 1] + BLOCK_SIZE)
+			{
+				++uEnd;
+			}
+			func((const T*)m_pBlocks[uBlock], (size_t)(uEnd - uBlock) * BLOCK_SIZE);
+			uBlock = uEnd;
+		}
+	}
+	// only affects slabs allocated after the call
+	void setUseHugePages(bool useHugePages) { m_useHugePages = useHugePages; }
+	bool getUseHugePages() const { return m_useHugePages; }
+	NvU32 getNSlabs() const { return (NvU32)m_slabs.size(); }
+	size_t getAllocatedBytes() const { return m_nAllocatedBytes; }
+
+	inline T& operator[](NvU32 index) { return m_pBlocks[index / BLOCK_SIZE][index % BLOCK_SIZE]; }
+	inline const T& operator[](NvU32 index) const { return m_pBlocks[index / BLOCK_SIZE][index % BLOCK_SIZE]; }
 
 private:
-	NvU32 m_size = 0;
-	struct Block
+	struct Slab
 	{
-		T data[64];
+		T* m_p;
+		size_t m_nBytes;
+		bool m_isFileMapping;
 	};
-	struct BlockPtr
+	void addSlab(NvU32 nMinElems)
 	{
-		BlockPtr() { p = std::make_shared<Block>(); }
-		std::shared_ptr<Block> p;
-	};
-	std::vector<BlockPtr> m_pBlocks;
-};
\ No newline at end of file
+		size_t nBlockBytes = sizeof(T) * BLOCK_SIZE;
+		size_t nSlabBytes = myClamp(m_nAllocatedBytes, MIN_SLAB_BYTES, MAX_SLAB_BYTES);
+		size_t nBlocks = mymax(NV_ALIGN_UP((size_t)nMinElems, BLOCK_SIZE) / BLOCK_SIZE, nSlabBytes / nBlockBytes);
+		nBlocks = mymax(nBlocks, (size_t)1);
+		Slab slab;
+		slab.m_nBytes = nBlocks * nBlockBytes;
+		slab.m_isFileMapping = false;
+		slab.m_p = (T*)allocateSlab(slab.m_nBytes, m_useHugePages);
+		// growth has no way to report failure, and out of memory isn't something to continue after in release either
+		nvRelAssert(slab.m_p != nullptr);
+		for (size_t uBlock = 0; uBlock < nBlocks; ++uBlock)
+		{
+			m_pBlocks.push_back(slab.m_p + uBlock * BLOCK_SIZE);
+		}
+		m_slabs.push_back(slab);
+		m_nAllocatedBytes += slab.m_nBytes;
+	}
+	void clear()
+	{
+		for (NvU32 u = 0; u < m_nConstructed; ++u)
+		{
+			(*this)[u].~T();
+		}
+		for (const Slab& slab : m_slabs)
+		{
+			if (slab.m_isFileMapping)
+			{
+				unmapFileSlab(slab.m_p, slab.m_nBytes);
+				continue;
+			}
+			freeSlab(slab.m_p, slab.m_nBytes);
+		}
+		m_slabs.clear();
+		m_pBlocks.clear();
+		m_nAllocatedBytes = 0;
+		m_size = m_nConstructed = 0;
+	}
+	void swap(BlockArray& other)
+	{
+		std::swap(m_size, other.m_size);
+		std::swap(m_nConstructed, other.m_nConstructed);
+		std::swap(m_useHugePages, other.m_useHugePages);
+		std::swap(m_nAllocatedBytes, other.m_nAllocatedBytes);
+		m_pBlocks.swap(other.m_pBlocks);
+		m_slabs.swap(other.m_slabs);
+	}
+
+	NvU32 m_size = 0, m_nConstructed = 0;
+	bool m_useHugePages = false;
+	size_t m_nAllocatedBytes = 0;
+	std::vector<T*> m_pBlocks;
+	std::vector<Slab> m_slabs;
+};
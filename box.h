@@ -1,6 +1,7 @@
 #pragma once
 
 #include "vector.h"
+#include "stats.h"
 
 // Macro to define conversion and subscript operators
 #define BOX_MEMBERS(T, n) \
@@ -36,5 +37,19 @@ DEFINE_CONCRETE_BOXES(double);
 template <class BOX1, class BOX2>
 bool doTouch(const BOX1& box1, const BOX2& box2)
 {
-    return !any(box1[1] < box2[0]) && !any(box2[1] < box1[0]);
-}
\ No newline at end of file
+    bool doesTouch = !any(box1[1] < box2[0]) && !any(box2[1] < box1[0]);
+    WAVE_COUNT(m_nTouchTests, 1);
+    WAVE_COUNT(m_nTouchRejections, doesTouch ? 0 : 1);
+    return doesTouch;
+}
+
+// 3 edges of the box going from its minimal corner - 6 points for drawing lines
+inline void getBoxLines(const float3Box& box, float3* pPoints)
+{
+    for (NvU32 uDim = 0; uDim < 3; ++uDim)
+    {
+        pPoints[2 * uDim] = box[0];
+        pPoints[2 * uDim + 1] = box[0];
+        pPoints[2 * uDim + 1][uDim] = box[1][uDim];
+    }
+}
@@ -0,0 +1,230 @@
+#include "wave.h"
+#include "threadPool.h"
+
+FarField::Node& FarField::accessNode(const Storage& storage, const GridElem& elem)
+{
+	return elem.isRoot() ? m_rootNodes[storage.getRootIndex(elem)] : m_childNodes[storage.getChildIndex(elem)];
+}
+
+const FarField::Node& FarField::getNode(const Storage& storage, const GridElem& elem) const
+{
+	return elem.isRoot() ? m_rootNodes[storage.getRootIndex(elem)] : m_childNodes[storage.getChildIndex(elem)];
+}
+
+// how deep below the roots the tree is split into tasks - a few tasks per thread, so that stealing can even them out
+static NvU32 getSplitDepth(NvU32 nRoots, ThreadPool* pPool)
+{
+	NvU32 splitDepth = 0;
+	for (NvU32 nThreads = pPool ? pPool->getNThreads() : 1, nSubtrees = nRoots; nSubtrees < nThreads * 4 && splitDepth < 4; nSubtrees *= 8)
+	{
+		++splitDepth;
+	}
+	return splitDepth;
+}
+
+// leaf: its own amplitude. parent: sum of children, sources are weighted by magnitude of amplitude, so the
+// aggregated source sits where most of the amplitude is. local part is reset for the coming interactions
+void FarField::gatherSources(const Storage& storage, const GridElem& elem)
+{
+	Node& node = accessNode(storage, elem);
+	node.m_localValue = makedouble2(0.);
+	for (NvU32 uDim = 0; uDim < 3; ++uDim)
+	{
+		node.m_localGrad[uDim] = makedouble2(0.);
+	}
+	if (!elem.hasChildren())
+	{
+		const float2& timePhase = elem.getTimePhase();
+		node.m_amplitude = makedouble2((double)timePhase.x, (double)timePhase.y);
+		node.m_vSourceCenter = elem.getCenter();
+		return;
+	}
+	node.m_amplitude = makedouble2(0.);
+	double3 vWeightedCenter = makedouble3(0.);
+	double fWeightsSum = 0;
+	for (NvU32 uChild = 0, firstChildIndex = elem.getFirstChild(); uChild < 8; ++uChild)
+	{
+		const Node& child = m_childNodes[firstChildIndex + uChild];
+		node.m_amplitude += child.m_amplitude;
+		double fWeight = length(child.m_amplitude);
+		vWeightedCenter += makedouble3((double)child.m_vSourceCenter.x, (double)child.m_vSourceCenter.y, (double)child.m_vSourceCenter.z) * fWeight;
+		fWeightsSum += fWeight;
+	}
+	node.m_vSourceCenter = fWeightsSum > 0 ? makefloat3((float)(vWeightedCenter.x / fWeightsSum),
+		(float)(vWeightedCenter.y / fWeightsSum), (float)(vWeightedCenter.z / fWeightsSum)) : elem.getCenter();
+}
+
+// shifts expansion of the parent to centers of its children
+void FarField::pushToChildren(const Storage& storage, const GridElem& elem)
+{
+	const Node& node = accessNode(storage, elem);
+	for (NvU32 uChild = 0, firstChildIndex = elem.getFirstChild(); uChild < 8; ++uChild)
+	{
+		Node& child = m_childNodes[firstChildIndex + uChild];
+		float3 vShift = storage[firstChildIndex + uChild].getCenter() - elem.getCenter();
+		child.m_localValue += node.m_localValue;
+		for (NvU32 uDim = 0; uDim < 3; ++uDim)
+		{
+			child.m_localValue += node.m_localGrad[uDim] * (double)vShift[uDim];
+			child.m_localGrad[uDim] += node.m_localGrad[uDim];
+		}
+	}
+}
+
+void FarField::computeSources(Storage& storage, NvU32 rootIndex, ThreadPool* pPool)
+{
+	NvU32 firstRoot = rootIndex == Storage::ALL_ROOTS ? 0 : rootIndex;
+	NvU32 endRoot = rootIndex == Storage::ALL_ROOTS ? storage.getNRoots() : rootIndex + 1;
+	if (m_rootNodes.size() < endRoot)
+	{
+		m_rootNodes.resize(endRoot);
+	}
+	m_childNodes.resize(storage.getNChildren());
+
+	// upward pass: aggregate amplitudes of children into parents
+	struct UpwardVisitor : public Storage::InlineVisitor
+	{
+		UpwardVisitor(Storage& storage, FarField& farField) : m_storage(storage), m_farField(farField) { }
+		bool notifyEntering(GridElem&, const float3Box&) { return true; }
+		void notifyLeaving(GridElem& elem, const float3Box&) { m_farField.gatherSources(m_storage, elem); }
+	private:
+		Storage& m_storage;
+		FarField& m_farField;
+	};
+	WAVE_TRACE_SCOPE("farField.upward");
+	NvU32 splitDepth = getSplitDepth(endRoot - firstRoot, pPool);
+	// nodes above splitDepth are gathered by the task that forked them, as soon as their children are done
+	parallelFor(pPool, endRoot - firstRoot, [&](NvU32 u)
+	{
+		storage.forkSubtrees(pPool, storage.accessRoot(firstRoot + u), storage.getRootBox(firstRoot + u), splitDepth,
+			[](GridElem&, const float3Box&) { },
+			[&](GridElem& elem, const float3Box& box)
+			{
+				UpwardVisitor upwardVisitor(storage, *this);
+				storage.visitSubtree(elem, box, upwardVisitor);
+			},
+			[&](GridElem& elem, const float3Box&) { gatherSources(storage, elem); });
+	});
+}
+
+void FarField::compute(Storage& storage, NvU32 rootIndex, ThreadPool* pPool)
+{
+	computeSources(storage, rootIndex, pPool);
+	NvU32 firstRoot = rootIndex == Storage::ALL_ROOTS ? 0 : rootIndex;
+	NvU32 endRoot = rootIndex == Storage::ALL_ROOTS ? storage.getNRoots() : rootIndex + 1;
+	// all roots are sources, only receiving ones get interactions
+	NvU32 firstDstRoot = mymax(firstRoot, m_firstReceivingRoot), endDstRoot = mymin(endRoot, m_endReceivingRoot);
+	if (firstDstRoot >= endDstRoot)
+		return;
+	NvU32 splitDepth = getSplitDepth(endDstRoot - firstDstRoot, pPool);
+
+	{
+		WAVE_TRACE_SCOPE("farField.interact");
+		parallelFor(pPool, endDstRoot - firstDstRoot, [&](NvU32 u)
+		{
+			storage.forkSubtrees(pPool, storage.accessRoot(firstDstRoot + u), storage.getRootBox(firstDstRoot + u), splitDepth,
+				[](GridElem&, const float3Box&) { },
+				[&](GridElem& elem, const float3Box& box)
+				{
+					Node& node = accessNode(storage, elem);
+					for (NvU32 srcRootIndex = firstRoot; srcRootIndex < endRoot; ++srcRootIndex)
+					{
+						interact(storage, elem, node, box, storage.accessRoot(srcRootIndex), m_rootNodes[srcRootIndex],
+							storage.getRootBox(srcRootIndex));
+					}
+				},
+				[](GridElem&, const float3Box&) { });
+		});
+	}
+
+	// downward pass: shift expansions of parents to centers of children
+	struct DownwardVisitor : public Storage::InlineVisitor
+	{
+		DownwardVisitor(Storage& storage, FarField& farField) : m_storage(storage), m_farField(farField) { }
+		bool notifyEntering(GridElem& elem, const float3Box&)
+		{
+			if (!elem.hasChildren())
+				return false;
+			m_farField.pushToChildren(m_storage, elem);
+			return true;
+		}
+		void notifyLeaving(GridElem&, const float3Box&) { }
+	private:
+		Storage& m_storage;
+		FarField& m_farField;
+	};
+	WAVE_TRACE_SCOPE("farField.downward");
+	parallelFor(pPool, endDstRoot - firstDstRoot, [&](NvU32 u)
+	{
+		storage.forkSubtrees(pPool, storage.accessRoot(firstDstRoot + u), storage.getRootBox(firstDstRoot + u), splitDepth,
+			[&](GridElem& elem, const float3Box&) { pushToChildren(storage, elem); },
+			[&](GridElem& elem, const float3Box& box)
+			{
+				DownwardVisitor downwardVisitor(storage, *this);
+				storage.visitSubtree(elem, box, downwardVisitor);
+			},
+			[](GridElem&, const float3Box&) { });
+	});
+}
+
+// adds influence of everything inside of src subtree to everything inside of dst subtree. src and dst may overlap
+void FarField::interact(const Storage& storage, const GridElem& dstElem, Node& dstNode, const float3Box& dstBox,
+	const GridElem& srcElem, const Node& srcNode, const float3Box& srcBox)
+{
+	if (&dstElem == &srcElem && !dstElem.hasChildren())
+		return;
+	float fDstRadius = length(dstBox[1] - dstBox[0]) / 2, fSrcRadius = length(srcBox[1] - srcBox[0]) / 2;
+	float fDistance = length(dstElem.getCenter() - srcElem.getCenter());
+	if (fDstRadius + fSrcRadius < m_fOpeningAngle * fDistance)
+	{
+		addFarSource(dstNode, dstElem.getCenter(), srcNode);
+		return;
+	}
+	if (!dstElem.hasChildren() && !srcElem.hasChildren())
+	{
+		// touching leaves are near field - they are handled by the caller
+		if (!doTouch(dstBox, srcBox))
+		{
+			addNearSource(dstNode, dstElem.getCenter(), srcNode);
+		}
+		return;
+	}
+	// open the bigger of the two subtrees
+	bool shouldOpenDst = dstElem.hasChildren() && (!srcElem.hasChildren() || fDstRadius >= fSrcRadius);
+	if (shouldOpenDst)
+	{
+		for (NvU32 uChild = 0, firstChildIndex = dstElem.getFirstChild(); uChild < 8; ++uChild)
+		{
+			interact(storage, storage[firstChildIndex + uChild], m_childNodes[firstChildIndex + uChild], Storage::computeChildBox(dstBox, uChild),
+				srcElem, srcNode, srcBox);
+		}
+	}
+	else
+	{
+		for (NvU32 uChild = 0, firstChildIndex = srcElem.getFirstChild(); uChild < 8; ++uChild)
+		{
+			interact(storage, dstElem, dstNode, dstBox,
+				storage[firstChildIndex + uChild], m_childNodes[firstChildIndex + uChild], Storage::computeChildBox(srcBox, uChild));
+		}
+	}
+}
+
+// influence of aggregated source: value and gradient of amplitude / |p - sourceCenter| at p = vDstCenter
+void FarField::addFarSource(Node& dstNode, const float3& vDstCenter, const Node& srcNode)
+{
+	double3 vR = makedouble3((double)vDstCenter.x - srcNode.m_vSourceCenter.x,
+		(double)vDstCenter.y - srcNode.m_vSourceCenter.y, (double)vDstCenter.z - srcNode.m_vSourceCenter.z);
+	double fInvDistance = 1 / length(vR);
+	dstNode.m_localValue += srcNode.m_amplitude * fInvDistance;
+	double fInvDistance3 = fInvDistance * fInvDistance * fInvDistance;
+	for (NvU32 uDim = 0; uDim < 3; ++uDim)
+	{
+		dstNode.m_localGrad[uDim] -= srcNode.m_amplitude * (vR[uDim] * fInvDistance3);
+	}
+}
+
+// exact influence of one leaf on another - only value is needed because leaves have no children to pass gradient to
+void FarField::addNearSource(Node& dstNode, const float3& vDstCenter, const Node& srcNode)
+{
+	dstNode.m_localValue += srcNode.m_amplitude * (1 / (double)length(vDstCenter - srcNode.m_vSourceCenter));
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <vector>
+#include "box.h"
+
+struct Storage;
+struct GridElem;
+struct ThreadPool;
+
+// computes for every leaf the sum of amplitude(j) / distance(leaf, j) over all leaves j that don't touch it
+// (touching leaves are handled exactly through InteractionLists). works like a simplified fast multipole method:
+// * upward pass aggregates amplitudes of each subtree into one source located at amplitude-weighted center
+// * two subtrees that are far enough from each other exchange their aggregated sources directly, the result
+//   is kept as a first order expansion (value + gradient) around the center of the receiving node
+// * downward pass pushes expansions from parents to children until they reach leaves
+// the cost is proportional to the number of leaves. the opening angle controls accuracy: two subtrees are
+// considered far if (radius1 + radius2) < fOpeningAngle * distance. smaller angle - more precise and slower.
+// every interaction only writes to the receiving node, so subtrees can receive in parallel without locking.
+// with Storage::ALL_ROOTS every root receives from every root, so the result is the same as with one big tree -
+// the only difference is that there is no serial part above the subtrees when there are enough roots
+struct FarField
+{
+	// must be in (0, 1): centers of touching boxes are never further apart than the sum of their radii, so below 1
+	// touching leaves can't pass as far and be counted twice - once here and once through InteractionLists
+	void setOpeningAngle(float fOpeningAngle)
+	{
+		nvRelAssert(fOpeningAngle > 0 && fOpeningAngle < 1);
+		m_fOpeningAngle = fOpeningAngle;
+	}
+	float getOpeningAngle() const { return m_fOpeningAngle; }
+
+	// only roots in [firstRoot, endRoot) receive interactions, others are just sources. compute() leaves zero
+	// influence in their nodes
+	void setReceivingRoots(NvU32 firstRoot, NvU32 endRoot) { m_firstReceivingRoot = firstRoot; m_endReceivingRoot = endRoot; }
+	void compute(Storage& storage, NvU32 rootIndex, ThreadPool* pPool = nullptr);
+	// only the upward pass of compute() - aggregated sources of every node, see getNode()
+	void computeSources(Storage& storage, NvU32 rootIndex, ThreadPool* pPool = nullptr);
+	// far-field influence of all other leaves on the given leaf (leaf is addressed by its child index)
+	const double2& getInfluence(NvU32 childIndex) const { return m_childNodes[childIndex].m_localValue; }
+	// same for a root without children
+	const double2& getRootInfluence(NvU32 rootIndex) const { return m_rootNodes[rootIndex].m_localValue; }
+
+	struct Node
+	{
+		// multipole part - aggregated sources of the subtree
+		double2 m_amplitude;
+		float3 m_vSourceCenter;
+		// local part - influence of far-away nodes around the center of this node
+		double2 m_localValue;
+		double2 m_localGrad[3];
+	};
+
+	// valid for elements that were in the tree during the last compute() or computeSources()
+	const Node& getNode(const Storage& storage, const GridElem& elem) const;
+
+private:
+	Node& accessNode(const Storage& storage, const GridElem& elem);
+	// upward pass for one node, children must be done already
+	void gatherSources(const Storage& storage, const GridElem& elem);
+	// downward pass for one node
+	void pushToChildren(const Storage& storage, const GridElem& elem);
+	void interact(const Storage& storage, const GridElem& dstElem, Node& dstNode, const float3Box& dstBox,
+		const GridElem& srcElem, const Node& srcNode, const float3Box& srcBox);
+	static void addFarSource(Node& dstNode, const float3& vDstCenter, const Node& srcNode);
+	static void addNearSource(Node& dstNode, const float3& vDstCenter, const Node& srcNode);
+
+	float m_fOpeningAngle = 0.5f;
+	NvU32 m_firstReceivingRoot = 0, m_endReceivingRoot = ~0U;
+	std::vector<Node> m_rootNodes;
+	std::vector<Node> m_childNodes;
+};
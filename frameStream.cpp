@@ -0,0 +1,310 @@
+#define _CRT_SECURE_NO_WARNINGS // fopen() is fine here
+#include <chrono>
+#include "wave.h"
+#include "frameStream.h"
+
+// tokens: c < 128 - c + 1 literal bytes follow, c >= 128 - c - 126 zero bytes
+static const NvU32 MAX_LITERALS = 128, MIN_ZEROS = 2, MAX_ZEROS = 129;
+
+void compressWords(const std::vector<NvU32>& words, std::vector<unsigned char>& compressed)
+{
+	size_t nWords = words.size();
+	std::vector<unsigned char> planes(nWords * 4);
+	for (size_t u = 0; u < nWords; ++u)
+	{
+		NvU32 delta = words[u] ^ (u > 0 ? words[u - 1] : 0);
+		for (NvU32 uByte = 0; uByte < 4; ++uByte)
+		{
+			planes[uByte * nWords + u] = (unsigned char)(delta >> (8 * uByte));
+		}
+	}
+	compressed.clear();
+	for (size_t u = 0, nBytes = planes.size(); u < nBytes; )
+	{
+		size_t nZeros = 0;
+		while (u + nZeros < nBytes && nZeros < MAX_ZEROS && planes[u + nZeros] == 0)
+		{
+			++nZeros;
+		}
+		if (nZeros >= MIN_ZEROS)
+		{
+			compressed.push_back((unsigned char)(nZeros - MIN_ZEROS + 128));
+			u += nZeros;
+			continue;
+		}
+		// literals go until the next pair of zeros
+		size_t nLiterals = 1;
+		while (u + nLiterals < nBytes && nLiterals < MAX_LITERALS &&
+			!(planes[u + nLiterals] == 0 && u + nLiterals + 1 < nBytes && planes[u + nLiterals + 1] == 0))
+		{
+			++nLiterals;
+		}
+		compressed.push_back((unsigned char)(nLiterals - 1));
+		compressed.insert(compressed.end(), planes.begin() + u, planes.begin() + u + nLiterals);
+		u += nLiterals;
+	}
+}
+
+bool decompressWords(const std::vector<unsigned char>& compressed, NvU32 nWords, std::vector<NvU32>& words)
+{
+	std::vector<unsigned char> planes(nWords * 4);
+	size_t uOut = 0;
+	for (size_t u = 0; u < compressed.size(); )
+	{
+		NvU32 token = compressed[u++];
+		if (token >= 128)
+		{
+			size_t nZeros = token - 128 + MIN_ZEROS;
+			if (uOut + nZeros > planes.size())
+				return false;
+			uOut += nZeros; // planes are zero already
+			continue;
+		}
+		size_t nLiterals = token + 1;
+		if (uOut + nLiterals > planes.size() || u + nLiterals > compressed.size())
+			return false;
+		memcpy(&planes[uOut], &compressed[u], nLiterals);
+		uOut += nLiterals;
+		u += nLiterals;
+	}
+	if (uOut != planes.size())
+		return false;
+	words.resize(nWords);
+	for (size_t u = 0; u < nWords; ++u)
+	{
+		NvU32 delta = 0;
+		for (NvU32 uByte = 0; uByte < 4; ++uByte)
+		{
+			delta |= (NvU32)planes[uByte * nWords + u] << (8 * uByte);
+		}
+		words[u] = delta ^ (u > 0 ? words[u - 1] : 0);
+	}
+	return true;
+}
+
+static NvU32 toWord(float f)
+{
+	NvU32 u;
+	memcpy(&u, &f, sizeof(u));
+	return u;
+}
+static float toFloat(NvU32 u)
+{
+	float f;
+	memcpy(&f, &u, sizeof(f));
+	return f;
+}
+
+bool FrameWriter::open(const char* sPath, NvU32 nFramesPerChunk)
+{
+	nvAssert(!m_pFile && nFramesPerChunk > 0);
+	m_pFile = fopen(sPath, "wb");
+	if (!m_pFile)
+		return false;
+	FrameFileHeader header;
+	memcpy(header.m_magic, FrameFileHeader::getMagic(), sizeof(header.m_magic));
+	header.m_version = FrameFileHeader::VERSION;
+	header.m_nWordsPerLeaf = FrameFileHeader::N_WORDS_PER_LEAF;
+	m_hasFailed = fwrite(&header, sizeof(header), 1, m_pFile) != 1;
+	m_nWrittenBytes = sizeof(header);
+	m_nRawBytes = 0;
+	m_nFramesPerChunk = nFramesPerChunk;
+	m_isClosing = false;
+	m_thread = std::thread([this]() { writeChunks(); });
+	return true;
+}
+
+void collectFrame(World& world, Frame& frame)
+{
+	struct CollectLeaves : public Storage::InlineVisitor
+	{
+		CollectLeaves(Frame& frame) : m_frame(frame) { }
+		bool notifyEntering(GridElem& elem, const float3Box& box)
+		{
+			if (!elem.hasChildren())
+			{
+				m_frame.m_boxes.push_back(box);
+				m_frame.m_timePhases.push_back(elem.getTimePhase());
+			}
+			return true;
+		}
+		Frame& m_frame;
+	};
+	frame.m_stepIndex = world.getStepIndex();
+	frame.m_boxes.clear();
+	frame.m_timePhases.clear();
+	CollectLeaves collectLeaves(frame);
+	if (world.getStorageBackend() == STORAGE_LINEAR)
+	{
+		for (NvU32 rootIndex = 0; rootIndex < world.accessLinearStorage().getNRoots(); ++rootIndex)
+		{
+			world.accessLinearStorage().visit(rootIndex, collectLeaves);
+		}
+	}
+	else
+	{
+		for (NvU32 rootIndex = 0; rootIndex < world.accessStorage().getNRoots(); ++rootIndex)
+		{
+			world.accessStorage().visit(rootIndex, collectLeaves);
+		}
+	}
+}
+
+void FrameWriter::addFrame(World& world)
+{
+	WAVE_TRACE_SCOPE("frame.add");
+	collectFrame(world, m_frame);
+
+	NvU32 nLeaves = (NvU32)m_frame.m_boxes.size();
+	std::vector<NvU32>& words = m_chunk.m_words;
+	words.push_back((NvU32)world.getStepIndex());
+	words.push_back((NvU32)(world.getStepIndex() >> 32));
+	words.push_back(nLeaves);
+	for (NvU32 uColumn = 0; uColumn < FrameFileHeader::N_WORDS_PER_LEAF; ++uColumn)
+	{
+		for (NvU32 u = 0; u < nLeaves; ++u)
+		{
+			float f = uColumn < 6 ? m_frame.m_boxes[u][uColumn / 3][uColumn % 3] : m_frame.m_timePhases[u][uColumn - 6];
+			words.push_back(toWord(f));
+		}
+	}
+	m_nRawBytes += (3 + (NvU64)nLeaves * FrameFileHeader::N_WORDS_PER_LEAF) * sizeof(NvU32);
+	if (++m_chunk.m_nFrames == m_nFramesPerChunk)
+	{
+		pushChunk();
+	}
+}
+
+void FrameWriter::pushChunk()
+{
+	WAVE_TRACE_SCOPE("frame.waitForSpace");
+	auto start = std::chrono::high_resolution_clock::now();
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_hasSpace.wait(lock, [this]() { return m_queue.size() < MAX_QUEUED_CHUNKS; });
+	m_fBlockedMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	m_queue.push_back(std::move(m_chunk));
+	m_chunk = Chunk();
+	m_hasChunks.notify_one();
+}
+
+void FrameWriter::writeChunks()
+{
+	setTraceThreadName("frame writer");
+	std::vector<unsigned char> compressed;
+	for ( ; ; )
+	{
+		Chunk chunk;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_hasChunks.wait(lock, [this]() { return !m_queue.empty() || m_isClosing; });
+			if (m_queue.empty())
+				return;
+			chunk = std::move(m_queue.front());
+			m_queue.pop_front();
+			m_hasSpace.notify_one();
+		}
+		{
+			WAVE_TRACE_SCOPE("frame.compress");
+			compressWords(chunk.m_words, compressed);
+		}
+		FrameChunkHeader header = { chunk.m_nFrames, (NvU32)chunk.m_words.size(), (NvU32)compressed.size() };
+		bool isOk;
+		{
+			WAVE_TRACE_SCOPE("frame.write");
+			isOk = fwrite(&header, sizeof(header), 1, m_pFile) == 1 &&
+				(compressed.empty() || fwrite(&compressed[0], 1, compressed.size(), m_pFile) == compressed.size());
+		}
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_hasFailed = m_hasFailed || !isOk;
+		m_nWrittenBytes += sizeof(header) + compressed.size();
+	}
+}
+
+bool FrameWriter::close()
+{
+	if (!m_pFile)
+		return true;
+	if (m_chunk.m_nFrames > 0)
+	{
+		pushChunk();
+	}
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_isClosing = true;
+		m_hasChunks.notify_one();
+	}
+	m_thread.join();
+	bool isOk = fclose(m_pFile) == 0 && !m_hasFailed;
+	m_pFile = nullptr;
+	return isOk;
+}
+
+bool FrameReader::open(const char* sPath)
+{
+	close();
+	m_pFile = fopen(sPath, "rb");
+	if (!m_pFile)
+		return false;
+	FrameFileHeader header;
+	if (fread(&header, sizeof(header), 1, m_pFile) != 1 || memcmp(header.m_magic, FrameFileHeader::getMagic(), sizeof(header.m_magic)) != 0 ||
+		header.m_version != FrameFileHeader::VERSION || header.m_nWordsPerLeaf != FrameFileHeader::N_WORDS_PER_LEAF)
+	{
+		close();
+		return false;
+	}
+	return true;
+}
+
+void FrameReader::close()
+{
+	if (m_pFile)
+	{
+		fclose(m_pFile);
+		m_pFile = nullptr;
+	}
+	m_nFramesLeft = 0;
+}
+
+bool FrameReader::readChunk()
+{
+	WAVE_TRACE_SCOPE("frame.readChunk");
+	FrameChunkHeader header;
+	if (fread(&header, sizeof(header), 1, m_pFile) != 1)
+		return false;
+	m_compressed.resize(header.m_nCompressedBytes);
+	if (header.m_nCompressedBytes > 0 && fread(&m_compressed[0], 1, m_compressed.size(), m_pFile) != m_compressed.size())
+		return false;
+	if (!decompressWords(m_compressed, header.m_nWords, m_words))
+		return false;
+	m_nFramesLeft = header.m_nFrames;
+	m_uNextWord = 0;
+	return true;
+}
+
+bool FrameReader::readFrame(Frame& frame)
+{
+	if (!m_pFile || (m_nFramesLeft == 0 && !readChunk()))
+		return false;
+	if (m_uNextWord + 3 > m_words.size())
+		return false;
+	const NvU32* pWords = &m_words[m_uNextWord];
+	frame.m_stepIndex = pWords[0] | ((NvU64)pWords[1] << 32);
+	NvU32 nLeaves = pWords[2];
+	if (m_uNextWord + 3 + (NvU64)nLeaves * FrameFileHeader::N_WORDS_PER_LEAF > m_words.size())
+		return false;
+	pWords += 3;
+	frame.m_boxes.resize(nLeaves);
+	frame.m_timePhases.resize(nLeaves);
+	for (NvU32 u = 0; u < nLeaves; ++u)
+	{
+		for (NvU32 uDim = 0; uDim < 3; ++uDim)
+		{
+			frame.m_boxes[u][0][uDim] = toFloat(pWords[uDim * nLeaves + u]);
+			frame.m_boxes[u][1][uDim] = toFloat(pWords[(3 + uDim) * nLeaves + u]);
+		}
+		frame.m_timePhases[u] = makefloat2(toFloat(pWords[6 * nLeaves + u]), toFloat(pWords[7 * nLeaves + u]));
+	}
+	m_uNextWord += 3 + nLeaves * FrameFileHeader::N_WORDS_PER_LEAF;
+	--m_nFramesLeft;
+	return true;
+}
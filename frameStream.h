@@ -0,0 +1,101 @@
+#pragma once
+
+#include <stdio.h>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "box.h"
+
+struct World;
+
+// leaves of one simulation step
+struct Frame
+{
+	NvU64 m_stepIndex = 0;
+	std::vector<float3Box> m_boxes;
+	std::vector<float2> m_timePhases;
+};
+// copies the leaves of the current step out of world. the buffers of frame are reused
+void collectFrame(World& world, Frame& frame);
+
+// file of frames: header, then chunks of several frames each. a chunk is a header plus compressed 32-bit words:
+// for every frame step index (2 words), number of leaves and then one column per leaf property (box min xyz, box
+// max xyz, timePhase xy). words are XORed with the previous word of the column and split into byte planes, so
+// that values shared by neighboring leaves turn into runs of zero bytes, which are run-length encoded
+struct FrameFileHeader
+{
+	static const NvU32 VERSION = 1;
+	static const NvU32 N_WORDS_PER_LEAF = 8;
+	char m_magic[8];
+	NvU32 m_version;
+	NvU32 m_nWordsPerLeaf;
+	static const char* getMagic() { return "WAVEFRMS"; }
+};
+struct FrameChunkHeader
+{
+	NvU32 m_nFrames;
+	NvU32 m_nWords;
+	NvU32 m_nCompressedBytes;
+};
+
+void compressWords(const std::vector<NvU32>& words, std::vector<unsigned char>& compressed);
+// returns false if the data is corrupt
+bool decompressWords(const std::vector<unsigned char>& compressed, NvU32 nWords, std::vector<NvU32>& words);
+
+// leaves are copied out of World on the calling thread, compression and writing happen on a background thread,
+// so the simulation only waits for the disk if it gets more than MAX_QUEUED_CHUNKS chunks ahead
+struct FrameWriter
+{
+	static const NvU32 MAX_QUEUED_CHUNKS = 64;
+
+	~FrameWriter() { close(); }
+	bool open(const char* sPath, NvU32 nFramesPerChunk = 16);
+	void addFrame(World& world);
+	// writes what's left and waits for the background thread. returns false if anything failed to write
+	bool close();
+	NvU64 getNRawBytes() const { return m_nRawBytes; }
+	// only final after close()
+	NvU64 getNWrittenBytes() const { return m_nWrittenBytes; }
+	// time addFrame() spent waiting for the background thread
+	double getBlockedMilliseconds() const { return m_fBlockedMs; }
+
+private:
+	struct Chunk
+	{
+		NvU32 m_nFrames = 0;
+		std::vector<NvU32> m_words;
+	};
+	void pushChunk();
+	void writeChunks();
+
+	FILE* m_pFile = nullptr;
+	NvU32 m_nFramesPerChunk = 0;
+	Chunk m_chunk;
+	Frame m_frame;
+	std::thread m_thread;
+	std::mutex m_mutex;
+	std::condition_variable m_hasChunks, m_hasSpace;
+	std::deque<Chunk> m_queue;
+	bool m_isClosing = false, m_hasFailed = false;
+	NvU64 m_nRawBytes = 0, m_nWrittenBytes = 0;
+	double m_fBlockedMs = 0;
+};
+
+struct FrameReader
+{
+	~FrameReader() { close(); }
+	bool open(const char* sPath);
+	// returns false at the end of file or if the file is corrupt
+	bool readFrame(Frame& frame);
+	void close();
+
+private:
+	bool readChunk();
+
+	FILE* m_pFile = nullptr;
+	std::vector<unsigned char> m_compressed;
+	std::vector<NvU32> m_words;
+	NvU32 m_uNextWord = 0, m_nFramesLeft = 0;
+};
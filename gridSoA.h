@@ -0,0 +1,77 @@
+#pragma once
+
+#include <vector>
+#include <stdlib.h>
+#include "box.h"
+
+// cache line aligned memory, so SIMD loads from the start of an array never cross cache lines
+template <class T>
+struct AlignedAllocator
+{
+	typedef T value_type;
+	static const size_t ALIGNMENT = 64;
+	AlignedAllocator() { }
+	template <class U> AlignedAllocator(const AlignedAllocator<U>&) { }
+	T* allocate(size_t n)
+	{
+#ifdef _WIN32
+		return (T*)_aligned_malloc(n * sizeof(T), ALIGNMENT);
+#else
+		return (T*)aligned_alloc(ALIGNMENT, NV_ALIGN_UP(n * sizeof(T), ALIGNMENT));
+#endif
+	}
+	void deallocate(T* p, size_t)
+	{
+#ifdef _WIN32
+		_aligned_free(p);
+#else
+		free(p);
+#endif
+	}
+	template <class U> bool operator==(const AlignedAllocator<U>&) const { return true; }
+	template <class U> bool operator!=(const AlignedAllocator<U>&) const { return false; }
+};
+template <class T>
+using AlignedVector = std::vector<T, AlignedAllocator<T>>;
+
+// structure-of-arrays copy of the children of Storage, indexed by child index. every field is a separate array, so
+// kernels that only need centers and phases stream just those and can load 8 consecutive children with one SIMD load
+struct GridSoA
+{
+	AlignedVector<float> m_centerX, m_centerY, m_centerZ;
+	AlignedVector<float> m_phaseX, m_phaseY;
+	AlignedVector<NvU32> m_firstChild;
+	AlignedVector<NvU32> m_parent; // parent index in lower 31 bits, top bit is set for children of roots
+
+	static const NvU32 CHILD_OF_ROOT_BIT = 0x80000000U;
+	static const NvU32 INVALID_CHILD_INDEX = 0xffffffffU;
+
+	NvU32 size() const { return (NvU32)m_centerX.size(); }
+	void resize(NvU32 size)
+	{
+		m_centerX.resize(size); m_centerY.resize(size); m_centerZ.resize(size);
+		m_phaseX.resize(size); m_phaseY.resize(size);
+		m_firstChild.resize(size, (NvU32)INVALID_CHILD_INDEX);
+		m_parent.resize(size);
+	}
+	void clear()
+	{
+		*this = GridSoA();
+	}
+
+	// read-only element with the same accessors as GridElem has
+	struct View
+	{
+		View(const GridSoA& soa, NvU32 index) : m_soa(soa), m_index(index) { }
+		float3 getCenter() const { return makefloat3(m_soa.m_centerX[m_index], m_soa.m_centerY[m_index], m_soa.m_centerZ[m_index]); }
+		float2 getTimePhase() const { return makefloat2(m_soa.m_phaseX[m_index], m_soa.m_phaseY[m_index]); }
+		bool hasChildren() const { return m_soa.m_firstChild[m_index] != INVALID_CHILD_INDEX; }
+		NvU32 getFirstChild() const { nvAssert(hasChildren()); return m_soa.m_firstChild[m_index]; }
+		bool isChildOfRoot() const { return (m_soa.m_parent[m_index] & CHILD_OF_ROOT_BIT) != 0; }
+		NvU32 getParentIndex() const { return m_soa.m_parent[m_index] & ~CHILD_OF_ROOT_BIT; }
+	private:
+		const GridSoA& m_soa;
+		NvU32 m_index;
+	};
+	View operator[](NvU32 index) const { return View(*this, index); }
+};
@@ -0,0 +1,278 @@
+#include "wave.h"
+
+// node accessors for the traversal - one for each kind of storage
+struct PointerTree
+{
+	PointerTree(const Storage& storage, const std::vector<NvU32>& slotOfChild) : m_storage(storage), m_slotOfChild(slotOfChild) { }
+	struct Node
+	{
+		const GridElem* m_pElem;
+		NvU32 m_index; // for roots ROOT_LEAF_BIT | slot if the root is a leaf, ~0U otherwise
+	};
+	bool hasChildren(const Node& node) const { return node.m_pElem->hasChildren(); }
+	Node getChild(const Node& node, NvU32 uChild) const
+	{
+		NvU32 childIndex = node.m_pElem->getFirstChild() + uChild;
+		return { &m_storage[childIndex], childIndex };
+	}
+	NvU32 getSlot(const Node& node) const
+	{
+		return InteractionLists::isRootLeaf(node.m_index) ? node.m_index & ~InteractionLists::ROOT_LEAF_BIT : m_slotOfChild[node.m_index];
+	}
+private:
+	const Storage& m_storage;
+	const std::vector<NvU32>& m_slotOfChild;
+};
+struct LinearTree
+{
+	LinearTree(const LinearStorage& storage, NvU32 rootIndex) : m_storage(storage), m_rootIndex(rootIndex) { }
+	struct Node
+	{
+		NvU64 m_code;
+		NvU32 m_level;
+		NvU32 m_firstLeaf, m_endLeaf; // leaves of the subtree
+	};
+	// all interior nodes have 8 children, so a range of one leaf is a leaf
+	bool hasChildren(const Node& node) const { return node.m_endLeaf - node.m_firstLeaf > 1; }
+	Node getChild(const Node& node, NvU32 uChild) const
+	{
+		Node child;
+		child.m_code = LinearStorage::getChildCode(node.m_code, node.m_level, uChild);
+		child.m_level = node.m_level + 1;
+		child.m_firstLeaf = uChild == 0 ? node.m_firstLeaf : m_storage.findFirstLeaf(m_rootIndex, child.m_code);
+		child.m_endLeaf = uChild == 7 ? node.m_endLeaf : m_storage.findFirstLeaf(m_rootIndex, LinearStorage::getSubtreeEnd(child.m_code, child.m_level));
+		return child;
+	}
+	NvU32 getSlot(const Node& node) const { return node.m_firstLeaf - m_storage.getFirstLeaf(m_rootIndex); }
+private:
+	const LinearStorage& m_storage;
+	NvU32 m_rootIndex;
+};
+
+bool InteractionLists::isValid(const Storage& storage, NvU32 rootIndex) const
+{
+	return m_pStorage == &storage && m_rootIndex == rootIndex && m_topologyVersion == storage.getTopologyVersion();
+}
+
+bool InteractionLists::isValid(const LinearStorage& storage, NvU32 rootIndex) const
+{
+	return m_pStorage == &storage && m_rootIndex == rootIndex && m_topologyVersion == storage.getTopologyVersion();
+}
+
+void InteractionLists::build(Storage& storage, NvU32 rootIndex, ThreadPool* pPool)
+{
+	m_pStorage = &storage;
+	m_rootIndex = rootIndex;
+	m_topologyVersion = storage.getTopologyVersion();
+	m_leafIndices.resize(0);
+	m_leafBoxes.resize(0);
+	m_pairInvDistances.resize(0);
+	m_pairGeometries.resize(0);
+	m_slotOfChild.assign(storage.getNChildren(), ~0U);
+
+	struct CollectLeaves : public Storage::InlineVisitor
+	{
+		CollectLeaves(Storage& storage, InteractionLists& lists) : m_storage(storage), m_lists(lists) { }
+		bool notifyEntering(GridElem& elem, const float3Box& box)
+		{
+			if (elem.hasChildren())
+				return true;
+			if (elem.isRoot())
+			{
+				m_lists.m_leafIndices.push_back(ROOT_LEAF_BIT | m_storage.getRootIndex(elem));
+				++m_lists.m_nRootLeaves;
+			}
+			else
+			{
+				NvU32 childIndex = m_storage.getChildIndex(elem);
+				m_lists.m_slotOfChild[childIndex] = (NvU32)m_lists.m_leafIndices.size();
+				m_lists.m_leafIndices.push_back(childIndex);
+			}
+			m_lists.m_leafBoxes.push_back(box);
+			return false;
+		}
+	private:
+		Storage& m_storage;
+		InteractionLists& m_lists;
+	};
+	CollectLeaves collectLeaves(storage, *this);
+	NvU32 firstRoot = rootIndex == Storage::ALL_ROOTS ? 0 : rootIndex;
+	NvU32 endRoot = rootIndex == Storage::ALL_ROOTS ? storage.getNRoots() : rootIndex + 1;
+	std::vector<PointerTree::Node> roots;
+	std::vector<float3Box> rootBoxes;
+	m_firstRoot = firstRoot;
+	m_nRootLeaves = 0;
+	m_rootFirstSlots.resize(0);
+	for (NvU32 u = firstRoot; u < endRoot; ++u)
+	{
+		NvU32 uSlot = getNLeaves();
+		m_rootFirstSlots.push_back(uSlot);
+		storage.visit(u, collectLeaves);
+		roots.push_back({ &storage.accessRoot(u), storage.accessRoot(u).hasChildren() ? ~0U : ROOT_LEAF_BIT | uSlot });
+		rootBoxes.push_back(storage.getRootBox(u));
+	}
+
+	m_rootFirstSlots.push_back(getNLeaves());
+	collectAllPairs(PointerTree(storage, m_slotOfChild), roots.data(), rootBoxes.data(), (NvU32)roots.size(), pPool);
+	m_slotOfChild = std::vector<NvU32>();
+}
+
+void InteractionLists::build(LinearStorage& storage, NvU32 rootIndex)
+{
+	m_pStorage = &storage;
+	m_rootIndex = rootIndex;
+	m_topologyVersion = storage.getTopologyVersion();
+	NvU32 firstLeaf = storage.getFirstLeaf(rootIndex), endLeaf = storage.getEndLeaf(rootIndex);
+	m_leafIndices.resize(0);
+	m_leafBoxes.resize(0);
+	m_pairInvDistances.resize(0);
+	m_pairGeometries.resize(0);
+	m_nRootLeaves = 0;
+	// leaf indices are LinearStorage indices, so a root without children is just its only leaf
+	{
+		// boxes come from visit() to be exactly the same as the ones the traversal computes
+		struct CollectLeaves : public Storage::InlineVisitor
+		{
+			CollectLeaves(std::vector<float3Box>& boxes) : m_boxes(boxes) { }
+			bool notifyEntering(GridElem& elem, const float3Box& box)
+			{
+				if (!elem.hasChildren())
+				{
+					m_boxes.push_back(box);
+				}
+				return true;
+			}
+		private:
+			std::vector<float3Box>& m_boxes;
+		};
+		CollectLeaves collectLeaves(m_leafBoxes);
+		storage.visit(rootIndex, collectLeaves);
+		for (NvU32 u = firstLeaf; u < endLeaf; ++u)
+		{
+			m_leafIndices.push_back(u);
+		}
+	}
+	m_firstRoot = rootIndex;
+	m_rootFirstSlots.assign(1, 0);
+	m_rootFirstSlots.push_back(getNLeaves());
+	LinearTree::Node root = { 0, 0, firstLeaf, endLeaf };
+	collectAllPairs(LinearTree(storage, rootIndex), &root, &storage.getRootBox(rootIndex), 1, nullptr);
+}
+
+template <class TREE>
+void InteractionLists::collectAllPairs(const TREE& tree, const typename TREE::Node* pRoots, const float3Box* pRootBoxes,
+	NvU32 nRoots, ThreadPool* pPool)
+{
+	// roots whose boxes touch - found once, both walks use them
+	std::vector<std::vector<NvU32>> haloRoots(nRoots);
+	for (NvU32 u1 = 0; u1 < nRoots; ++u1)
+	{
+		for (NvU32 u2 = 0; u2 < nRoots; ++u2)
+		{
+			if (u1 != u2 && doTouch(pRootBoxes[u1], pRootBoxes[u2]))
+			{
+				haloRoots[u1].push_back(u2);
+			}
+		}
+	}
+
+	// the tree is walked twice: first time to count neighbors of each leaf, second time to write them. this
+	// way neighbor lists are written directly to their final place without keeping list of pairs in memory
+	NvU32 nLeaves = getNLeaves();
+	m_neighborOffsets.assign(nLeaves + 1, 0);
+	m_fillPos.assign(nLeaves, 0);
+	for (m_isCounting = true; ; m_isCounting = false)
+	{
+		parallelFor(pPool, nRoots, [&](NvU32 uRoot)
+		{
+			// a leaf root has no pairs inside, but it still touches leaves of the halo
+			if (tree.hasChildren(pRoots[uRoot]))
+			{
+				collectSelf(tree, pRoots[uRoot], pRootBoxes[uRoot]);
+			}
+			for (NvU32 uHaloRoot : haloRoots[uRoot])
+			{
+				collectPair(tree, pRoots[uRoot], pRootBoxes[uRoot], pRoots[uHaloRoot], pRootBoxes[uHaloRoot], true);
+			}
+		});
+		if (!m_isCounting)
+			break;
+		for (NvU32 u = 0; u < nLeaves; ++u)
+		{
+			m_neighborOffsets[u + 1] += m_neighborOffsets[u];
+			m_fillPos[u] = m_neighborOffsets[u];
+		}
+		m_neighbors.resize(m_neighborOffsets[nLeaves]);
+	}
+	m_fillPos = std::vector<NvU32>();
+}
+
+// all touching pairs of leaves that are both inside of the subtree
+template <class TREE>
+void InteractionLists::collectSelf(const TREE& tree, const typename TREE::Node& node, const float3Box& box)
+{
+	typename TREE::Node children[8];
+	float3Box childBoxes[8];
+	for (NvU32 uChild = 0; uChild < 8; ++uChild)
+	{
+		children[uChild] = tree.getChild(node, uChild);
+		childBoxes[uChild] = Storage::computeChildBox(box, uChild);
+		if (tree.hasChildren(children[uChild]))
+		{
+			collectSelf(tree, children[uChild], childBoxes[uChild]);
+		}
+	}
+	for (NvU32 uChild1 = 0; uChild1 < 8; ++uChild1)
+	{
+		for (NvU32 uChild2 = uChild1 + 1; uChild2 < 8; ++uChild2)
+		{
+			collectPair(tree, children[uChild1], childBoxes[uChild1], children[uChild2], childBoxes[uChild2], false);
+		}
+	}
+}
+
+// all touching pairs of leaves where one leaf is inside of subtree 1 and another is inside of subtree 2
+template <class TREE>
+void InteractionLists::collectPair(const TREE& tree, const typename TREE::Node& node1, const float3Box& box1,
+	const typename TREE::Node& node2, const float3Box& box2, bool isHalo)
+{
+	if (!doTouch(box1, box2))
+		return;
+	bool hasChildren1 = tree.hasChildren(node1), hasChildren2 = tree.hasChildren(node2);
+	if (!hasChildren1 && !hasChildren2)
+	{
+		NvU32 uSlot1 = tree.getSlot(node1), uSlot2 = tree.getSlot(node2);
+		// the halo leaf belongs to another root - its list is written by the thread of that root
+		if (m_isCounting)
+		{
+			++m_neighborOffsets[uSlot1 + 1];
+			if (!isHalo)
+			{
+				++m_neighborOffsets[uSlot2 + 1];
+			}
+			return;
+		}
+		m_neighbors[m_fillPos[uSlot1]++] = uSlot2;
+		if (!isHalo)
+		{
+			m_neighbors[m_fillPos[uSlot2]++] = uSlot1;
+		}
+		return;
+	}
+	// open the bigger of the two subtrees
+	bool shouldOpen1 = hasChildren1 && (!hasChildren2 || box1[1][0] - box1[0][0] >= box2[1][0] - box2[0][0]);
+	if (shouldOpen1)
+	{
+		for (NvU32 uChild = 0; uChild < 8; ++uChild)
+		{
+			collectPair(tree, tree.getChild(node1, uChild), Storage::computeChildBox(box1, uChild), node2, box2, isHalo);
+		}
+	}
+	else
+	{
+		for (NvU32 uChild = 0; uChild < 8; ++uChild)
+		{
+			collectPair(tree, node1, box1, tree.getChild(node2, uChild), Storage::computeChildBox(box2, uChild), isHalo);
+		}
+	}
+}
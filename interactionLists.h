@@ -0,0 +1,88 @@
+#pragma once
+
+#include <vector>
+#include "box.h"
+#include "pathKernel.h"
+
+struct Storage;
+struct LinearStorage;
+struct ThreadPool;
+
+// for every leaf of the tree keeps the list of leaves touching it. lists are built with one simultaneous walk
+// of the tree against itself (dual-tree traversal) - two subtrees are only opened if their boxes touch, so
+// the cost is proportional to the number of touching pairs instead of the square of the number of leaves.
+// lists stay valid until the topology of the tree changes.
+// with Storage::ALL_ROOTS leaves of all roots are put into one list, root after root. each root is walked by its own
+// thread: first against itself, then against every root whose box touches its box (halo) - the halo walk only writes
+// lists of its own root, so no two threads write the same list. a root without children is a leaf itself - in a
+// tiled world it touches leaves of the neighboring roots
+struct InteractionLists
+{
+	// with Storage leaves are addressed by child index, except roots without children: they are ROOT_LEAF_BIT | root index
+	static const NvU32 ROOT_LEAF_BIT = 0x80000000U;
+	static bool isRootLeaf(NvU32 leafIndex) { return (leafIndex & ROOT_LEAF_BIT) != 0; }
+	static NvU32 getRootOfLeaf(NvU32 leafIndex) { nvAssert(isRootLeaf(leafIndex)); return leafIndex & ~ROOT_LEAF_BIT; }
+
+	void build(Storage& storage, NvU32 rootIndex, ThreadPool* pPool = nullptr);
+	bool isValid(const Storage& storage, NvU32 rootIndex) const;
+	// with linear storage leaves are addressed by their index in LinearStorage
+	void build(LinearStorage& storage, NvU32 rootIndex);
+	bool isValid(const LinearStorage& storage, NvU32 rootIndex) const;
+
+	// leaves are addressed by slot - their position in depth-first visiting order
+	NvU32 getNLeaves() const { return (NvU32)m_leafIndices.size(); }
+	NvU32 getLeafIndex(NvU32 uSlot) const { return m_leafIndices[uSlot]; } // index of the leaf in Storage, see isRootLeaf()
+	NvU32 getNRootLeaves() const { return m_nRootLeaves; }
+	const NvU32* getLeafIndices() const { return m_leafIndices.data(); } // getLeafIndex() of all slots
+	const float3Box& getLeafBox(NvU32 uSlot) const { return m_leafBoxes[uSlot]; }
+	NvU32 getNNeighbors(NvU32 uSlot) const { return m_neighborOffsets[uSlot + 1] - m_neighborOffsets[uSlot]; }
+	const NvU32* getNeighbors(NvU32 uSlot) const { return &m_neighbors[m_neighborOffsets[uSlot]]; } // slots of touching leaves
+	NvU32 getNPairs() const { return (NvU32)m_neighbors.size() / 2; }
+	// leaves of the root are slots [getRootFirstSlot(rootIndex), getRootFirstSlot(rootIndex + 1)). rootIndex
+	// must be in the range the lists were built for - or one past it
+	NvU32 getRootFirstSlot(NvU32 rootIndex) const { return m_rootFirstSlots[rootIndex - m_firstRoot]; }
+
+	// cache of what depends only on positions of the two leaves of a pair: 1 / distance between their centers,
+	// parallel to getNeighbors(). build() drops it, so it lives as long as the topology doesn't change - leaves don't
+	// move without split or merge. the user fills it: allocatePairCache() and then each slot writes its own entries
+	bool hasPairCache() const { return m_pairInvDistances.size() == m_neighbors.size() && !m_neighbors.empty(); }
+	void allocatePairCache() { m_pairInvDistances.resize(m_neighbors.size()); }
+	// when the way the cached values are computed changes
+	void clearPairCache() { m_pairInvDistances.resize(0); }
+	const double* getPairInvDistances(NvU32 uSlot) const { return m_pairInvDistances.data() + m_neighborOffsets[uSlot]; }
+	double* accessPairInvDistances(NvU32 uSlot) { return m_pairInvDistances.data() + m_neighborOffsets[uSlot]; }
+	// the same kind of cache for path sampling: geometry of the path from the neighbor to the leaf of the slot (see
+	// computePathGeometry()). it doesn't depend on precision, so clearPairCache() leaves it alone
+	bool hasPathGeometries() const { return m_pairGeometries.size() == m_neighbors.size() && !m_neighbors.empty(); }
+	void allocatePathGeometries() { m_pairGeometries.resize(m_neighbors.size()); }
+	const PathGeometry* getPathGeometries(NvU32 uSlot) const { return m_pairGeometries.data() + m_neighborOffsets[uSlot]; }
+	PathGeometry* accessPathGeometries(NvU32 uSlot) { return m_pairGeometries.data() + m_neighborOffsets[uSlot]; }
+
+private:
+	// TREE gives access to nodes of either kind of storage
+	template <class TREE> void collectAllPairs(const TREE& tree, const typename TREE::Node* pRoots, const float3Box* pRootBoxes,
+		NvU32 nRoots, ThreadPool* pPool);
+	template <class TREE> void collectSelf(const TREE& tree, const typename TREE::Node& node, const float3Box& box);
+	// with isHalo only the list of the leaf from subtree 1 is written
+	template <class TREE> void collectPair(const TREE& tree, const typename TREE::Node& node1, const float3Box& box1,
+		const typename TREE::Node& node2, const float3Box& box2, bool isHalo);
+
+	std::vector<NvU32> m_leafIndices;
+	std::vector<float3Box> m_leafBoxes;
+	std::vector<NvU32> m_neighborOffsets;
+	std::vector<NvU32> m_neighbors;
+	std::vector<NvU32> m_rootFirstSlots;
+	NvU32 m_firstRoot = 0;
+	NvU32 m_nRootLeaves = 0;
+	std::vector<double> m_pairInvDistances;
+	std::vector<PathGeometry> m_pairGeometries;
+
+	// only needed while building
+	std::vector<NvU32> m_slotOfChild;
+	std::vector<NvU32> m_fillPos;
+	bool m_isCounting = false;
+
+	const void* m_pStorage = nullptr;
+	NvU32 m_rootIndex = ~0U;
+	NvU32 m_topologyVersion = ~0U;
+};
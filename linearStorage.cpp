@@ -0,0 +1,127 @@
+#include "wave.h"
+
+NvU32 LinearStorage::allocateRoot(const float2& timePhase, const float3Box& box)
+{
+	NvU32 rootIndex = (NvU32)m_pRootBoxes.size();
+	m_pRootBoxes.push_back(box);
+	m_leaves.resize(m_leaves.size() + 1);
+	m_leaves.back().initAsRoot(timePhase, (box[0] + box[1]) / 2.f);
+	m_codes.push_back(0);
+	m_levels.push_back(0);
+	m_rootFirstLeaf.push_back((NvU32)m_leaves.size());
+	m_rootLookupLevels.push_back(0);
+	m_rootLookups.push_back(std::vector<NvU32>());
+	buildLookup(rootIndex);
+	++m_topologyVersion;
+	return rootIndex;
+}
+
+// puts 21 lower bits of u into every third bit of the result
+NvU64 LinearStorage::spreadBits(NvU32 u)
+{
+	NvU64 x = u & 0x1fffff;
+	x = (x | x << 32) & 0x1f00000000ffffULL;
+	x = (x | x << 16) & 0x1f0000ff0000ffULL;
+	x = (x | x << 8) & 0x100f00f00f00f00fULL;
+	x = (x | x << 4) & 0x10c30c30c30c30c3ULL;
+	x = (x | x << 2) & 0x1249249249249249ULL;
+	return x;
+}
+// inverse of spreadBits()
+NvU32 LinearStorage::compactBits(NvU64 x)
+{
+	x &= 0x1249249249249249ULL;
+	x = (x ^ (x >> 2)) & 0x10c30c30c30c30c3ULL;
+	x = (x ^ (x >> 4)) & 0x100f00f00f00f00fULL;
+	x = (x ^ (x >> 8)) & 0x1f0000ff0000ffULL;
+	x = (x ^ (x >> 16)) & 0x1f00000000ffffULL;
+	x = (x ^ (x >> 32)) & 0x1fffffULL;
+	return (NvU32)x;
+}
+
+float3Box LinearStorage::computeBox(NvU32 rootIndex, NvU64 code, NvU32 level) const
+{
+	const float3Box& rootBox = m_pRootBoxes[rootIndex];
+	if (level == 0)
+		return rootBox;
+	// scaling by power of 2 is exact, so faces shared by leaves of different levels come out exactly the same
+	float fScale = ldexpf(1.f, -(int)level);
+	float3Box box;
+	for (NvU32 uDim = 0; uDim < 3; ++uDim)
+	{
+		NvU32 uCell = compactBits(code >> uDim) >> (MAX_LEVEL - level);
+		float fWidth = rootBox[1][uDim] - rootBox[0][uDim];
+		box[0][uDim] = rootBox[0][uDim] + fWidth * (float)uCell * fScale;
+		box[1][uDim] = rootBox[0][uDim] + fWidth * (float)(uCell + 1) * fScale;
+	}
+	return box;
+}
+
+NvU32 LinearStorage::locatePoint(NvU32 rootIndex, const float3& vPoint) const
+{
+	const float3Box& rootBox = m_pRootBoxes[rootIndex];
+	if (any(vPoint < rootBox[0]) || any(vPoint > rootBox[1]))
+		return ~0U;
+	NvU32 uCells[3];
+	for (NvU32 uDim = 0; uDim < 3; ++uDim)
+	{
+		float fCell = (vPoint[uDim] - rootBox[0][uDim]) / (rootBox[1][uDim] - rootBox[0][uDim]) * (1 << MAX_LEVEL);
+		uCells[uDim] = mymin((NvU32)fCell, (1U << MAX_LEVEL) - 1);
+	}
+	NvU64 code = encodeMorton(uCells[0], uCells[1], uCells[2]);
+	NvU32 lookupLevel = m_rootLookupLevels[rootIndex], firstLeaf = getFirstLeaf(rootIndex);
+	const std::vector<NvU32>& lookup = m_rootLookups[rootIndex];
+	NvU64 uCell = lookupLevel == 0 ? 0 : code >> getLevelShift(lookupLevel);
+	NvU32 index = firstLeaf + lookup[uCell];
+	// leaf not deeper than the table covers the whole cell
+	if (m_levels[index] <= lookupLevel)
+		return index;
+	// leaves cover the cell without gaps, so the point belongs to the last leaf starting before it
+	auto it = std::upper_bound(m_codes.begin() + index, m_codes.begin() + firstLeaf + lookup[uCell + 1], code);
+	return (NvU32)(it - m_codes.begin()) - 1;
+}
+
+void LinearStorage::buildLookup(NvU32 rootIndex)
+{
+	NvU32 firstLeaf = getFirstLeaf(rootIndex), endLeaf = getEndLeaf(rootIndex);
+	NvU32 lookupLevel = 0;
+	for (NvU32 u = firstLeaf; u < endLeaf; ++u)
+	{
+		lookupLevel = mymax(lookupLevel, (NvU32)m_levels[u]);
+	}
+	lookupLevel = mymin(lookupLevel, MAX_LOOKUP_LEVEL);
+	std::vector<NvU32>& lookup = m_rootLookups[rootIndex];
+	m_rootLookupLevels[rootIndex] = (unsigned char)lookupLevel;
+	// root that is a leaf itself has one cell and it's already right
+	lookup.assign((1ULL << (3 * lookupLevel)) + 1, 0);
+	for (NvU32 u = firstLeaf; lookupLevel > 0 && u < endLeaf; ++u)
+	{
+		NvU64 code = m_codes[u];
+		NvU32 level = m_levels[u], shift = getLevelShift(lookupLevel);
+		// leaf not deeper than the table fills all of its cells, deeper leaves only mark the start of their cell
+		if (level <= lookupLevel)
+		{
+			std::fill(lookup.begin() + (code >> shift), lookup.begin() + (getSubtreeEnd(code, level) >> shift), u - firstLeaf);
+		}
+		else if ((code & ((1ULL << shift) - 1)) == 0)
+		{
+			lookup[code >> shift] = u - firstLeaf;
+		}
+	}
+	lookup.back() = endLeaf - firstLeaf;
+}
+
+void LinearStorage::appendChildren(NvU32 index, const float3Box& box, std::vector<GridElem>& leaves, std::vector<NvU64>& codes, std::vector<unsigned char>& levels) const
+{
+	NvU64 code = m_codes[index];
+	NvU32 level = m_levels[index];
+	float3 vMiddle = (box[0] + box[1]) / 2.f;
+	for (NvU32 uChild = 0; uChild < 8; ++uChild)
+	{
+		float3Box childBox = Storage::computeChildBox(box, vMiddle, uChild);
+		leaves.resize(leaves.size() + 1);
+		leaves.back().initAsRoot(m_leaves[index].getTimePhase(), (childBox[0] + childBox[1]) / 2.f);
+		codes.push_back(getChildCode(code, level, uChild));
+		levels.push_back((unsigned char)(level + 1));
+	}
+}
@@ -0,0 +1,193 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include "box.h"
+
+struct GridElem;
+
+// alternative to Storage where only leaves are kept. every leaf is keyed by the morton code of its minimal corner
+// (computed at MAX_LEVEL resolution) plus its level. leaves of each root are kept sorted by code, which is the
+// same as depth-first order, so interior nodes don't need to be stored at all: node at given level is the range
+// of leaves sharing the top 3*level bits of the code. parent, child and subtree range are bit operations on the code
+struct LinearStorage
+{
+	static const NvU32 MAX_LEVEL = 21; // 3 bits per level fit into 64-bit code
+
+	NvU32 allocateRoot(const float2& timePhase, const float3Box& box);
+	NvU32 getNRoots() const { return (NvU32)m_pRootBoxes.size(); }
+	NvU32 getTopologyVersion() const { return m_topologyVersion; }
+	const float3Box& getRootBox(NvU32 u) const { return m_pRootBoxes[u]; }
+
+	// leaves of all roots are in one array, leaves of one root are in [getFirstLeaf(), getEndLeaf())
+	NvU32 getNLeaves() const { return (NvU32)m_leaves.size(); }
+	NvU32 getFirstLeaf(NvU32 rootIndex) const { return m_rootFirstLeaf[rootIndex]; }
+	NvU32 getEndLeaf(NvU32 rootIndex) const { return m_rootFirstLeaf[rootIndex + 1]; }
+	inline GridElem& operator[](NvU32 index) { return m_leaves[index]; }
+	inline const GridElem& operator[](NvU32 index) const { return m_leaves[index]; }
+	NvU64 getCode(NvU32 index) const { return m_codes[index]; }
+	NvU32 getLevel(NvU32 index) const { return m_levels[index]; }
+
+	// bits of the code that belong to given level
+	static NvU32 getLevelShift(NvU32 level) { nvAssert(level > 0 && level <= MAX_LEVEL); return 3 * (MAX_LEVEL - level); }
+	static NvU64 getChildCode(NvU64 code, NvU32 level, NvU32 uChild) { return code | ((NvU64)uChild << getLevelShift(level + 1)); }
+	static NvU64 getParentCode(NvU64 code, NvU32 level) { return level <= 1 ? 0 : code & ~((8ULL << getLevelShift(level)) - 1); }
+	static NvU32 getChildSlot(NvU64 code, NvU32 level) { return (NvU32)(code >> getLevelShift(level)) & 7; }
+	// codes of all leaves inside of the node are in [code, getSubtreeEnd())
+	static NvU64 getSubtreeEnd(NvU64 code, NvU32 level) { return code + (level == 0 ? (1ULL << (3 * MAX_LEVEL)) : (1ULL << getLevelShift(level))); }
+	// for roots with power of 2 sizes the box is exactly the same as visit() gives, otherwise may differ in last bits
+	float3Box computeBox(NvU32 rootIndex, NvU64 code, NvU32 level) const;
+	// range of leaves inside of the node
+	NvU32 findFirstLeaf(NvU32 rootIndex, NvU64 code) const
+	{
+		return (NvU32)(std::lower_bound(m_codes.begin() + getFirstLeaf(rootIndex), m_codes.begin() + getEndLeaf(rootIndex), code) - m_codes.begin());
+	}
+
+	// returns index of the leaf containing the point or ~0U if the point is outside of the root box. O(1): the cell
+	// of the point in a dense table at the deepest leaf level of the root gives the leaf. trees deeper than
+	// MAX_LOOKUP_LEVEL only get the table at that level - then a binary search among leaves of one cell finishes it
+	NvU32 locatePoint(NvU32 rootIndex, const float3& vPoint) const;
+	static const NvU32 MAX_LOOKUP_LEVEL = 6; // 8^6 cells, 1 MB per root
+
+	// splits every leaf for which shouldSplit(elem, box) returns true. leaves are rewritten in one pass, so it's
+	// much cheaper to split many leaves at once than one by one
+	template <class PREDICATE>
+	void refine(NvU32 rootIndex, PREDICATE shouldSplit);
+
+	// same callbacks as Storage::visit() - interior nodes are passed as temporary GridElem objects
+	template <class VISITOR>
+	void visit(NvU32 rootIndex, VISITOR& visitor);
+
+	static NvU64 encodeMorton(NvU32 x, NvU32 y, NvU32 z) { return spreadBits(x) | (spreadBits(y) << 1) | (spreadBits(z) << 2); }
+	static NvU32 compactBits(NvU64 u);
+
+private:
+	static NvU64 spreadBits(NvU32 u);
+	void appendChildren(NvU32 index, const float3Box& box, std::vector<GridElem>& leaves, std::vector<NvU64>& codes, std::vector<unsigned char>& levels) const;
+	// rebuilds the locatePoint() table of the root after its leaves have changed
+	void buildLookup(NvU32 rootIndex);
+
+	std::vector<float3Box> m_pRootBoxes;
+	std::vector<NvU32> m_rootFirstLeaf = std::vector<NvU32>(1, 0);
+	std::vector<GridElem> m_leaves;
+	std::vector<NvU64> m_codes;
+	std::vector<unsigned char> m_levels;
+	// per root: level of the table and first leaf of every cell relative to getFirstLeaf(), plus getEndLeaf() at the end
+	std::vector<unsigned char> m_rootLookupLevels;
+	std::vector<std::vector<NvU32>> m_rootLookups;
+	NvU32 m_topologyVersion = 0;
+};
+
+template <class PREDICATE>
+void LinearStorage::refine(NvU32 rootIndex, PREDICATE shouldSplit)
+{
+	std::vector<GridElem> leaves;
+	std::vector<NvU64> codes;
+	std::vector<unsigned char> levels;
+	NvU32 firstLeaf = getFirstLeaf(rootIndex), endLeaf = getEndLeaf(rootIndex);
+	leaves.reserve(m_leaves.size());
+	codes.reserve(m_codes.size());
+	levels.reserve(m_levels.size());
+	leaves.insert(leaves.end(), m_leaves.begin(), m_leaves.begin() + firstLeaf);
+	codes.insert(codes.end(), m_codes.begin(), m_codes.begin() + firstLeaf);
+	levels.insert(levels.end(), m_levels.begin(), m_levels.begin() + firstLeaf);
+	for (NvU32 u = firstLeaf; u < endLeaf; ++u)
+	{
+		if (m_levels[u] < MAX_LEVEL)
+		{
+			float3Box box = computeBox(rootIndex, m_codes[u], m_levels[u]);
+			if (shouldSplit(m_leaves[u], box))
+			{
+				appendChildren(u, box, leaves, codes, levels);
+				continue;
+			}
+		}
+		leaves.push_back(m_leaves[u]);
+		codes.push_back(m_codes[u]);
+		levels.push_back(m_levels[u]);
+	}
+	NvU32 nAdded = (NvU32)leaves.size() - endLeaf;
+	leaves.insert(leaves.end(), m_leaves.begin() + endLeaf, m_leaves.end());
+	codes.insert(codes.end(), m_codes.begin() + endLeaf, m_codes.end());
+	levels.insert(levels.end(), m_levels.begin() + endLeaf, m_levels.end());
+	for (NvU32 u = rootIndex + 1; u < m_rootFirstLeaf.size(); ++u)
+	{
+		m_rootFirstLeaf[u] += nAdded;
+	}
+	m_leaves.swap(leaves);
+	m_codes.swap(codes);
+	m_levels.swap(levels);
+	if (nAdded > 0)
+	{
+		buildLookup(rootIndex);
+		++m_topologyVersion;
+	}
+}
+
+template <class VISITOR>
+void LinearStorage::visit(NvU32 rootIndex, VISITOR& visitor)
+{
+	// interior nodes on the path from the root to the current leaf
+	struct StackEntry
+	{
+		GridElem m_elem;
+		float3Box m_box;
+		float3 m_vMiddle;
+		NvU64 m_subtreeEnd;
+	};
+	StackEntry stack[MAX_LEVEL + 1];
+	NvU32 nStack = 0;
+	for (NvU32 u = getFirstLeaf(rootIndex), endLeaf = getEndLeaf(rootIndex); u < endLeaf; )
+	{
+		NvU64 code = m_codes[u];
+		NvU32 level = m_levels[u];
+		while (nStack > 0 && code >= stack[nStack - 1].m_subtreeEnd)
+		{
+			--nStack;
+			visitor.notifyLeaving(stack[nStack].m_elem, stack[nStack].m_box);
+		}
+		// enter interior nodes between the top of the stack and the leaf. boxes are computed from boxes of parents
+		// the same way Storage does it, so both kinds of storage produce exactly the same boxes
+		bool isSkipped = false;
+		while (nStack < level)
+		{
+			StackEntry& entry = stack[nStack];
+			if (nStack == 0)
+			{
+				entry.m_box = m_pRootBoxes[rootIndex];
+				entry.m_subtreeEnd = getSubtreeEnd(0, 0);
+			}
+			else
+			{
+				const StackEntry& parent = stack[nStack - 1];
+				entry.m_box = Storage::computeChildBox(parent.m_box, parent.m_vMiddle, getChildSlot(code, nStack));
+				entry.m_subtreeEnd = getSubtreeEnd(code & ~((1ULL << getLevelShift(nStack)) - 1), nStack);
+			}
+			entry.m_vMiddle = (entry.m_box[0] + entry.m_box[1]) / 2.f;
+			entry.m_elem = GridElem();
+			entry.m_elem.initAsRoot(m_leaves[u].getTimePhase(), entry.m_vMiddle);
+			entry.m_elem.setFirstChild(u);
+			if (!visitor.notifyEntering(entry.m_elem, entry.m_box))
+			{
+				u = findFirstLeaf(rootIndex, entry.m_subtreeEnd);
+				isSkipped = true;
+				break;
+			}
+			++nStack;
+		}
+		if (isSkipped)
+			continue;
+		float3Box box = level == 0 ? m_pRootBoxes[rootIndex] :
+			Storage::computeChildBox(stack[nStack - 1].m_box, stack[nStack - 1].m_vMiddle, getChildSlot(code, level));
+		if (visitor.notifyEntering(m_leaves[u], box))
+		{
+			visitor.notifyLeaving(m_leaves[u], box);
+		}
+		++u;
+	}
+	while (nStack > 0)
+	{
+		--nStack;
+		visitor.notifyLeaving(stack[nStack].m_elem, stack[nStack].m_box);
+	}
+}
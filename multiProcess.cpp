@@ -0,0 +1,367 @@
+#include <string.h>
+#include <chrono>
+#include <algorithm>
+#ifndef _WIN32
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#endif
+#include "multiProcess.h"
+#include "shmQueue.h"
+#include "wave.h"
+
+#ifdef _WIN32
+
+bool runMultiProcess(const MultiProcessParams& params, std::vector<MultiProcessStep>& steps)
+{
+	return false;
+}
+
+#else
+
+// one node of a locally essential tree, in depth-first order. a node without children is either a leaf or an
+// aggregated subtree - receiver doesn't care which
+struct GhostRecord
+{
+	float3 m_vCenter;
+	float2 m_timePhase;
+	NvU32 m_hasChildren;
+};
+
+// queues between every pair of workers plus one from every worker to the launcher
+struct MultiProcessQueues
+{
+	bool create(NvU32 nProcesses, NvU32 queueBytes)
+	{
+		m_nProcesses = nProcesses;
+		m_queueBytes = queueBytes;
+		if (!m_segment.create(ShmQueue::getBytesNeeded(queueBytes) * nProcesses * (nProcesses + 1)))
+			return false;
+		for (NvU32 u = 0; u < nProcesses * (nProcesses + 1); ++u)
+		{
+			ShmQueue::create(getQueueMemory(u), queueBytes);
+		}
+		return true;
+	}
+	// dst == number of processes is the launcher
+	ShmQueue& accessQueue(NvU32 src, NvU32 dst) { return *(ShmQueue*)getQueueMemory(src * (m_nProcesses + 1) + dst); }
+
+private:
+	void* getQueueMemory(NvU32 u) { return (char*)m_segment.getData() + ShmQueue::getBytesNeeded(m_queueBytes) * u; }
+	ShmSegment m_segment;
+	NvU32 m_nProcesses = 0, m_queueBytes = 0;
+};
+
+static NvU32 getFirstRoot(NvU32 rank, NvU32 nRoots, NvU32 nProcesses)
+{
+	return (NvU32)((NvU64)nRoots * rank / nProcesses);
+}
+
+static float getBoxDistance(const float3Box& box1, const float3Box& box2)
+{
+	float fDistance2 = 0;
+	for (NvU32 uDim = 0; uDim < 3; ++uDim)
+	{
+		float fGap = mymax(0.f, mymax(box1[0][uDim] - box2[1][uDim], box2[0][uDim] - box1[1][uDim]));
+		fDistance2 += fGap * fGap;
+	}
+	return sqrtf(fDistance2);
+}
+
+struct Worker
+{
+	Worker(const MultiProcessParams& params, NvU32 rank, MultiProcessQueues& queues) : m_params(params), m_rank(rank), m_queues(queues) { }
+	void run();
+
+private:
+	void exchange(MultiProcessStep& result);
+	void appendRecords(const GridElem& elem, const float3Box& box, NvU32 dstRank, std::vector<GhostRecord>& records);
+	void applyRecords(GridElem& elem, const float3Box& box, const GhostRecord*& pRecord);
+	void collapse(GridElem& elem);
+
+	const MultiProcessParams& m_params;
+	NvU32 m_rank;
+	MultiProcessQueues& m_queues;
+	World m_world;
+	NvU32 m_nRoots = 0;
+	NvU64 m_nGhostLeaves = 0;
+};
+
+void Worker::run()
+{
+	NvU32 nProcesses = m_params.m_nProcesses;
+	m_nRoots = m_params.m_nRootsPerDim * m_params.m_nRootsPerDim * m_params.m_nRootsPerDim;
+	m_world.setOwnedRoots(getFirstRoot(m_rank, m_nRoots, nProcesses), getFirstRoot(m_rank + 1, m_nRoots, nProcesses));
+	m_world.initialize(m_params.m_depth, STORAGE_POINTER, m_params.m_nRootsPerDim);
+	m_world.setNThreads(m_params.m_nThreadsPerProcess);
+	// the first locally essential trees need sources. after that every step leaves them up to date
+	m_world.accessFarField().computeSources(m_world.accessStorage(), Storage::ALL_ROOTS);
+	for (NvU32 uStep = 0; uStep < m_params.m_nSteps; ++uStep)
+	{
+		MultiProcessStep result;
+		auto start = std::chrono::high_resolution_clock::now();
+		exchange(result);
+		auto exchanged = std::chrono::high_resolution_clock::now();
+		m_world.makeSimulationStep();
+		auto stepped = std::chrono::high_resolution_clock::now();
+		result.m_fMaxExchangeMs = std::chrono::duration<double, std::milli>(exchanged - start).count();
+		result.m_fMaxStepMs = std::chrono::duration<double, std::milli>(stepped - exchanged).count();
+
+		NvU32 firstSlot = m_world.getInteractions().getRootFirstSlot(m_world.getFirstOwnedRoot());
+		NvU32 endSlot = m_world.getInteractions().getRootFirstSlot(m_world.getEndOwnedRoot());
+		for (NvU32 uSlot = firstSlot; uSlot < endSlot; ++uSlot)
+		{
+			const double2& influence = m_world.getLeafInfluence()[uSlot];
+			result.m_influenceSum += influence;
+			result.m_fInfluenceNorm += length(influence);
+		}
+		result.m_nLeaves = endSlot - firstSlot;
+		result.m_nGhostLeaves = m_nGhostLeaves;
+		m_queues.accessQueue(m_rank, nProcesses).push(&result, sizeof(result));
+	}
+}
+
+// sends locally essential trees of the owned roots to all other workers and turns what they send into ghost roots
+void Worker::exchange(MultiProcessStep& result)
+{
+	WAVE_TRACE_SCOPE("exchange");
+	NvU32 nProcesses = m_params.m_nProcesses;
+	Storage& storage = m_world.accessStorage();
+	// every message starts with the size of what follows. then for every root of the sender: number of records, records
+	std::vector<std::vector<char>> outMessages(nProcesses), inMessages(nProcesses);
+	std::vector<size_t> nSent(nProcesses, 0), nReceived(nProcesses, 0);
+	std::vector<GhostRecord> records;
+	for (NvU32 dstRank = 0; dstRank < nProcesses; ++dstRank)
+	{
+		if (dstRank == m_rank)
+			continue;
+		std::vector<char>& message = outMessages[dstRank];
+		message.resize(sizeof(NvU64));
+		for (NvU32 rootIndex = m_world.getFirstOwnedRoot(); rootIndex < m_world.getEndOwnedRoot(); ++rootIndex)
+		{
+			records.resize(0);
+			appendRecords(storage.accessRoot(rootIndex), storage.getRootBox(rootIndex), dstRank, records);
+			NvU32 nRecords = (NvU32)records.size();
+			size_t uPos = message.size();
+			message.resize(uPos + sizeof(NvU32) + nRecords * sizeof(GhostRecord));
+			memcpy(&message[uPos], &nRecords, sizeof(NvU32));
+			memcpy(&message[uPos + sizeof(NvU32)], records.data(), nRecords * sizeof(GhostRecord));
+		}
+		NvU64 nBytes = message.size() - sizeof(NvU64);
+		memcpy(&message[0], &nBytes, sizeof(NvU64));
+		result.m_nSentBytes += message.size();
+	}
+
+	// all workers send and receive at the same time, so nobody waits on a full queue that nobody reads
+	std::vector<char> hasHeader(nProcesses, 0);
+	ShmBackoff backoff;
+	for (bool isDone = false; !isDone; )
+	{
+		isDone = true;
+		bool hasMoved = false;
+		for (NvU32 otherRank = 0; otherRank < nProcesses; ++otherRank)
+		{
+			if (otherRank == m_rank)
+				continue;
+			std::vector<char>& out = outMessages[otherRank];
+			size_t nPushed = m_queues.accessQueue(m_rank, otherRank).tryPush(out.data() + nSent[otherRank], out.size() - nSent[otherRank]);
+			nSent[otherRank] += nPushed;
+
+			std::vector<char>& in = inMessages[otherRank];
+			if (in.empty())
+			{
+				in.resize(sizeof(NvU64));
+			}
+			size_t nPopped = m_queues.accessQueue(otherRank, m_rank).tryPop(in.data() + nReceived[otherRank], in.size() - nReceived[otherRank]);
+			nReceived[otherRank] += nPopped;
+			if (!hasHeader[otherRank] && nReceived[otherRank] == sizeof(NvU64))
+			{
+				NvU64 nBytes;
+				memcpy(&nBytes, in.data(), sizeof(NvU64));
+				in.resize(sizeof(NvU64) + (size_t)nBytes);
+				hasHeader[otherRank] = 1;
+			}
+			hasMoved = hasMoved || nPushed > 0 || nPopped > 0;
+			isDone = isDone && nSent[otherRank] == out.size() && hasHeader[otherRank] && nReceived[otherRank] == in.size();
+		}
+		if (!hasMoved && !isDone)
+		{
+			backoff.wait();
+		}
+	}
+
+	m_nGhostLeaves = 0;
+	for (NvU32 srcRank = 0; srcRank < nProcesses; ++srcRank)
+	{
+		if (srcRank == m_rank)
+			continue;
+		const char* pData = inMessages[srcRank].data() + sizeof(NvU64);
+		for (NvU32 rootIndex = getFirstRoot(srcRank, m_nRoots, nProcesses); rootIndex < getFirstRoot(srcRank + 1, m_nRoots, nProcesses); ++rootIndex)
+		{
+			NvU32 nRecords;
+			memcpy(&nRecords, pData, sizeof(NvU32));
+			const GhostRecord* pRecord = (const GhostRecord*)(pData + sizeof(NvU32));
+			applyRecords(storage.accessRoot(rootIndex), storage.getRootBox(rootIndex), pRecord);
+			nvAssert(pRecord == (const GhostRecord*)(pData + sizeof(NvU32)) + nRecords);
+			pData += sizeof(NvU32) + nRecords * sizeof(GhostRecord);
+		}
+	}
+}
+
+// the same criterion FarField uses for two subtrees, with the receiving subtree shrunk to a point at the closest place
+// of the receiver's part of space - a receiving leaf is never closer than that
+void Worker::appendRecords(const GridElem& elem, const float3Box& box, NvU32 dstRank, std::vector<GhostRecord>& records)
+{
+	const Storage& storage = m_world.accessStorage();
+	const FarField& farField = m_world.accessFarField();
+	bool isFar = true;
+	float fRadius = length(box[1] - box[0]) / 2;
+	for (NvU32 u = getFirstRoot(dstRank, m_nRoots, m_params.m_nProcesses); isFar && u < getFirstRoot(dstRank + 1, m_nRoots, m_params.m_nProcesses); ++u)
+	{
+		isFar = fRadius < farField.getOpeningAngle() * getBoxDistance(box, storage.getRootBox(u));
+	}
+	if (isFar || !elem.hasChildren())
+	{
+		const FarField::Node& node = farField.getNode(storage, elem);
+		records.push_back({ node.m_vSourceCenter, makefloat2((float)node.m_amplitude.x, (float)node.m_amplitude.y), 0 });
+		return;
+	}
+	records.push_back({ elem.getCenter(), elem.getTimePhase(), 1 });
+	for (NvU32 uChild = 0, firstChildIndex = elem.getFirstChild(); uChild < 8; ++uChild)
+	{
+		appendRecords(storage[firstChildIndex + uChild], Storage::computeChildBox(box, uChild), dstRank, records);
+	}
+}
+
+// changes the ghost subtree only where its shape differs from the records, so as long as the sender's tree keeps its
+// shape the topology of the receiver doesn't change and its interaction lists stay valid
+void Worker::applyRecords(GridElem& elem, const float3Box& box, const GhostRecord*& pRecord)
+{
+	Storage& storage = m_world.accessStorage();
+	const GhostRecord& record = *pRecord++;
+	if (!record.m_hasChildren)
+	{
+		if (elem.hasChildren())
+		{
+			collapse(elem);
+		}
+		storage.setTimePhase(elem, record.m_timePhase);
+		elem.setCenter(record.m_vCenter);
+		if (!elem.isRoot())
+		{
+			storage.updateSoA(storage.getChildIndex(elem), 1);
+		}
+		++m_nGhostLeaves;
+		return;
+	}
+	// might have been an aggregated source before
+	elem.setCenter((box[0] + box[1]) / 2.f);
+	if (!elem.hasChildren())
+	{
+		elem.split(m_world, storage, box);
+	}
+	for (NvU32 uChild = 0, firstChildIndex = elem.getFirstChild(); uChild < 8; ++uChild)
+	{
+		applyRecords(storage[firstChildIndex + uChild], Storage::computeChildBox(box, uChild), pRecord);
+	}
+}
+
+void Worker::collapse(GridElem& elem)
+{
+	Storage& storage = m_world.accessStorage();
+	for (NvU32 uChild = 0, firstChildIndex = elem.getFirstChild(); uChild < 8; ++uChild)
+	{
+		GridElem& child = storage[firstChildIndex + uChild];
+		if (child.hasChildren())
+		{
+			collapse(child);
+		}
+	}
+	elem.merge(m_world, storage);
+}
+
+bool runMultiProcess(const MultiProcessParams& params, std::vector<MultiProcessStep>& steps)
+{
+	NvU32 nProcesses = params.m_nProcesses;
+	if (nProcesses == 0 || nProcesses > params.m_nRootsPerDim * params.m_nRootsPerDim * params.m_nRootsPerDim)
+		return false;
+	MultiProcessQueues queues;
+	if (!queues.create(nProcesses, params.m_queueBytes))
+		return false;
+	fflush(stdout); // otherwise whatever is buffered gets printed by every worker too
+	std::vector<pid_t> pids;
+	for (NvU32 rank = 0; rank < nProcesses; ++rank)
+	{
+		pid_t pid = fork();
+		if (pid == 0)
+		{
+			Worker worker(params, rank, queues);
+			worker.run();
+			_exit(0);
+		}
+		if (pid < 0)
+			break;
+		pids.push_back(pid);
+	}
+
+	// a worker that died would never send its results - checked every time the launcher has nothing to read. workers
+	// that are done may exit before the launcher reads their last results, that is fine
+	std::vector<char> hasExited(pids.size(), 0);
+	bool isOk = pids.size() == nProcesses;
+	auto reapWorker = [&](pid_t pid, int options)
+	{
+		int status = 0;
+		pid_t exitedPid = waitpid(pid, &status, options);
+		if (exitedPid <= 0)
+			return exitedPid == 0;
+		hasExited[std::find(pids.begin(), pids.end(), exitedPid) - pids.begin()] = 1;
+		return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+	};
+	auto prevStepEnd = std::chrono::high_resolution_clock::now();
+	steps.assign(isOk ? params.m_nSteps : 0, MultiProcessStep());
+	for (NvU32 uStep = 0; isOk && uStep < params.m_nSteps; ++uStep)
+	{
+		MultiProcessStep& step = steps[uStep];
+		for (NvU32 rank = 0; isOk && rank < nProcesses; ++rank)
+		{
+			MultiProcessStep result;
+			ShmQueue& queue = queues.accessQueue(rank, nProcesses);
+			ShmBackoff backoff;
+			for (size_t nPopped = 0; ; backoff.wait())
+			{
+				// everything a worker pushed is in the queue before it exits
+				bool hadExited = hasExited[rank];
+				nPopped += queue.tryPop((char*)&result + nPopped, sizeof(result) - nPopped);
+				if (nPopped == sizeof(result))
+					break;
+				isOk = !hadExited && reapWorker(-1, WNOHANG); // -1 is any worker
+				if (!isOk)
+					break;
+			}
+			step.m_influenceSum += result.m_influenceSum;
+			step.m_fInfluenceNorm += result.m_fInfluenceNorm;
+			step.m_nLeaves += result.m_nLeaves;
+			step.m_nGhostLeaves += result.m_nGhostLeaves;
+			step.m_nSentBytes += result.m_nSentBytes;
+			step.m_fMaxExchangeMs = mymax(step.m_fMaxExchangeMs, result.m_fMaxExchangeMs);
+			step.m_fMaxStepMs = mymax(step.m_fMaxStepMs, result.m_fMaxStepMs);
+		}
+		auto stepEnd = std::chrono::high_resolution_clock::now();
+		step.m_fWallMs = std::chrono::duration<double, std::milli>(stepEnd - prevStepEnd).count();
+		prevStepEnd = stepEnd;
+	}
+
+	for (NvU32 u = 0; u < pids.size(); ++u)
+	{
+		if (hasExited[u])
+			continue;
+		if (!isOk)
+		{
+			kill(pids[u], SIGKILL);
+		}
+		isOk = reapWorker(pids[u], 0) && isOk;
+	}
+	return isOk;
+}
+
+#endif
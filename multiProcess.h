@@ -0,0 +1,38 @@
+#pragma once
+
+#include <vector>
+#include "box.h"
+
+// splits a tiled World (see World::initialize()) between local worker processes. worker p owns a contiguous range of
+// roots, which is a range of the morton curve, so its part of space is compact. every step each worker sends every
+// other worker a locally essential tree of its roots: nodes that are far from all roots of the receiver (by the
+// opening angle of FarField) go as one aggregated source, everything else is opened down to leaves - so leaves along
+// the boundary go as they are. the receiver keeps them as ghost roots (World::setOwnedRoots()): its step works on its
+// own part of the tree plus a halo that grows with the surface of that part, not with the whole tree.
+// messages go through single producer single consumer queues in one POSIX shared memory segment, results of steps
+// are reduced by the launcher through the same kind of queues. workers are forked, there is no network.
+// adaptation is not supported yet - ghosts are sent before the step, so they would be one adapt() behind
+struct MultiProcessParams
+{
+	NvU32 m_nProcesses = 2;
+	NvU32 m_nRootsPerDim = 2;
+	NvU32 m_depth = 3; // of every root
+	NvU32 m_nSteps = 10;
+	NvU32 m_nThreadsPerProcess = 1;
+	NvU32 m_queueBytes = 1 << 18; // capacity of every queue. messages can be bigger, they just take more round trips
+};
+
+// one step, reduced over all workers
+struct MultiProcessStep
+{
+	double2 m_influenceSum = makedouble2(0.); // over all leaves
+	double m_fInfluenceNorm = 0; // sum of |influence|
+	NvU64 m_nLeaves = 0, m_nGhostLeaves = 0;
+	NvU64 m_nSentBytes = 0;
+	double m_fMaxExchangeMs = 0, m_fMaxStepMs = 0; // of the slowest worker
+	double m_fWallMs = 0; // as seen by the launcher - from the end of the previous step
+};
+
+// forks the workers and waits for all of them to finish. returns false if shared memory or processes can't be
+// created or a worker fails. not available on windows
+bool runMultiProcess(const MultiProcessParams& params, std::vector<MultiProcessStep>& steps);
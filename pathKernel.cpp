@@ -0,0 +1,137 @@
+#include "pathKernel.h"
+#include "Power2Distribution.h"
+
+static double s_fQConst = 1;
+static double s_fMConst = 1;
+
+double TablePathMath::s_logC[TABLE_SIZE], TablePathMath::s_invC[TABLE_SIZE];
+static struct TablePathMathInit
+{
+	TablePathMathInit()
+	{
+		for (NvU32 i = 0; i < TablePathMath::TABLE_SIZE; ++i)
+		{
+			double c = 0.5 + (double)i / TablePathMath::N_POINTS_PER_UNIT;
+			TablePathMath::s_logC[i] = log(c);
+			TablePathMath::s_invC[i] = 1 / c;
+		}
+	}
+} s_tablePathMathInit;
+
+template <class MATH>
+void generatePathTime(const float3 &fromP, const float3 &toP, double f01Number, double &fPathAction, double &fPathTime, double &fPathWeight)
+{
+	generatePathTime(computePathGeometry<MATH>(fromP, toP), f01Number, fPathAction, fPathTime, fPathWeight);
+}
+
+template <class MATH>
+PathGeometry computePathGeometry(const float3& fromP, const float3& toP)
+{
+	double3 d = makedouble3((double)toP.x - fromP.x, (double)toP.y - fromP.y, (double)toP.z - fromP.z);
+	double3 p = makedouble3((double)fromP.x, (double)fromP.y, (double)fromP.z);
+	// in general case action at each point p is computed as:
+	// fAction(p) = fKineticConstant * sqr(fSpeed(p)) - fPotential(p);
+	//
+	// for simplicity we assume that speed is constant between two points. potential is not
+	// though because then force would be zero (force is derivative of potential), so:
+	// fAction(p) = fKineticConstant * sqr(fSpeed) - fPotential(p)
+	//
+	// if T is the time it takes for electron to fly between the two points, then path action
+	// would be equal to:
+	// fPathAction(T) = ntgrl_t_0_T(fKineticConstant * sqr(fSpeed) - fPotential(p))
+	//
+	// let's introduce those variables:
+	double dd = dot(d, d);
+	double dp = dot(d, p);
+	double pp = dot(p, p);
+	// We use matlab to compute all of the above integrals symbolically:
+	// syms px py pz dx dy dz t T
+	// rx = px + dx * (t/T)
+	// ry = py + dy * (t/T)
+	// rz = pz + dz * (t/T)
+	// collect(expand(rx^2+ry^2+rz^2),t) = (dd / T^2) * t^2 + (2 * dp / T) * t + pp
+	//
+	// syms t dd dp pp fQConst T fMConst
+	// rr = (dd / T^2) * t^2 + (2 * dp / T) * t + pp
+	//
+	// potential energy: V = fQConst / sqrt(rr)
+	// intV = int(V,t)
+	// pathV = subs(intV,t,T) - subs(intV,t,0)
+	// pathV = T * fQConst * log((dd + dp + sqrt(dd * (dd + 2 * dp + pp)))/(dp + sqrt(dd*pp)))/sqrt(dd)
+	// Few things to notice about pathV:
+	// * it is proportional to T, so it changes from 0 to inf as T grows
+	// * it must be > 0 because we're integrating positive function: fQConst / sqrt(rr)
+	//
+	// kinetic energy: P = fMConst * dd / T^2
+	// intP = int(P,t)
+	// pathP = subs(intP,t,T) - subs(intP,t,0)
+	// pathP = dd * fMConst / T
+	// Few things to note about pathP:
+	// * it is proportional to 1 / T, so it changes from inf to 0 as T grows
+	// * it must be > 0
+	//
+	// pathA = pathP - pathV
+	double Thelper = s_fQConst * MATH::logRatio(dd + dp + sqrt(dd * (dd + 2 * dp + pp)), dp + sqrt(dd * pp));
+	nvAssert(Thelper >= 0);
+	// pathA = (dd * fMConst)/T - T * Thelper/ dd^(1/2)
+	// syms dd fMConst T Thelper
+	// due to properties of pathP and pathV, there must be a point T0 where pathA = 0
+	// we find that point T0 and then we generate random T sample around that point. that
+	// sample will represent path between two points
+	//
+	// pathAeq = pathA == 0
+	double fSqrtDD = sqrt(dd);
+	double fT0 = sqrt(Thelper * dd * fSqrtDD * s_fMConst) / Thelper;
+	return { dd, fSqrtDD, Thelper, fT0 };
+}
+
+void generatePathTime(const PathGeometry& geometry, double f01Number, double& fPathAction, double& fPathTime, double& fPathWeight)
+{
+	// T0 is where the distribution is the densest
+	fPathTime = Power2Distribution::generate(f01Number, geometry.m_fT0, fPathWeight);
+	fPathAction = geometry.m_dd * s_fMConst / fPathTime - fPathTime * geometry.m_fThelper / geometry.m_fSqrtDD;
+}
+
+// the same math as generatePathTime() done for V::WIDTH pairs at once without branches
+template <class MATH>
+struct PathTimesKernel
+{
+	PathTimesKernel(const PathBatch& batch) : m_batch(batch) { }
+	template <class V>
+	void run(size_t u)
+	{
+		const PathBatch& batch = m_batch;
+		V fromX = V::loadFloat(batch.m_pFromX + u), fromY = V::loadFloat(batch.m_pFromY + u), fromZ = V::loadFloat(batch.m_pFromZ + u);
+		V dX = V::loadFloat(batch.m_pToX + u) - fromX, dY = V::loadFloat(batch.m_pToY + u) - fromY, dZ = V::loadFloat(batch.m_pToZ + u) - fromZ;
+		V dd = dX * dX + dY * dY + dZ * dZ;
+		V dp = dX * fromX + dY * fromY + dZ * fromZ;
+		V pp = fromX * fromX + fromY * fromY + fromZ * fromZ;
+		V fSqrtDD = sqrt(dd);
+		V Thelper = V(s_fQConst) * MATH::logRatio(dd + dp + sqrt(dd * (dd + V(2.) * dp + pp)), dp + sqrt(dd * pp));
+		V fT0 = sqrt(Thelper * dd * fSqrtDD * V(s_fMConst)) / Thelper;
+
+		V fPathWeight;
+		V fPathTime = Power2Distribution::generate(V::load(batch.m_p01Numbers + u), fT0, fPathWeight);
+		V fPathAction = dd * V(s_fMConst) / fPathTime - fPathTime * Thelper / fSqrtDD;
+		fPathAction.store(batch.m_pAction + u);
+		fPathTime.store(batch.m_pTime + u);
+		fPathWeight.store(batch.m_pWeight + u);
+	}
+private:
+	const PathBatch& m_batch;
+};
+
+template <class MATH>
+void generatePathTimes(const PathBatch& batch, SimdLevel simdLevel)
+{
+	PathTimesKernel<MATH> kernel(batch);
+	simdFor(simdLevel, batch.m_n, kernel);
+}
+
+#define INSTANTIATE_PATH_KERNEL(MATH) \
+	template void generatePathTime<MATH>(const float3& fromP, const float3& toP, double f01Number, double& fPathAction, double& fPathTime, double& fPathWeight); \
+	template PathGeometry computePathGeometry<MATH>(const float3& fromP, const float3& toP); \
+	template void generatePathTimes<MATH>(const PathBatch& batch, SimdLevel simdLevel);
+INSTANTIATE_PATH_KERNEL(ExactPathMath)
+INSTANTIATE_PATH_KERNEL(FastPathMath)
+INSTANTIATE_PATH_KERNEL(TablePathMath)
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "box.h"
+#include "simd.h"
+
+// how the path kernel computes log(a / b) - the MATH template parameter of the functions below. each policy has
+// logRatio() and log() for double and for every vector of simd.h. square roots are always done by the hardware -
+// they are one correctly rounded instruction already
+//
+// libm for double, logSimd() (~1 ulp) for vectors
+struct ExactPathMath
+{
+	static double log(double x) { return ::log(x); }
+	template <class V> static V log(V x) { return logSimd(x); }
+	template <class V> static V logRatio(V a, V b) { return log(a / b); }
+};
+// the series of logSimd() cut at s^9. relative error < 1e-8 for any positive normal numbers - the part of the series
+// that is cut is below s^10 / 11 < 2.1e-9 relative, and adding e * log(2) can at most double that. logRatio() takes
+// s = (ma - mb) / (ma + mb) right from the mantissas, so it has no division of its own and doesn't round a / b
+struct FastPathMath
+{
+	static double log(double x) { return log(SimdD1(x)).v; }
+	static double logRatio(double a, double b) { return logRatio(SimdD1(a), SimdD1(b)).v; }
+	template <class V> static V log(V x) { return logRatio(x, V(1.)); }
+	template <class V> static V logRatio(V a, V b)
+	{
+		// ma / mb is in (0.5, 2), bring it to [sqrt(2)/2, sqrt(2)]
+		V e = V::getExponent(a) - V::getExponent(b);
+		V ma = V::getMantissa(a), mb = V::getMantissa(b);
+		typename V::Mask isBig = mb * V(1.4142135623730951) < ma;
+		mb = select(isBig, mb * V(2.), mb);
+		e = select(isBig, e + V(1.), e);
+		typename V::Mask isSmall = ma < mb * V(0.70710678118654757);
+		mb = select(isSmall, mb * V(0.5), mb);
+		e = select(isSmall, e - V(1.), e);
+		V s = (ma - mb) / (ma + mb);
+		V z = s * s;
+		V p = V(2. / 9);
+		p = p * z + V(2. / 7);
+		p = p * z + V(2. / 5);
+		p = p * z + V(2. / 3);
+		p = p * z + V(2.);
+		return e * V(0.69314718055994531) + s * p;
+	}
+};
+// no division in log(): log(m) = log(c) + log(1 + r), where c is the closest of points 0.5 + i / 128 and
+// r = (m - c) / c is found with a multiplication by 1 / c from the table. |r| < 0.0056, so log(1 + r) to r^4 has
+// relative error < 1e-9. m close to 1 gets c = 1 exactly, so there is no cancellation near x = 1
+struct TablePathMath
+{
+	static const NvU32 N_POINTS_PER_UNIT = 128;
+	static double log(double x) { return log(SimdD1(x)).v; }
+	template <class V> static V logRatio(V a, V b) { return log(a / b); }
+	template <class V> static V log(V x)
+	{
+		V e = V::getExponent(x);
+		V m = V::getMantissa(x);
+		typename V::Mask isBig = V(1.4142135623730951) < m;
+		m = select(isBig, m * V(0.5), m);
+		e = select(isBig, e + V(1.), e);
+		V i = floor((m - V(0.5)) * V((double)N_POINTS_PER_UNIT) + V(0.5));
+		V c = V(0.5) + i * V(1. / N_POINTS_PER_UNIT);
+		V r = (m - c) * V::gather(s_invC, i);
+		V p = V(-1. / 4);
+		p = p * r + V(1. / 3);
+		p = p * r + V(-1. / 2);
+		p = p * r + V(1.);
+		return e * V(0.69314718055994531) + V::gather(s_logC, i) + r * p;
+	}
+	// indexed by i. m is in [0.707, 1.415), so i is from 26 to 117
+	static const NvU32 TABLE_SIZE = N_POINTS_PER_UNIT + 1;
+	static double s_logC[TABLE_SIZE], s_invC[TABLE_SIZE];
+};
+
+// generates random time of flight between two points and action of the path with that time. f01Number is
+// uniform random number in [0, 1). see the derivation in pathKernel.cpp
+template <class MATH = ExactPathMath>
+void generatePathTime(const float3& fromP, const float3& toP, double f01Number, double& fPathAction, double& fPathTime, double& fPathWeight);
+
+// the part of generatePathTime() that depends only on the two points - the logs and square roots. for pairs that
+// don't move it can be computed once and then only the sampling part is done for every random number
+struct PathGeometry
+{
+	double m_dd; // squared distance
+	double m_fSqrtDD;
+	double m_fThelper;
+	double m_fT0; // time at which action is 0
+};
+template <class MATH = ExactPathMath>
+PathGeometry computePathGeometry(const float3& fromP, const float3& toP);
+// gives exactly the same as generatePathTime() for the points the geometry was computed for
+void generatePathTime(const PathGeometry& geometry, double f01Number, double& fPathAction, double& fPathTime, double& fPathWeight);
+
+// structure-of-arrays input and output of generatePathTimes(), every array has m_n elements
+struct PathBatch
+{
+	const float* m_pFromX, * m_pFromY, * m_pFromZ;
+	const float* m_pToX, * m_pToY, * m_pToZ;
+	const double* m_p01Numbers;
+	double* m_pAction, * m_pTime, * m_pWeight;
+	NvU32 m_n;
+};
+// generatePathTime() for every pair in the batch. weights are exactly the same as the scalar function gives, time
+// and action differ only by rounding (with ExactPathMath log is computed by our own polynomial)
+template <class MATH = ExactPathMath>
+void generatePathTimes(const PathBatch& batch, SimdLevel simdLevel = getMaxSimdLevel());
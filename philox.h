@@ -0,0 +1,145 @@
+#pragma once
+
+#include "MyMisc.h"
+#include "simd.h"
+
+// counter-based random numbers (Philox4x32-10 by Salmon et al). the output is a pure function of (counter, key), so
+// any thread can produce any part of any stream without shared state, and results don't depend on which thread
+// produced them or in what order
+struct Philox4x32
+{
+	static const NvU32 N_ROUNDS = 10;
+	static const NvU32 M0 = 0xD2511F53, M1 = 0xCD9E8D57;
+	static const NvU32 W0 = 0x9E3779B9, W1 = 0xBB67AE85;
+
+	static void generate(const NvU32 counter[4], const NvU32 key[2], NvU32 out[4])
+	{
+		NvU32 c0 = counter[0], c1 = counter[1], c2 = counter[2], c3 = counter[3];
+		NvU32 k0 = key[0], k1 = key[1];
+		for (NvU32 uRound = 0; uRound < N_ROUNDS; ++uRound)
+		{
+			NvU64 p0 = (NvU64)M0 * c0, p1 = (NvU64)M1 * c2;
+			NvU32 n0 = (NvU32)(p1 >> 32) ^ c1 ^ k0, n2 = (NvU32)(p0 >> 32) ^ c3 ^ k1;
+			c1 = (NvU32)p1;
+			c3 = (NvU32)p0;
+			c0 = n0;
+			c2 = n2;
+			k0 += W0;
+			k1 += W1;
+		}
+		out[0] = c0; out[1] = c1; out[2] = c2; out[3] = c3;
+	}
+	// 52 random bits put into mantissa of [1, 2) and shifted to [0, 1) - exact and the same on every code path
+	static double toDouble01(NvU32 lo, NvU32 hi)
+	{
+		NvU64 u = ((((NvU64)hi << 32) | lo) >> 12) | 0x3ff0000000000000ULL;
+		double f;
+		memcpy(&f, &u, sizeof(f));
+		return f - 1;
+	}
+};
+
+// uniform numbers in [0, 1) for path sampling. number is addressed by (step, leaf, sample), one Philox call gives
+// two consecutive samples. the seed selects the whole family of streams
+struct PathRandom
+{
+	explicit PathRandom(NvU64 seed = 0) { setSeed(seed); }
+	void setSeed(NvU64 seed) { m_key[0] = (NvU32)seed; m_key[1] = (NvU32)(seed >> 32); }
+	NvU64 getSeed() const { return m_key[0] | ((NvU64)m_key[1] << 32); }
+
+	double get01(NvU64 step, NvU32 leafIndex, NvU32 sampleIndex) const
+	{
+		NvU32 counter[4] = { sampleIndex / 2, leafIndex, (NvU32)step, (NvU32)(step >> 32) }, out[4];
+		Philox4x32::generate(counter, m_key, out);
+		return (sampleIndex & 1) ? Philox4x32::toDouble01(out[2], out[3]) : Philox4x32::toDouble01(out[0], out[1]);
+	}
+	// pOut[u] = get01(step, leafIndex, firstSample + u) for u in [0, n)
+	void generate01(NvU64 step, NvU32 leafIndex, NvU32 firstSample, double* pOut, size_t n, SimdLevel simdLevel = getMaxSimdLevel()) const;
+
+private:
+	NvU32 m_key[2];
+};
+
+inline void PathRandom::generate01(NvU64 step, NvU32 leafIndex, NvU32 firstSample, double* pOut, size_t n, SimdLevel simdLevel) const
+{
+	nvAssert(simdLevel <= getMaxSimdLevel());
+	size_t u = 0;
+	// SIMD code works with whole Philox blocks
+	if ((firstSample & 1) && n > 0)
+	{
+		pOut[u++] = get01(step, leafIndex, firstSample);
+	}
+#if defined(__AVX2__) || defined(__AVX512F__)
+	// every 64-bit lane holds one 32-bit word of one block, so _mm*_mul_epu32 gives full 64-bit products
+#if defined(__AVX512F__)
+	if (simdLevel == SIMD_AVX512)
+	{
+		const __m512i lowMask = _mm512_set1_epi64(0xffffffffULL), oneBits = _mm512_set1_epi64(0x3ff0000000000000ULL);
+		const __m512i idxFirst = _mm512_set_epi64(11, 3, 10, 2, 9, 1, 8, 0), idxSecond = _mm512_set_epi64(15, 7, 14, 6, 13, 5, 12, 4);
+		for ( ; u + 16 <= n; u += 16)
+		{
+			NvU32 uBlock = (NvU32)((firstSample + u) / 2);
+			__m512i c0 = _mm512_add_epi64(_mm512_set1_epi64(uBlock), _mm512_set_epi64(7, 6, 5, 4, 3, 2, 1, 0));
+			__m512i c1 = _mm512_set1_epi64(leafIndex), c2 = _mm512_set1_epi64((NvU32)step), c3 = _mm512_set1_epi64((NvU32)(step >> 32));
+			NvU32 k0 = m_key[0], k1 = m_key[1];
+			for (NvU32 uRound = 0; uRound < Philox4x32::N_ROUNDS; ++uRound)
+			{
+				__m512i p0 = _mm512_mul_epu32(c0, _mm512_set1_epi64(Philox4x32::M0)), p1 = _mm512_mul_epu32(c2, _mm512_set1_epi64(Philox4x32::M1));
+				__m512i n0 = _mm512_xor_si512(_mm512_xor_si512(_mm512_srli_epi64(p1, 32), c1), _mm512_set1_epi64(k0));
+				__m512i n2 = _mm512_xor_si512(_mm512_xor_si512(_mm512_srli_epi64(p0, 32), c3), _mm512_set1_epi64(k1));
+				c1 = _mm512_and_si512(p1, lowMask);
+				c3 = _mm512_and_si512(p0, lowMask);
+				c0 = n0;
+				c2 = n2;
+				k0 += Philox4x32::W0;
+				k1 += Philox4x32::W1;
+			}
+			__m512d d0 = _mm512_sub_pd(_mm512_castsi512_pd(_mm512_or_si512(_mm512_srli_epi64(_mm512_or_si512(_mm512_slli_epi64(c1, 32), c0), 12), oneBits)), _mm512_set1_pd(1.));
+			__m512d d1 = _mm512_sub_pd(_mm512_castsi512_pd(_mm512_or_si512(_mm512_srli_epi64(_mm512_or_si512(_mm512_slli_epi64(c3, 32), c2), 12), oneBits)), _mm512_set1_pd(1.));
+			_mm512_storeu_pd(pOut + u, _mm512_permutex2var_pd(d0, idxFirst, d1));
+			_mm512_storeu_pd(pOut + u + 8, _mm512_permutex2var_pd(d0, idxSecond, d1));
+		}
+	}
+#endif
+	if (simdLevel >= SIMD_AVX2)
+	{
+		const __m256i lowMask = _mm256_set1_epi64x(0xffffffffLL), oneBits = _mm256_set1_epi64x(0x3ff0000000000000LL);
+		for ( ; u + 8 <= n; u += 8)
+		{
+			NvU32 uBlock = (NvU32)((firstSample + u) / 2);
+			__m256i c0 = _mm256_add_epi64(_mm256_set1_epi64x(uBlock), _mm256_set_epi64x(3, 2, 1, 0));
+			__m256i c1 = _mm256_set1_epi64x(leafIndex), c2 = _mm256_set1_epi64x((NvU32)step), c3 = _mm256_set1_epi64x((NvU32)(step >> 32));
+			NvU32 k0 = m_key[0], k1 = m_key[1];
+			for (NvU32 uRound = 0; uRound < Philox4x32::N_ROUNDS; ++uRound)
+			{
+				__m256i p0 = _mm256_mul_epu32(c0, _mm256_set1_epi64x(Philox4x32::M0)), p1 = _mm256_mul_epu32(c2, _mm256_set1_epi64x(Philox4x32::M1));
+				__m256i n0 = _mm256_xor_si256(_mm256_xor_si256(_mm256_srli_epi64(p1, 32), c1), _mm256_set1_epi64x(k0));
+				__m256i n2 = _mm256_xor_si256(_mm256_xor_si256(_mm256_srli_epi64(p0, 32), c3), _mm256_set1_epi64x(k1));
+				c1 = _mm256_and_si256(p1, lowMask);
+				c3 = _mm256_and_si256(p0, lowMask);
+				c0 = n0;
+				c2 = n2;
+				k0 += Philox4x32::W0;
+				k1 += Philox4x32::W1;
+			}
+			__m256d d0 = _mm256_sub_pd(_mm256_castsi256_pd(_mm256_or_si256(_mm256_srli_epi64(_mm256_or_si256(_mm256_slli_epi64(c1, 32), c0), 12), oneBits)), _mm256_set1_pd(1.));
+			__m256d d1 = _mm256_sub_pd(_mm256_castsi256_pd(_mm256_or_si256(_mm256_srli_epi64(_mm256_or_si256(_mm256_slli_epi64(c3, 32), c2), 12), oneBits)), _mm256_set1_pd(1.));
+			// samples of one block are next to each other in the output
+			__m256d lo = _mm256_unpacklo_pd(d0, d1), hi = _mm256_unpackhi_pd(d0, d1);
+			_mm256_storeu_pd(pOut + u, _mm256_permute2f128_pd(lo, hi, 0x20));
+			_mm256_storeu_pd(pOut + u + 4, _mm256_permute2f128_pd(lo, hi, 0x31));
+		}
+	}
+#endif
+	for ( ; u + 2 <= n; u += 2)
+	{
+		NvU32 counter[4] = { (NvU32)((firstSample + u) / 2), leafIndex, (NvU32)step, (NvU32)(step >> 32) }, out[4];
+		Philox4x32::generate(counter, m_key, out);
+		pOut[u] = Philox4x32::toDouble01(out[0], out[1]);
+		pOut[u + 1] = Philox4x32::toDouble01(out[2], out[3]);
+	}
+	if (u < n)
+	{
+		pOut[u] = get01(step, leafIndex, (NvU32)(firstSample + u));
+	}
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "gridSoA.h"
+
+// what leaf kernels compute with and keep their per-leaf data in. the tree itself always keeps centers and phases as
+// float (GridElem, GridSoA, snapshots and the viewer all depend on that), so kernels work on LeafArrays of the
+// policy: GeomReal for centers and distances between them, AccumReal for phases and sums of influence. results are
+// converted to double2 at the end either way
+enum Precision
+{
+	PRECISION_MIXED, // float geometry, double sums - what World always did
+	PRECISION_FLOAT,
+	PRECISION_DOUBLE,
+	PRECISION_COUNT
+};
+
+struct MixedPrecision
+{
+	typedef float GeomReal;
+	typedef double AccumReal;
+};
+// half the bytes of every temporary and the float instructions, at the cost of ~1e-7 relative error per term
+struct FloatPrecision
+{
+	typedef float GeomReal;
+	typedef float AccumReal;
+};
+// differences of float centers are computed exactly in double, so distances are only rounded once
+struct DoublePrecision
+{
+	typedef double GeomReal;
+	typedef double AccumReal;
+};
+
+// conversions for inner loops - cheaper than the generic makevector()
+template <class T, class U>
+inline rtvector<T, 2> toReal2(const rtvector<U, 2>& v) { rtvector<T, 2> r = { (T)v.x, (T)v.y }; return r; }
+template <class T, class U>
+inline rtvector<T, 3> toReal3(const rtvector<U, 3>& v) { rtvector<T, 3> r = { (T)v.x, (T)v.y, (T)v.z }; return r; }
+
+// per-leaf copies leaf kernels read and accumulate into, indexed by slot of InteractionLists - neighbors come
+// straight from these arrays instead of from the tree. centers only change with topology, phases every step
+template <class PRECISION>
+struct LeafArrays
+{
+	typedef typename PRECISION::GeomReal GeomReal;
+	typedef typename PRECISION::AccumReal AccumReal;
+	AlignedVector<GeomReal> m_centerX, m_centerY, m_centerZ;
+	AlignedVector<AccumReal> m_phaseX, m_phaseY;
+	AlignedVector<AccumReal> m_influenceX, m_influenceY;
+
+	NvU32 size() const { return (NvU32)m_centerX.size(); }
+	void resize(NvU32 size)
+	{
+		m_centerX.resize(size); m_centerY.resize(size); m_centerZ.resize(size);
+		m_phaseX.resize(size); m_phaseY.resize(size);
+		m_influenceX.resize(size); m_influenceY.resize(size);
+	}
+	void clear()
+	{
+		*this = LeafArrays();
+	}
+	void setCenter(NvU32 uSlot, const float3& vCenter)
+	{
+		m_centerX[uSlot] = (GeomReal)vCenter.x; m_centerY[uSlot] = (GeomReal)vCenter.y; m_centerZ[uSlot] = (GeomReal)vCenter.z;
+	}
+	void setTimePhase(NvU32 uSlot, const float2& timePhase)
+	{
+		m_phaseX[uSlot] = (AccumReal)timePhase.x; m_phaseY[uSlot] = (AccumReal)timePhase.y;
+	}
+};
+
+inline const char* getPrecisionName(Precision precision)
+{
+	static const char* pNames[] = { "mixed", "float", "double" };
+	return precision < PRECISION_COUNT ? pNames[precision] : "unknown";
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "MyMisc.h"
+
+// low-discrepancy sequences of numbers in [0, 1). the first n numbers cover [0, 1) much more evenly than n random
+// numbers do, so integration error decreases close to 1/n instead of 1/sqrt(n)
+
+// radical inverse of the sample index in the given base: digits of the index are mirrored around the decimal point
+struct HaltonSequence
+{
+	explicit HaltonSequence(NvU32 uBase = 2, NvU32 uStartIndex = 0) : m_uBase(uBase), m_uIndex(uStartIndex) { }
+	double next()
+	{
+		double fResult = 0, fDigitScale = 1. / m_uBase;
+		for (NvU32 u = m_uIndex++; u > 0; u /= m_uBase, fDigitScale /= m_uBase)
+		{
+			fResult += (u % m_uBase) * fDigitScale;
+		}
+		return fResult;
+	}
+	void generate(double* pOut, size_t n)
+	{
+		for (size_t u = 0; u < n; ++u)
+		{
+			pOut[u] = next();
+		}
+	}
+private:
+	NvU32 m_uBase, m_uIndex;
+};
+
+// one dimension of Sobol sequence (direction numbers of Joe and Kuo for dimensions 1..7, dimension 0 is van der Corput
+// sequence). numbers are generated in gray code order, so each next number costs one xor. non-zero uScramble applies
+// random digital shift - the sequence stays low-discrepancy, but different scrambles give independent estimates
+struct SobolSequence
+{
+	static const NvU32 MAX_DIMENSIONS = 8;
+	explicit SobolSequence(NvU32 uDimension = 0, NvU32 uScramble = 0) : m_uValue(uScramble)
+	{
+		nvAssert(uDimension < MAX_DIMENSIONS);
+		// degree s, coefficients a and initial direction numbers m of primitive polynomials
+		static const NvU32 s_degrees[MAX_DIMENSIONS] = { 0, 1, 2, 3, 3, 4, 4, 5 };
+		static const NvU32 s_coefficients[MAX_DIMENSIONS] = { 0, 0, 1, 1, 2, 1, 4, 2 };
+		static const NvU32 s_initialM[MAX_DIMENSIONS][5] = { { }, { 1 }, { 1, 3 }, { 1, 3, 1 }, { 1, 1, 1 }, { 1, 1, 3, 3 },
+			{ 1, 3, 5, 13 }, { 1, 1, 5, 5, 17 } };
+		NvU32 s = s_degrees[uDimension], a = s_coefficients[uDimension];
+		for (NvU32 u = 0; u < 32; ++u)
+		{
+			if (uDimension == 0)
+			{
+				m_directions[u] = 1U << (31 - u);
+			}
+			else if (u < s)
+			{
+				m_directions[u] = s_initialM[uDimension][u] << (31 - u);
+			}
+			else
+			{
+				m_directions[u] = m_directions[u - s] ^ (m_directions[u - s] >> s);
+				for (NvU32 k = 1; k < s; ++k)
+				{
+					m_directions[u] ^= ((a >> (s - 1 - k)) & 1) * m_directions[u - k];
+				}
+			}
+		}
+	}
+	double next()
+	{
+		double fResult = m_uValue * (1. / 4294967296.);
+		// next value differs from the current one in the direction of the lowest zero bit of the index
+		NvU32 uBit = 0;
+		for (NvU32 u = m_uIndex++; u & 1; u >>= 1)
+		{
+			++uBit;
+		}
+		m_uValue ^= m_directions[uBit & 31];
+		return fResult;
+	}
+	void generate(double* pOut, size_t n)
+	{
+		for (size_t u = 0; u < n; ++u)
+		{
+			pOut[u] = next();
+		}
+	}
+private:
+	NvU32 m_directions[32];
+	NvU32 m_uValue, m_uIndex = 0;
+};
@@ -0,0 +1,109 @@
+#include <string.h>
+#include <new>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#ifndef _WIN32
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+#include "shmQueue.h"
+
+bool ShmSegment::create(size_t nBytes)
+{
+	close();
+#ifdef _WIN32
+	return false;
+#else
+	static std::atomic<NvU32> s_nSegments{ 0 };
+	char sName[64];
+	snprintf(sName, sizeof(sName), "/wave.%d.%u", (int)getpid(), s_nSegments++);
+	int fd = shm_open(sName, O_RDWR | O_CREAT | O_EXCL, 0600);
+	if (fd < 0)
+		return false;
+	void* pData = ftruncate(fd, (off_t)nBytes) == 0 ? mmap(nullptr, nBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+	::close(fd);
+	shm_unlink(sName);
+	if (pData == MAP_FAILED)
+		return false;
+	m_pData = pData;
+	m_nBytes = nBytes;
+	return true;
+#endif
+}
+
+void ShmSegment::close()
+{
+#ifndef _WIN32
+	if (m_pData)
+	{
+		munmap(m_pData, m_nBytes);
+	}
+#endif
+	m_pData = nullptr;
+	m_nBytes = 0;
+}
+
+ShmQueue* ShmQueue::create(void* pMemory, NvU32 capacity)
+{
+	ShmQueue* pQueue = new (pMemory) ShmQueue();
+	pQueue->m_writePos = 0;
+	pQueue->m_readPos = 0;
+	pQueue->m_capacity = capacity;
+	return pQueue;
+}
+
+size_t ShmQueue::tryPush(const void* pData, size_t nBytes)
+{
+	NvU64 writePos = m_writePos.load(std::memory_order_relaxed);
+	NvU64 readPos = m_readPos.load(std::memory_order_acquire);
+	nBytes = std::min<size_t>(nBytes, (size_t)(m_capacity - (writePos - readPos)));
+	// the free space may wrap around the end of the ring
+	size_t uStart = (size_t)(writePos % m_capacity), nFirst = std::min<size_t>(nBytes, m_capacity - uStart);
+	memcpy(getRing() + uStart, pData, nFirst);
+	memcpy(getRing(), (const char*)pData + nFirst, nBytes - nFirst);
+	m_writePos.store(writePos + nBytes, std::memory_order_release);
+	return nBytes;
+}
+
+size_t ShmQueue::tryPop(void* pData, size_t nBytes)
+{
+	NvU64 readPos = m_readPos.load(std::memory_order_relaxed);
+	NvU64 writePos = m_writePos.load(std::memory_order_acquire);
+	nBytes = std::min<size_t>(nBytes, (size_t)(writePos - readPos));
+	size_t uStart = (size_t)(readPos % m_capacity), nFirst = std::min<size_t>(nBytes, m_capacity - uStart);
+	memcpy(pData, getRing() + uStart, nFirst);
+	memcpy((char*)pData + nFirst, getRing(), nBytes - nFirst);
+	m_readPos.store(readPos + nBytes, std::memory_order_release);
+	return nBytes;
+}
+
+void ShmQueue::push(const void* pData, size_t nBytes)
+{
+	ShmBackoff backoff;
+	for (size_t nPushed = tryPush(pData, nBytes); nPushed < nBytes; nPushed += tryPush((const char*)pData + nPushed, nBytes - nPushed))
+	{
+		backoff.wait();
+	}
+}
+
+void ShmQueue::pop(void* pData, size_t nBytes)
+{
+	ShmBackoff backoff;
+	for (size_t nPopped = tryPop(pData, nBytes); nPopped < nBytes; nPopped += tryPop((char*)pData + nPopped, nBytes - nPopped))
+	{
+		backoff.wait();
+	}
+}
+
+void ShmBackoff::wait()
+{
+	if (++m_nWaits < 64)
+	{
+		std::this_thread::yield();
+		return;
+	}
+	std::this_thread::sleep_for(std::chrono::microseconds(50));
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include "MyMisc.h"
+
+// POSIX shared memory (shm_open + mmap). the name is unlinked right after mapping, so only processes forked after
+// create() share the segment and nothing is left behind in /dev/shm if they crash. not available on windows
+struct ShmSegment
+{
+	ShmSegment() { }
+	ShmSegment(const ShmSegment&) = delete;
+	ShmSegment& operator=(const ShmSegment&) = delete;
+	~ShmSegment() { close(); }
+
+	// memory comes zeroed
+	bool create(size_t nBytes);
+	void close();
+	void* getData() const { return m_pData; }
+	size_t getSize() const { return m_nBytes; }
+
+private:
+	void* m_pData = nullptr;
+	size_t m_nBytes = 0;
+};
+
+// single producer single consumer ring of bytes. lives in shared memory together with its data, so producer and
+// consumer may be different processes. positions only grow - the place in the ring is position % capacity.
+// nothing blocks: push and pop move as many bytes as they can and return that number
+struct ShmQueue
+{
+	static size_t getBytesNeeded(NvU32 capacity) { return NV_ALIGN_UP(sizeof(ShmQueue) + capacity, 64); }
+	// constructs the queue at pMemory, which must have getBytesNeeded(capacity) bytes
+	static ShmQueue* create(void* pMemory, NvU32 capacity);
+
+	size_t tryPush(const void* pData, size_t nBytes);
+	size_t tryPop(void* pData, size_t nBytes);
+	// for small messages - spin until everything is moved
+	void push(const void* pData, size_t nBytes);
+	void pop(void* pData, size_t nBytes);
+
+private:
+	char* getRing() { return (char*)(this + 1); }
+
+	// on different cache lines, so producer and consumer don't fight over one
+	alignas(64) std::atomic<NvU64> m_writePos;
+	alignas(64) std::atomic<NvU64> m_readPos;
+	NvU32 m_capacity;
+	static_assert(std::atomic<NvU64>::is_always_lock_free, "positions are shared between processes");
+};
+
+// waiting for another process: spins for a while, then sleeps a little, so a waiting process doesn't take the core
+// from the one it waits for
+struct ShmBackoff
+{
+	void wait();
+	void reset() { m_nWaits = 0; }
+private:
+	NvU32 m_nWaits = 0;
+};
@@ -0,0 +1,238 @@
+#pragma once
+
+#include <string.h>
+#include <math.h>
+#include "MyMisc.h"
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+// instruction sets the kernels can be run with. which ones are available is decided at compile time
+// (/arch:AVX2 or /arch:AVX512 in MSVC, -mavx2 -mfma or -mavx512f in gcc)
+enum SimdLevel
+{
+	SIMD_SCALAR,
+	SIMD_AVX2,
+	SIMD_AVX512,
+};
+inline SimdLevel getMaxSimdLevel()
+{
+#if defined(__AVX512F__)
+	return SIMD_AVX512;
+#elif defined(__AVX2__)
+	return SIMD_AVX2;
+#else
+	return SIMD_SCALAR;
+#endif
+}
+
+// vectors of doubles. all of them have the same interface, so kernels are written once as templates and
+// instantiated for each width. getExponent(), getMantissa() and pow2() only work for positive normal numbers.
+// gather() reads pTable at indices given as small non-negative whole numbers - loadIndices() makes them from NvU32
+// indices below 2^31. gatherFloat() reads floats at such indices straight away
+struct SimdD1
+{
+	static const NvU32 WIDTH = 1;
+	typedef bool Mask;
+	double v;
+	SimdD1() { }
+	SimdD1(double f) : v(f) { }
+	static SimdD1 load(const double* p) { return *p; }
+	static SimdD1 loadFloat(const float* p) { return (double)*p; }
+	void store(double* p) const { *p = v; }
+
+	friend SimdD1 operator+(SimdD1 a, SimdD1 b) { return a.v + b.v; }
+	friend SimdD1 operator-(SimdD1 a, SimdD1 b) { return a.v - b.v; }
+	friend SimdD1 operator*(SimdD1 a, SimdD1 b) { return a.v * b.v; }
+	friend SimdD1 operator/(SimdD1 a, SimdD1 b) { return a.v / b.v; }
+	friend Mask operator<(SimdD1 a, SimdD1 b) { return a.v < b.v; }
+	friend Mask operator==(SimdD1 a, SimdD1 b) { return a.v == b.v; }
+	friend SimdD1 sqrt(SimdD1 a) { return ::sqrt(a.v); }
+	friend SimdD1 max(SimdD1 a, SimdD1 b) { return a.v > b.v ? a.v : b.v; }
+	friend SimdD1 min(SimdD1 a, SimdD1 b) { return a.v < b.v ? a.v : b.v; }
+	friend SimdD1 floor(SimdD1 a) { return ::floor(a.v); }
+	friend SimdD1 select(Mask m, SimdD1 a, SimdD1 b) { return m ? a : b; }
+
+	static SimdD1 getExponent(SimdD1 a) { NvU64 u = toBits(a.v); return (double)(NvU32)(u >> 52) - 1023; }
+	static SimdD1 getMantissa(SimdD1 a) { NvU64 u = toBits(a.v); return fromBits((u & MANTISSA_MASK) | ONE_BITS); }
+	static SimdD1 pow2(SimdD1 k) { return fromBits((NvU64)((NvU32)(k.v + 1023)) << 52); }
+	static SimdD1 gather(const double* pTable, SimdD1 index) { return pTable[(NvU32)index.v]; }
+	static SimdD1 loadIndices(const NvU32* p) { return (double)*p; }
+	static SimdD1 gatherFloat(const float* pTable, const NvU32* pIndices) { return (double)pTable[*pIndices]; }
+
+	static const NvU64 MANTISSA_MASK = 0x000fffffffffffffULL;
+	static const NvU64 ONE_BITS = 0x3ff0000000000000ULL;
+private:
+	static NvU64 toBits(double f) { NvU64 u; memcpy(&u, &f, sizeof(u)); return u; }
+	static double fromBits(NvU64 u) { double f; memcpy(&f, &u, sizeof(f)); return f; }
+};
+
+// integers with less than 52 bits are converted between int64 and double by adding or subtracting 2^52 - the
+// integer then sits in the low bits of the mantissa. AVX2 and plain AVX-512F don't have 64-bit int <-> double conversions
+#define SIMD_TWO_POW_52 4503599627370496.0
+
+#if defined(__AVX2__) || defined(__AVX512F__)
+struct SimdD4
+{
+	static const NvU32 WIDTH = 4;
+	typedef __m256d Mask;
+	__m256d v;
+	SimdD4() { }
+	SimdD4(__m256d f) : v(f) { }
+	SimdD4(double f) : v(_mm256_set1_pd(f)) { }
+	static SimdD4 load(const double* p) { return _mm256_loadu_pd(p); }
+	static SimdD4 loadFloat(const float* p) { return _mm256_cvtps_pd(_mm_loadu_ps(p)); }
+	void store(double* p) const { _mm256_storeu_pd(p, v); }
+
+	friend SimdD4 operator+(SimdD4 a, SimdD4 b) { return _mm256_add_pd(a.v, b.v); }
+	friend SimdD4 operator-(SimdD4 a, SimdD4 b) { return _mm256_sub_pd(a.v, b.v); }
+	friend SimdD4 operator*(SimdD4 a, SimdD4 b) { return _mm256_mul_pd(a.v, b.v); }
+	friend SimdD4 operator/(SimdD4 a, SimdD4 b) { return _mm256_div_pd(a.v, b.v); }
+	friend Mask operator<(SimdD4 a, SimdD4 b) { return _mm256_cmp_pd(a.v, b.v, _CMP_LT_OQ); }
+	friend Mask operator==(SimdD4 a, SimdD4 b) { return _mm256_cmp_pd(a.v, b.v, _CMP_EQ_OQ); }
+	friend SimdD4 sqrt(SimdD4 a) { return _mm256_sqrt_pd(a.v); }
+	friend SimdD4 max(SimdD4 a, SimdD4 b) { return _mm256_max_pd(a.v, b.v); }
+	friend SimdD4 min(SimdD4 a, SimdD4 b) { return _mm256_min_pd(a.v, b.v); }
+	friend SimdD4 floor(SimdD4 a) { return _mm256_floor_pd(a.v); }
+	friend SimdD4 select(Mask m, SimdD4 a, SimdD4 b) { return _mm256_blendv_pd(b.v, a.v, m); }
+
+	static SimdD4 getExponent(SimdD4 a)
+	{
+		__m256i u = _mm256_srli_epi64(_mm256_castpd_si256(a.v), 52);
+		__m256d f = _mm256_castsi256_pd(_mm256_or_si256(u, _mm256_castpd_si256(_mm256_set1_pd(SIMD_TWO_POW_52))));
+		return _mm256_sub_pd(f, _mm256_set1_pd(SIMD_TWO_POW_52 + 1023));
+	}
+	static SimdD4 getMantissa(SimdD4 a)
+	{
+		__m256i u = _mm256_and_si256(_mm256_castpd_si256(a.v), _mm256_set1_epi64x(SimdD1::MANTISSA_MASK));
+		return _mm256_castsi256_pd(_mm256_or_si256(u, _mm256_set1_epi64x(SimdD1::ONE_BITS)));
+	}
+	static SimdD4 pow2(SimdD4 k)
+	{
+		__m256d f = _mm256_add_pd(k.v, _mm256_set1_pd(SIMD_TWO_POW_52 + 1023));
+		return _mm256_castsi256_pd(_mm256_slli_epi64(_mm256_castpd_si256(f), 52));
+	}
+	static SimdD4 gather(const double* pTable, SimdD4 index)
+	{
+		__m256i i = _mm256_xor_si256(_mm256_castpd_si256(_mm256_add_pd(index.v, _mm256_set1_pd(SIMD_TWO_POW_52))),
+			_mm256_castpd_si256(_mm256_set1_pd(SIMD_TWO_POW_52)));
+		return _mm256_i64gather_pd(pTable, i, 8);
+	}
+	static SimdD4 loadIndices(const NvU32* p) { return _mm256_cvtepi32_pd(_mm_loadu_si128((const __m128i*)p)); }
+	static SimdD4 gatherFloat(const float* pTable, const NvU32* pIndices)
+	{
+		return _mm256_cvtps_pd(_mm_i32gather_ps(pTable, _mm_loadu_si128((const __m128i*)pIndices), 4));
+	}
+};
+#endif
+
+#if defined(__AVX512F__)
+struct SimdD8
+{
+	static const NvU32 WIDTH = 8;
+	typedef __mmask8 Mask;
+	__m512d v;
+	SimdD8() { }
+	SimdD8(__m512d f) : v(f) { }
+	SimdD8(double f) : v(_mm512_set1_pd(f)) { }
+	static SimdD8 load(const double* p) { return _mm512_loadu_pd(p); }
+	static SimdD8 loadFloat(const float* p) { return _mm512_cvtps_pd(_mm256_loadu_ps(p)); }
+	void store(double* p) const { _mm512_storeu_pd(p, v); }
+
+	friend SimdD8 operator+(SimdD8 a, SimdD8 b) { return _mm512_add_pd(a.v, b.v); }
+	friend SimdD8 operator-(SimdD8 a, SimdD8 b) { return _mm512_sub_pd(a.v, b.v); }
+	friend SimdD8 operator*(SimdD8 a, SimdD8 b) { return _mm512_mul_pd(a.v, b.v); }
+	friend SimdD8 operator/(SimdD8 a, SimdD8 b) { return _mm512_div_pd(a.v, b.v); }
+	friend Mask operator<(SimdD8 a, SimdD8 b) { return _mm512_cmp_pd_mask(a.v, b.v, _CMP_LT_OQ); }
+	friend Mask operator==(SimdD8 a, SimdD8 b) { return _mm512_cmp_pd_mask(a.v, b.v, _CMP_EQ_OQ); }
+	friend SimdD8 sqrt(SimdD8 a) { return _mm512_sqrt_pd(a.v); }
+	friend SimdD8 max(SimdD8 a, SimdD8 b) { return _mm512_max_pd(a.v, b.v); }
+	friend SimdD8 min(SimdD8 a, SimdD8 b) { return _mm512_min_pd(a.v, b.v); }
+	friend SimdD8 floor(SimdD8 a) { return _mm512_roundscale_pd(a.v, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC); }
+	friend SimdD8 select(Mask m, SimdD8 a, SimdD8 b) { return _mm512_mask_blend_pd(m, b.v, a.v); }
+
+	static SimdD8 getExponent(SimdD8 a)
+	{
+		__m512i u = _mm512_srli_epi64(_mm512_castpd_si512(a.v), 52);
+		__m512d f = _mm512_castsi512_pd(_mm512_or_si512(u, _mm512_castpd_si512(_mm512_set1_pd(SIMD_TWO_POW_52))));
+		return _mm512_sub_pd(f, _mm512_set1_pd(SIMD_TWO_POW_52 + 1023));
+	}
+	static SimdD8 getMantissa(SimdD8 a)
+	{
+		__m512i u = _mm512_and_si512(_mm512_castpd_si512(a.v), _mm512_set1_epi64(SimdD1::MANTISSA_MASK));
+		return _mm512_castsi512_pd(_mm512_or_si512(u, _mm512_set1_epi64(SimdD1::ONE_BITS)));
+	}
+	static SimdD8 pow2(SimdD8 k)
+	{
+		__m512d f = _mm512_add_pd(k.v, _mm512_set1_pd(SIMD_TWO_POW_52 + 1023));
+		return _mm512_castsi512_pd(_mm512_slli_epi64(_mm512_castpd_si512(f), 52));
+	}
+	static SimdD8 gather(const double* pTable, SimdD8 index)
+	{
+		__m512i i = _mm512_xor_si512(_mm512_castpd_si512(_mm512_add_pd(index.v, _mm512_set1_pd(SIMD_TWO_POW_52))),
+			_mm512_castpd_si512(_mm512_set1_pd(SIMD_TWO_POW_52)));
+		return _mm512_i64gather_pd(i, pTable, 8);
+	}
+	static SimdD8 loadIndices(const NvU32* p) { return _mm512_cvtepi32_pd(_mm256_loadu_si256((const __m256i*)p)); }
+	static SimdD8 gatherFloat(const float* pTable, const NvU32* pIndices)
+	{
+		return _mm512_cvtps_pd(_mm256_i32gather_ps(pTable, _mm256_loadu_si256((const __m256i*)pIndices), 4));
+	}
+};
+#endif
+
+// calls func.template run<V>(u) for every group of V::WIDTH elements and func.template run<SimdD1>(u) for the rest
+// of the n elements, where V is the widest vector allowed by simdLevel
+template <class FUNC>
+inline void simdFor(SimdLevel simdLevel, size_t n, FUNC& func)
+{
+	nvAssert(simdLevel <= getMaxSimdLevel());
+	size_t u = 0;
+#if defined(__AVX512F__)
+	if (simdLevel == SIMD_AVX512)
+	{
+		for (size_t nFull = n / SimdD8::WIDTH * SimdD8::WIDTH; u < nFull; u += SimdD8::WIDTH)
+		{
+			func.template run<SimdD8>(u);
+		}
+	}
+#endif
+#if defined(__AVX2__) || defined(__AVX512F__)
+	if (simdLevel >= SIMD_AVX2)
+	{
+		for (size_t nFull = n / SimdD4::WIDTH * SimdD4::WIDTH; u < nFull; u += SimdD4::WIDTH)
+		{
+			func.template run<SimdD4>(u);
+		}
+	}
+#endif
+	for ( ; u < n; ++u)
+	{
+		func.template run<SimdD1>(u);
+	}
+}
+
+// natural logarithm of positive normal numbers. x = m * 2^e with m in [sqrt(2)/2, sqrt(2)), then
+// log(m) = 2 * atanh(s), s = (m - 1) / (m + 1), |s| < 0.172. the series up to s^19 is accurate to ~1 ulp
+template <class V>
+inline V logSimd(V x)
+{
+	V e = V::getExponent(x);
+	V m = V::getMantissa(x);
+	typename V::Mask isBig = V(1.4142135623730951) < m;
+	m = select(isBig, m * V(0.5), m);
+	e = select(isBig, e + V(1.), e);
+	V s = (m - V(1.)) / (m + V(1.));
+	V z = s * s;
+	V p = V(2. / 19);
+	p = p * z + V(2. / 17);
+	p = p * z + V(2. / 15);
+	p = p * z + V(2. / 13);
+	p = p * z + V(2. / 11);
+	p = p * z + V(2. / 9);
+	p = p * z + V(2. / 7);
+	p = p * z + V(2. / 5);
+	p = p * z + V(2. / 3);
+	p = p * z + V(2.);
+	return e * V(0.69314718055994531) + s * p;
+}
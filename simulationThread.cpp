@@ -0,0 +1,91 @@
+#include "wave.h"
+#include "simulationThread.h"
+
+void SimulationThread::start(World& world)
+{
+	nvAssert(!isRunning());
+	m_pWorld = &world;
+	// the first updatePoints() rewrites everything, and so does the first publish to each slot
+	world.accessStorage().setTrackChanges(false);
+	m_points.clear();
+	m_timePhases.clear();
+	for (StaleRanges& stale : m_staleRanges)
+	{
+		stale = StaleRanges();
+	}
+	m_shouldStop.store(false);
+	m_nSteps.store(0);
+	m_thread = std::thread([this]() { run(); });
+}
+
+void SimulationThread::stop()
+{
+	if (!isRunning())
+		return;
+	m_shouldStop.store(true);
+	m_thread.join();
+	m_pWorld = nullptr;
+}
+
+void SimulationThread::run()
+{
+	while (!m_shouldStop.load(std::memory_order_relaxed))
+	{
+		m_pWorld->makeSimulationStep();
+		WAVE_TRACE_SCOPE("simulationThread.publish");
+		size_t nPrevPoints = m_points.size();
+		m_pWorld->updatePoints(m_points, m_changedRanges, &m_timePhases);
+		for (StaleRanges& stale : m_staleRanges)
+		{
+			// a slot that was larger has points past the end of a shrunk buffer that regrowing wouldn't clear
+			if (m_points.size() < nPrevPoints)
+			{
+				stale.m_isAll = true;
+			}
+			addStaleRanges(stale);
+		}
+		SimulationSnapshot& snapshot = m_snapshots.accessBack();
+		updateSnapshot(snapshot, m_staleRanges[m_snapshots.getBackIndex()]);
+		snapshot.m_stepIndex = m_pWorld->getStepIndex();
+		// STORAGE_LINEAR doesn't adapt, so the version of the (empty) pointer storage stays right for it too
+		snapshot.m_topologyVersion = m_pWorld->accessStorage().getTopologyVersion();
+		m_snapshots.publish();
+		m_nSteps.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+void SimulationThread::addStaleRanges(StaleRanges& stale) const
+{
+	for (const World::PointRange& range : m_changedRanges)
+	{
+		if (stale.m_isAll)
+			return;
+		stale.m_ranges.push_back(range);
+		stale.m_nPoints += range.m_nPoints;
+		stale.m_isAll = stale.m_nPoints >= m_points.size();
+	}
+}
+
+void SimulationThread::updateSnapshot(SimulationSnapshot& snapshot, StaleRanges& stale) const
+{
+	if (stale.m_isAll)
+	{
+		snapshot.m_points = m_points;
+		snapshot.m_timePhases = m_timePhases;
+	}
+	else
+	{
+		// elements that appeared since the slot was written last are zero until they show up in the changes
+		snapshot.m_points.resize(m_points.size(), makefloat3(0.f));
+		snapshot.m_timePhases.resize(m_timePhases.size(), makefloat2(0.f));
+		for (const World::PointRange& range : stale.m_ranges)
+		{
+			std::copy(m_points.begin() + range.m_firstPoint, m_points.begin() + range.m_firstPoint + range.m_nPoints,
+				snapshot.m_points.begin() + range.m_firstPoint);
+			std::copy(m_timePhases.begin() + range.m_firstPoint / 6, m_timePhases.begin() + (range.m_firstPoint + range.m_nPoints) / 6,
+				snapshot.m_timePhases.begin() + range.m_firstPoint / 6);
+		}
+	}
+	stale = StaleRanges();
+	stale.m_isAll = false;
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include "wave.h"
+
+// one producer and one consumer hand over whole objects without locks and without waiting for each other. of the
+// three slots the producer owns one (back), the consumer owns one (front), and the third one holds the latest
+// published object. publish() and acquire() swap the slot they own with the middle one - a single atomic exchange of
+// the middle index, with a bit that tells if the middle slot has anything the consumer hasn't seen yet
+template <class T>
+struct TripleBuffer
+{
+	// producer side. the object is whatever was there three publishes ago (or default constructed), so buffers of
+	// T can be reused
+	T& accessBack() { return m_slots[m_uBack]; }
+	// 0, 1 or 2 - lets the producer keep its own state for each slot
+	NvU32 getBackIndex() const { return m_uBack; }
+	void publish()
+	{
+		// release: writes to the back slot are visible to whoever takes it. acquire: the consumer is done reading
+		// the slot we get back
+		m_uBack = m_middle.exchange(m_uBack | NEW_BIT, std::memory_order_acq_rel) & INDEX_MASK;
+	}
+	// consumer side. returns true if the front slot has been replaced with a newer one
+	bool acquire()
+	{
+		if (!(m_middle.load(std::memory_order_relaxed) & NEW_BIT))
+			return false;
+		m_uFront = m_middle.exchange(m_uFront, std::memory_order_acq_rel) & INDEX_MASK;
+		return true;
+	}
+	// stays the same until the next acquire() that returns true
+	const T& getFront() const { return m_slots[m_uFront]; }
+
+private:
+	static const NvU32 INDEX_MASK = 3, NEW_BIT = 4;
+	T m_slots[3];
+	std::atomic<NvU32> m_middle{ 1 };
+	NvU32 m_uBack = 0, m_uFront = 2;
+};
+
+// what the simulation thread publishes after every step: lines of the leaves and their time phases, laid out the way
+// World::updatePoints() does it - element with slot s owns points [6 * s, 6 * s + 6) and m_timePhases[s]. the
+// topology version changes only when the lines do, so the consumer can skip looking at geometry
+struct SimulationSnapshot
+{
+	NvU64 m_stepIndex = 0;
+	NvU32 m_topologyVersion = 0;
+	std::vector<float3> m_points;
+	std::vector<float2> m_timePhases;
+};
+
+// runs makeSimulationStep() on its own thread as fast as it can. every step is published through a TripleBuffer,
+// the consumer picks up the latest one whenever it wants - steps it didn't look at are just overwritten. leaves are
+// taken from World::updatePoints(), and each slot only gets the ranges that changed since it was written last, so
+// publishing costs as much as the splits, merges and phase changes do
+struct SimulationThread
+{
+	~SimulationThread() { stop(); }
+	// world must be initialized. it belongs to the simulation thread until stop() - nobody else may touch it. change
+	// tracking of its storage is restarted, so whoever used updatePoints() before has to start over too
+	void start(World& world);
+	// waits for the current step to finish
+	void stop();
+	bool isRunning() const { return m_thread.joinable(); }
+	// consumer side, see TripleBuffer
+	bool acquireSnapshot() { return m_snapshots.acquire(); }
+	const SimulationSnapshot& getSnapshot() const { return m_snapshots.getFront(); }
+	// number of steps made since start()
+	NvU64 getNSteps() const { return m_nSteps.load(std::memory_order_relaxed); }
+
+private:
+	// points a slot of the triple buffer is missing. once they add up to the whole buffer it is copied as a whole
+	struct StaleRanges
+	{
+		std::vector<World::PointRange> m_ranges;
+		NvU32 m_nPoints = 0;
+		bool m_isAll = true;
+	};
+	void run();
+	void addStaleRanges(StaleRanges& stale) const;
+	void updateSnapshot(SimulationSnapshot& snapshot, StaleRanges& stale) const;
+
+	World* m_pWorld = nullptr;
+	// the latest leaves, kept up to date by World::updatePoints()
+	std::vector<float3> m_points;
+	std::vector<float2> m_timePhases;
+	std::vector<World::PointRange> m_changedRanges;
+	StaleRanges m_staleRanges[3];
+	TripleBuffer<SimulationSnapshot> m_snapshots;
+	std::thread m_thread;
+	std::atomic<bool> m_shouldStop{ false };
+	std::atomic<NvU64> m_nSteps{ 0 };
+};
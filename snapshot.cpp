@@ -0,0 +1,104 @@
+#define _CRT_SECURE_NO_WARNINGS // fopen() is fine here
+#include <stdio.h>
+#include <string>
+#include "wave.h"
+
+bool Storage::saveSnapshot(const char* sPath, SnapshotHeader header) const
+{
+	WAVE_TRACE_SCOPE("snapshot.save");
+	memcpy(header.m_magic, SnapshotHeader::getMagic(), sizeof(header.m_magic));
+	header.m_version = SnapshotHeader::VERSION;
+	header.m_elemBytes = sizeof(GridElem);
+	header.m_boxBytes = sizeof(float3Box);
+	header.m_nRoots = getNRoots();
+	header.m_nChildren = m_pChildren.size();
+	header.m_nUsedChildren = m_nUsedChildren;
+	header.m_firstFreeChild = m_firstFreeChild;
+	header.m_padding = 0;
+	size_t nRootsEnd = sizeof(header) + header.m_nRoots * (sizeof(GridElem) + sizeof(float3Box));
+	header.m_childrenOffset = NV_ALIGN_UP(nRootsEnd, SnapshotHeader::SNAPSHOT_ALIGNMENT);
+
+	std::string sTmpPath = std::string(sPath) + ".tmp";
+	FILE* pFile = fopen(sTmpPath.c_str(), "wb");
+	if (!pFile)
+		return false;
+	bool isOk = fwrite(&header, sizeof(header), 1, pFile) == 1;
+	if (header.m_nRoots > 0)
+	{
+		isOk = isOk && fwrite(&m_pRoots[0], sizeof(GridElem), header.m_nRoots, pFile) == header.m_nRoots;
+		isOk = isOk && fwrite(&m_pRootBoxes[0], sizeof(float3Box), header.m_nRoots, pFile) == header.m_nRoots;
+	}
+	std::vector<char> padding(header.m_childrenOffset - nRootsEnd, 0);
+	isOk = isOk && (padding.empty() || fwrite(&padding[0], 1, padding.size(), pFile) == padding.size());
+	m_pChildren.forEachRun([&](const GridElem* pElems, size_t nElems)
+	{
+		isOk = isOk && fwrite(pElems, sizeof(GridElem), nElems, pFile) == nElems;
+	});
+	isOk = fclose(pFile) == 0 && isOk;
+	if (!isOk)
+	{
+		remove(sTmpPath.c_str());
+		return false;
+	}
+#ifdef _WIN32
+	// rename() doesn't replace existing files on Windows
+	remove(sPath);
+#endif
+	return rename(sTmpPath.c_str(), sPath) == 0;
+}
+
+bool Storage::loadSnapshot(const char* sPath, SnapshotHeader& header)
+{
+	WAVE_TRACE_SCOPE("snapshot.load");
+	nvAssert(m_pRoots.empty() && m_pChildren.size() == 0);
+	FILE* pFile = fopen(sPath, "rb");
+	if (!pFile)
+		return false;
+	bool isOk = fread(&header, sizeof(header), 1, pFile) == 1 &&
+		memcmp(header.m_magic, SnapshotHeader::getMagic(), sizeof(header.m_magic)) == 0 &&
+		header.m_version == SnapshotHeader::VERSION &&
+		header.m_elemBytes == sizeof(GridElem) && header.m_boxBytes == sizeof(float3Box);
+	if (isOk && header.m_nRoots > 0)
+	{
+		m_pRoots.resize(header.m_nRoots);
+		m_pRootBoxes.resize(header.m_nRoots);
+		isOk = fread(&m_pRoots[0], sizeof(GridElem), header.m_nRoots, pFile) == header.m_nRoots &&
+			fread(&m_pRootBoxes[0], sizeof(float3Box), header.m_nRoots, pFile) == header.m_nRoots;
+	}
+	fclose(pFile);
+	isOk = isOk && m_pChildren.mapFile(sPath, (size_t)header.m_childrenOffset, header.m_nChildren);
+	if (!isOk)
+	{
+		m_pRoots.clear();
+		m_pRootBoxes.clear();
+		return false;
+	}
+	m_nUsedChildren = header.m_nUsedChildren;
+	m_firstFreeChild = header.m_firstFreeChild;
+	++m_topologyVersion;
+	m_areAllChanged = true;
+	setLayout(m_layout);
+	return true;
+}
+
+bool World::saveSnapshot(const char* sPath) const
+{
+	nvAssert(m_backend == STORAGE_POINTER);
+	SnapshotHeader header = { };
+	header.m_stepIndex = m_stepIndex;
+	header.m_seed = m_pathRandom.getSeed();
+	return m_storage.saveSnapshot(sPath, header);
+}
+
+bool World::loadSnapshot(const char* sPath)
+{
+	reset(STORAGE_POINTER);
+	SnapshotHeader header;
+	if (!m_storage.loadSnapshot(sPath, header))
+		return false;
+	m_stepIndex = header.m_stepIndex;
+	m_pathRandom.setSeed(header.m_seed);
+	// time grids are not in the file - leaves start with empty ones
+	m_storage.setUseTimeGrids(m_useTimeGrids);
+	return true;
+}
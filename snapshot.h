@@ -0,0 +1,24 @@
+#pragma once
+
+#include "MyMisc.h"
+
+// binary snapshot of World with STORAGE_POINTER. the file is: header, roots, root boxes, padding up to
+// SNAPSHOT_ALIGNMENT, children. GridElem and float3Box are written as they are in memory, so a file can only be
+// read by a build with the same layout of those - m_elemBytes and m_boxBytes catch most mismatches. children
+// start at an aligned offset, so they can be mapped straight from the file instead of being read
+struct SnapshotHeader
+{
+	static const NvU32 VERSION = 1;
+	static const size_t SNAPSHOT_ALIGNMENT = 64 * 1024;
+
+	char m_magic[8];
+	NvU32 m_version;
+	NvU32 m_elemBytes, m_boxBytes;
+	NvU32 m_nRoots, m_nChildren, m_nUsedChildren, m_firstFreeChild;
+	NvU32 m_padding;
+	NvU64 m_childrenOffset;
+	// World state
+	NvU64 m_stepIndex, m_seed;
+
+	static const char* getMagic() { return "WAVESNAP"; }
+};
@@ -1,65 +1,130 @@
 #pragma once
 
-template <class T, NvU32 N>
-struct Storage
-{
-	NvU32 allocateNElems();
-	void freeNElems(NvU32 u);
-	inline NvU32 evalElemIndex(const T& el) const { return &el - &m_elems[0]; }
-	inline T &getElem(NvU32 u) { return m_elems[u]; }
-
-private:
-	std::vector<T> m_elems;
-	std::vector<NvU32> m_freeElems;
-};
+#include <vector>
+#include <algorithm>
+#include "gridSoA.h"
+#include "simd.h"
 
+// one slot of a time grid. position amplitude only - i don't really know if velocity amplitude is needed too
 struct TimeBox
 {
-	// position aplitude. i don't really know what i am doing, so i am not sure if i also need velocity amplitude. trying with position for now
-	double2 m_posAmpSum = double2(0);
+	double2 m_posAmpSum = makedouble2(0.);
 	double m_weightsSum = 0;
 };
 
-// unlike space grid, the time grid is uniform. i believe electrons in bound state are supposed to be standing waves, so the amplitude in time
-// is going to just rotate with some period. that's the reason we shouldn't need adaptive grid in time dimension
-template <NvU32 N>
-struct TimeGrid
+// (x, y) *= (cos, sin) for arrays of x and y - body of simdFor()
+struct ComplexRotation
 {
-	TimeBox& operator[](NvU32 u) { nvAssert(u < N); return m_timeBoxes[u]; }
-	const TimeBox& operator[](NvU32 u) const { nvAssert(u < N); return m_timeBoxes[u]; }
-private:
-	TimeBox m_timeBoxes[N];
+	template <class V>
+	void run(size_t u)
+	{
+		V x = V::load(m_pX + u), y = V::load(m_pY + u);
+		(x * V(m_fCos) - y * V(m_fSin)).store(m_pX + u);
+		(x * V(m_fSin) + y * V(m_fCos)).store(m_pY + u);
+	}
+	double* m_pX;
+	double* m_pY;
+	double m_fCos, m_fSin;
 };
 
-struct SpaceBox
+// unlike space grid, the time grid is uniform. i believe electrons in bound state are supposed to be standing waves, so
+// the amplitude in time is going to just rotate with some period. that's the reason we shouldn't need adaptive grid in
+// time dimension.
+// time grids of all leaves live in one pool, every field in its own array. slots of grid g are [g * N, g * N + N), so
+// copying a grid is N consecutive elements per field and rotating all grids is one flat loop over the arrays
+template <NvU32 N>
+struct TimeGridPool
 {
-	static void split(Storage<SpaceBox, 8> &tree, NvU32 newParentIndex)
+	static const NvU32 N_SLOTS = N;
+	static const NvU32 INVALID_GRID = 0xffffffffU;
+
+	// returns a grid with all slots zeroed
+	NvU32 allocateGrid()
 	{
-		NvU32 children = tree.allocateNElems();
-		auto& parent = tree.getElem(newParentIndex);
-		parent.m_children = children;
-		for (NvU32 u = 0; u < 8; ++u)
+		NvU32 grid;
+		if (!m_freeGrids.empty())
 		{
-			auto& child = tree.getElem(children + u);
-			child.m_parent = newParentIndex;
-			child.m_pTimeBoxes = parent.m_pTimeBoxes;
-			child.m_timeRoot = cloneTimeElems(parent.m_timeRoot, 1);
+			grid = m_freeGrids.back();
+			m_freeGrids.pop_back();
 		}
+		else
+		{
+			grid = getNGrids();
+			m_ampX.resize((size_t)(grid + 1) * N, 0.);
+			m_ampY.resize((size_t)(grid + 1) * N, 0.);
+			m_weights.resize((size_t)(grid + 1) * N, 0.);
+		}
+		return grid;
+	}
+	// zeroes the grid, so rotate() can go over free grids without changing anything
+	void freeGrid(NvU32 grid)
+	{
+		size_t u = (size_t)grid * N;
+		std::fill(&m_ampX[u], &m_ampX[u] + N, 0.);
+		std::fill(&m_ampY[u], &m_ampY[u] + N, 0.);
+		std::fill(&m_weights[u], &m_weights[u] + N, 0.);
+		m_freeGrids.push_back(grid);
 	}
+	NvU32 getNGrids() const { return (NvU32)(m_ampX.size() / N); }
+	NvU32 getNUsedGrids() const { return getNGrids() - (NvU32)m_freeGrids.size(); }
 
-private:
-	NvU32 cloneTimeElems(NvU32 uStart, NvU32 nElems)
+	TimeBox getBox(NvU32 grid, NvU32 uSlot) const
+	{
+		nvAssert(uSlot < N);
+		size_t u = (size_t)grid * N + uSlot;
+		TimeBox box;
+		box.m_posAmpSum = makedouble2(m_ampX[u], m_ampY[u]);
+		box.m_weightsSum = m_weights[u];
+		return box;
+	}
+	void addToBox(NvU32 grid, NvU32 uSlot, const double2& posAmp, double fWeight)
+	{
+		nvAssert(uSlot < N);
+		size_t u = (size_t)grid * N + uSlot;
+		m_ampX[u] += posAmp.x;
+		m_ampY[u] += posAmp.y;
+		m_weights[u] += fWeight;
+	}
+
+	// split: children start with what the parent had
+	void copyGrid(NvU32 dstGrid, NvU32 srcGrid)
+	{
+		size_t uDst = (size_t)dstGrid * N, uSrc = (size_t)srcGrid * N;
+		std::copy(&m_ampX[uSrc], &m_ampX[uSrc] + N, &m_ampX[uDst]);
+		std::copy(&m_ampY[uSrc], &m_ampY[uSrc] + N, &m_ampY[uDst]);
+		std::copy(&m_weights[uSrc], &m_weights[uSrc] + N, &m_weights[uDst]);
+	}
+	// merge: the parent gets the average of its children - the same as GridElem::merge() does with timePhase
+	void averageGrids(NvU32 dstGrid, const NvU32* pSrcGrids, NvU32 nSrcGrids)
 	{
-		NvU32 newStart = m_pTimeBoxes->allocateNElems();
-		for (NvU32 u = 0; u < nElems; ++u)
+		double fScale = 1. / nSrcGrids;
+		size_t uDst = (size_t)dstGrid * N;
+		for (NvU32 uSlot = 0; uSlot < N; ++uSlot)
 		{
-			if (newTimeElm.m_children != ~0)
+			double fX = 0, fY = 0, fWeight = 0;
+			for (NvU32 uSrc = 0; uSrc < nSrcGrids; ++uSrc)
 			{
-				newTimeElem.m_children = cloneTimeElems(newTimeElem.m_children, 2);
+				size_t u = (size_t)pSrcGrids[uSrc] * N + uSlot;
+				fX += m_ampX[u];
+				fY += m_ampY[u];
+				fWeight += m_weights[u];
 			}
+			m_ampX[uDst + uSlot] = fX * fScale;
+			m_ampY[uDst + uSlot] = fY * fScale;
+			m_weights[uDst + uSlot] = fWeight * fScale;
 		}
 	}
-	std::shared_ptr<TimeGrid> m_pTimeGrid;
-	NvU32 m_children = ~0, m_parent = ~0;
-};
 
+	// standing wave advances by fAngle: every amplitude of every grid is multiplied by (cos(fAngle), sin(fAngle))
+	void rotate(double fAngle, SimdLevel simdLevel = getMaxSimdLevel())
+	{
+		if (m_ampX.empty())
+			return;
+		ComplexRotation rotate = { &m_ampX[0], &m_ampY[0], cos(fAngle), sin(fAngle) };
+		simdFor(simdLevel, m_ampX.size(), rotate);
+	}
+
+private:
+	AlignedVector<double> m_ampX, m_ampY, m_weights;
+	std::vector<NvU32> m_freeGrids;
+};
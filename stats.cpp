@@ -0,0 +1,118 @@
+#include <mutex>
+#include <vector>
+#include "stats.h"
+
+void WaveCounters::add(const WaveCounters& other)
+{
+	m_nEntered += other.m_nEntered;
+	m_nLeft += other.m_nLeft;
+	m_nTouchTests += other.m_nTouchTests;
+	m_nTouchRejections += other.m_nTouchRejections;
+	m_nSplits += other.m_nSplits;
+	m_nMerges += other.m_nMerges;
+	m_nAllocations += other.m_nAllocations;
+	m_nFrees += other.m_nFrees;
+}
+
+void WaveCounters::subtract(const WaveCounters& other)
+{
+	m_nEntered -= other.m_nEntered;
+	m_nLeft -= other.m_nLeft;
+	m_nTouchTests -= other.m_nTouchTests;
+	m_nTouchRejections -= other.m_nTouchRejections;
+	m_nSplits -= other.m_nSplits;
+	m_nMerges -= other.m_nMerges;
+	m_nAllocations -= other.m_nAllocations;
+	m_nFrees -= other.m_nFrees;
+}
+
+#if WAVE_STATS
+static WaveCounters loadCounters(const ThreadCounters& counters)
+{
+	WaveCounters result;
+	result.m_nEntered = counters.m_nEntered.load(std::memory_order_relaxed);
+	result.m_nLeft = counters.m_nLeft.load(std::memory_order_relaxed);
+	result.m_nTouchTests = counters.m_nTouchTests.load(std::memory_order_relaxed);
+	result.m_nTouchRejections = counters.m_nTouchRejections.load(std::memory_order_relaxed);
+	result.m_nSplits = counters.m_nSplits.load(std::memory_order_relaxed);
+	result.m_nMerges = counters.m_nMerges.load(std::memory_order_relaxed);
+	result.m_nAllocations = counters.m_nAllocations.load(std::memory_order_relaxed);
+	result.m_nFrees = counters.m_nFrees.load(std::memory_order_relaxed);
+	return result;
+}
+
+// counters of live threads are registered here, counters of finished threads are added to s_finishedCounters
+static std::mutex s_countersMutex;
+static std::vector<ThreadCounters*> s_pThreadCounters;
+static WaveCounters s_finishedCounters;
+
+struct ThreadCountersSlot
+{
+	ThreadCountersSlot()
+	{
+		std::lock_guard<std::mutex> lock(s_countersMutex);
+		s_pThreadCounters.push_back(&m_counters);
+	}
+	~ThreadCountersSlot()
+	{
+		t_pThreadCounters = nullptr;
+		std::lock_guard<std::mutex> lock(s_countersMutex);
+		s_finishedCounters.add(loadCounters(m_counters));
+		for (size_t u = 0; u < s_pThreadCounters.size(); ++u)
+		{
+			if (s_pThreadCounters[u] == &m_counters)
+			{
+				s_pThreadCounters[u] = s_pThreadCounters.back();
+				s_pThreadCounters.pop_back();
+				break;
+			}
+		}
+	}
+	ThreadCounters m_counters;
+};
+
+thread_local ThreadCounters* t_pThreadCounters = nullptr;
+
+ThreadCounters& registerThreadCounters()
+{
+	// destroyed when the thread exits
+	thread_local ThreadCountersSlot slot;
+	t_pThreadCounters = &slot.m_counters;
+	return slot.m_counters;
+}
+
+WaveCounters sumCounters()
+{
+	std::lock_guard<std::mutex> lock(s_countersMutex);
+	WaveCounters sum = s_finishedCounters;
+	for (const ThreadCounters* pCounters : s_pThreadCounters)
+	{
+		sum.add(loadCounters(*pCounters));
+	}
+	return sum;
+}
+#endif
+
+const char* getTimerName(WaveTimer timer)
+{
+	static const char* pNames[TIMER_COUNT] = { "initialize", "readPoints", "step", "adapt", "interactions", "farField", "leafInfluence", "pathSampling", "timeGrids" };
+	return pNames[timer];
+}
+
+void WorldStats::writeJson(FILE* pFile) const
+{
+	fprintf(pFile, "{\"step\": %llu, \"leaves\": %u, \"usedChildren\": %u, \"freeGroups\": %u", (unsigned long long)m_stepIndex,
+		m_nLeaves, m_nUsedChildren, m_nFreeGroups);
+	fprintf(pFile, ", \"entered\": %llu, \"left\": %llu, \"touchTests\": %llu, \"touchRejections\": %llu",
+		(unsigned long long)m_counters.m_nEntered, (unsigned long long)m_counters.m_nLeft,
+		(unsigned long long)m_counters.m_nTouchTests, (unsigned long long)m_counters.m_nTouchRejections);
+	fprintf(pFile, ", \"splits\": %llu, \"merges\": %llu, \"allocations\": %llu, \"frees\": %llu",
+		(unsigned long long)m_counters.m_nSplits, (unsigned long long)m_counters.m_nMerges,
+		(unsigned long long)m_counters.m_nAllocations, (unsigned long long)m_counters.m_nFrees);
+	fprintf(pFile, ", \"ms\": {");
+	for (NvU32 u = 0; u < TIMER_COUNT; ++u)
+	{
+		fprintf(pFile, "%s\"%s\": %.4f", u == 0 ? "" : ", ", getTimerName((WaveTimer)u), m_fMs[u]);
+	}
+	fprintf(pFile, "}}\n");
+}
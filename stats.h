@@ -0,0 +1,104 @@
+#pragma once
+
+#include <stdio.h>
+#include <chrono>
+#include <atomic>
+#include "MyMisc.h"
+
+// instrumentation of hot paths. build with WAVE_STATS=0 and counting and timing compile to nothing
+#ifndef WAVE_STATS
+#define WAVE_STATS 1
+#endif
+
+// event counters. every thread counts into its own copy, so hot loops don't fight over cache lines. counters are
+// per process - with several World objects the counts of all of them add up
+struct WaveCounters
+{
+	NvU64 m_nEntered = 0, m_nLeft = 0; // visitor callbacks of Storage::visit()
+	NvU64 m_nTouchTests = 0, m_nTouchRejections = 0; // doTouch() calls and the ones that returned false
+	NvU64 m_nSplits = 0, m_nMerges = 0;
+	NvU64 m_nAllocations = 0, m_nFrees = 0; // groups of 8 children
+
+	void add(const WaveCounters& other);
+	void subtract(const WaveCounters& other);
+};
+
+#if WAVE_STATS
+// counters of one thread. only the owning thread writes them, but sumCounters() reads them from any thread while
+// they are being counted, so they are atomics. increments are a relaxed load and store - the same plain add as
+// with NvU64, without the locked instruction a fetch_add would be
+struct ThreadCounters
+{
+	std::atomic<NvU64> m_nEntered{ 0 }, m_nLeft{ 0 };
+	std::atomic<NvU64> m_nTouchTests{ 0 }, m_nTouchRejections{ 0 };
+	std::atomic<NvU64> m_nSplits{ 0 }, m_nMerges{ 0 };
+	std::atomic<NvU64> m_nAllocations{ 0 }, m_nFrees{ 0 };
+};
+inline void countEvent(std::atomic<NvU64>& counter, NvU64 n)
+{
+	counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+// pointer is trivially initialized, so the hot path is a thread-local load and a null check
+extern thread_local ThreadCounters* t_pThreadCounters;
+ThreadCounters& registerThreadCounters();
+inline ThreadCounters& getThreadCounters()
+{
+	ThreadCounters* pCounters = t_pThreadCounters;
+	return pCounters ? *pCounters : registerThreadCounters();
+}
+// sum over all threads that ever counted, including finished ones. counts of threads that are counting at the moment
+// may be a few events behind
+WaveCounters sumCounters();
+#define WAVE_COUNT(counter, n) countEvent(getThreadCounters().counter, (n))
+#else
+#define WAVE_COUNT(counter, n) ((void)0)
+#endif
+
+enum WaveTimer
+{
+	TIMER_INITIALIZE,
+	TIMER_READ_POINTS, // readPoints() and updatePoints()
+	TIMER_STEP, // the whole makeSimulationStep(), includes the phases below
+	TIMER_ADAPT,
+	TIMER_INTERACTIONS, // rebuilding interaction lists
+	TIMER_FAR_FIELD,
+	TIMER_LEAF_INFLUENCE,
+	TIMER_PATH_SAMPLING,
+	TIMER_TIME_GRIDS, // accumulating and rotating time grids
+	TIMER_COUNT
+};
+const char* getTimerName(WaveTimer timer);
+
+// what happened between the end of one makeSimulationStep() and the end of the next one
+struct WorldStats
+{
+	NvU64 m_stepIndex = 0;
+	WaveCounters m_counters;
+	double m_fMs[TIMER_COUNT] = { };
+	// state at the end of the step
+	NvU32 m_nLeaves = 0, m_nUsedChildren = 0, m_nFreeGroups = 0;
+
+	// one line of JSON, so a file of steps can be read line by line
+	void writeJson(FILE* pFile) const;
+};
+
+// adds time of its scope to fMs
+struct ScopedStatsTimer
+{
+	ScopedStatsTimer(double& fMs) : m_fMs(fMs), m_start(std::chrono::high_resolution_clock::now()) { }
+	~ScopedStatsTimer()
+	{
+		m_fMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - m_start).count();
+	}
+private:
+	double& m_fMs;
+	std::chrono::high_resolution_clock::time_point m_start;
+};
+
+#if WAVE_STATS
+#define WAVE_TIME_SCOPE_NAME2(line) statsTimer##line
+#define WAVE_TIME_SCOPE_NAME(line) WAVE_TIME_SCOPE_NAME2(line)
+#define WAVE_TIME_SCOPE(stats, timer) ScopedStatsTimer WAVE_TIME_SCOPE_NAME(__LINE__)((stats).m_fMs[timer])
+#else
+#define WAVE_TIME_SCOPE(stats, timer) ((void)0)
+#endif
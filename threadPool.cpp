@@ -0,0 +1,125 @@
+#include <stdio.h>
+#include "threadPool.h"
+#include "trace.h"
+
+// which pool the current thread works for and which queue is its own
+static thread_local const ThreadPool* s_pCurrentPool = nullptr;
+static thread_local NvU32 s_uCurrentQueue = 0;
+
+ThreadPool::ThreadPool(NvU32 nThreads)
+{
+	nThreads = mymax(nThreads, 1U);
+	for (NvU32 u = 0; u < nThreads; ++u)
+	{
+		m_queues.push_back(std::make_unique<Queue>());
+	}
+	for (NvU32 u = 1; u < nThreads; ++u)
+	{
+		m_threads.emplace_back(&ThreadPool::workerLoop, this, u);
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+		m_shouldExit = true;
+	}
+	m_wakeUp.notify_all();
+	for (auto& thread : m_threads)
+	{
+		thread.join();
+	}
+}
+
+NvU32 ThreadPool::getOwnQueue() const
+{
+	return s_pCurrentPool == this ? s_uCurrentQueue : 0;
+}
+
+void ThreadPool::submit(TaskGroup& group, std::function<void()> task)
+{
+	Queue& queue = *m_queues[getOwnQueue()];
+	++group.m_nUnfinished;
+	{
+		// counted before it becomes visible, so the counter never goes below the real number of queued tasks
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+		++m_nQueued;
+	}
+	{
+		std::lock_guard<std::mutex> lock(queue.m_mutex);
+		queue.m_tasks.push_back({ std::move(task), &group });
+	}
+	m_wakeUp.notify_one();
+}
+
+bool ThreadPool::tryRunOne(NvU32 uOwnQueue)
+{
+	Task task;
+	for (NvU32 u = 0, nQueues = (NvU32)m_queues.size(); u < nQueues && !task.m_func; ++u)
+	{
+		NvU32 uQueue = (uOwnQueue + u) % nQueues;
+		Queue& queue = *m_queues[uQueue];
+		std::lock_guard<std::mutex> lock(queue.m_mutex);
+		if (queue.m_tasks.empty())
+			continue;
+		if (uQueue == uOwnQueue)
+		{
+			task = std::move(queue.m_tasks.back());
+			queue.m_tasks.pop_back();
+		}
+		else
+		{
+			task = std::move(queue.m_tasks.front());
+			queue.m_tasks.pop_front();
+		}
+	}
+	if (!task.m_func)
+		return false;
+	--m_nQueued;
+	{
+		WAVE_TRACE_SCOPE("task");
+		task.m_func();
+	}
+	// release: whoever sees the group finished also sees what the task wrote
+	task.m_pGroup->m_nUnfinished.fetch_sub(1, std::memory_order_release);
+	return true;
+}
+
+void ThreadPool::workerLoop(NvU32 uOwnQueue)
+{
+	s_pCurrentPool = this;
+	s_uCurrentQueue = uOwnQueue;
+	char sName[32];
+	snprintf(sName, sizeof(sName), "worker %u", uOwnQueue);
+	setTraceThreadName(sName);
+	for ( ; ; )
+	{
+		if (tryRunOne(uOwnQueue))
+			continue;
+		std::unique_lock<std::mutex> lock(m_sleepMutex);
+		m_wakeUp.wait(lock, [this]() { return m_shouldExit || m_nQueued > 0; });
+		if (m_shouldExit)
+			break;
+	}
+}
+
+void ThreadPool::wait(TaskGroup& group)
+{
+	// a worker waiting from inside of a task keeps its own queue, a thread from outside takes queue 0
+	const ThreadPool* pPrevPool = s_pCurrentPool;
+	NvU32 uPrevQueue = s_uCurrentQueue;
+	NvU32 uOwnQueue = getOwnQueue();
+	s_pCurrentPool = this;
+	s_uCurrentQueue = uOwnQueue;
+	WAVE_TRACE_SCOPE("wait");
+	while (group.m_nUnfinished.load(std::memory_order_acquire) > 0)
+	{
+		if (!tryRunOne(uOwnQueue))
+		{
+			std::this_thread::yield();
+		}
+	}
+	s_pCurrentPool = pPrevPool;
+	s_uCurrentQueue = uPrevQueue;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include "MyMisc.h"
+
+// work-stealing pool: every thread has its own queue. a thread takes newest tasks from its own queue (they are
+// likely to be hot in cache) and when it runs out of work - steals oldest tasks from other queues (those tend
+// to be the biggest). every task belongs to a TaskGroup, and wait() only waits for its own group, running
+// any tasks meanwhile. so a task may submit more tasks into a group of its own and wait for them - it keeps working
+// on its queue instead of blocking. the thread calling wait() from outside is a member of the pool too
+struct TaskGroup
+{
+	std::atomic<NvU32> m_nUnfinished{ 0 };
+};
+
+struct ThreadPool
+{
+	explicit ThreadPool(NvU32 nThreads);
+	~ThreadPool();
+	NvU32 getNThreads() const { return (NvU32)m_queues.size(); }
+
+	void submit(TaskGroup& group, std::function<void()> task);
+	// runs tasks on the calling thread until all tasks of the group are done
+	void wait(TaskGroup& group);
+
+private:
+	struct Task
+	{
+		std::function<void()> m_func;
+		TaskGroup* m_pGroup;
+	};
+	struct Queue
+	{
+		std::mutex m_mutex;
+		std::deque<Task> m_tasks;
+	};
+	bool tryRunOne(NvU32 uOwnQueue);
+	void workerLoop(NvU32 uOwnQueue);
+	NvU32 getOwnQueue() const;
+
+	std::vector<std::unique_ptr<Queue>> m_queues; // queue 0 belongs to threads calling wait() from outside
+	std::vector<std::thread> m_threads;
+	std::atomic<NvU32> m_nQueued{ 0 };
+	std::atomic<bool> m_shouldExit{ false };
+	std::mutex m_sleepMutex;
+	std::condition_variable m_wakeUp;
+};
+
+// runs func(u) for every u in [0, n) - on the pool if there is one, otherwise on the calling thread. may be called
+// from inside of a task
+template <class F>
+void parallelFor(ThreadPool* pPool, NvU32 n, const F& func)
+{
+	if (!pPool || pPool->getNThreads() == 1)
+	{
+		for (NvU32 u = 0; u < n; ++u)
+		{
+			func(u);
+		}
+		return;
+	}
+	TaskGroup group;
+	for (NvU32 u = 0; u < n; ++u)
+	{
+		pPool->submit(group, [&func, u]() { func(u); });
+	}
+	pPool->wait(group);
+}
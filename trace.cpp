@@ -0,0 +1,118 @@
+#define _CRT_SECURE_NO_WARNINGS // fopen() is fine here
+#include <stdio.h>
+#include <string.h>
+#include <mutex>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include "trace.h"
+
+std::atomic<bool> g_isTraceEnabled{ false };
+
+struct TraceBuffer
+{
+	std::vector<TraceEvent> m_events; // size is a power of 2
+	NvU64 m_nWritten = 0;
+	NvU32 m_tid = 0;
+	char m_sThreadName[32] = { };
+};
+
+// buffers outlive their threads, so events of finished workers are still exported
+static std::mutex s_traceMutex;
+static std::vector<std::unique_ptr<TraceBuffer>> s_pBuffers;
+static NvU32 s_nEventsPerThread = 1 << 16;
+static NvU64 s_startNs = getTraceNs();
+static thread_local TraceBuffer* t_pBuffer = nullptr;
+static thread_local char t_sThreadName[32] = { };
+
+void setTraceEnabled(bool isEnabled, NvU32 nEventsPerThread)
+{
+	nvAssert((nEventsPerThread & (nEventsPerThread - 1)) == 0 && nEventsPerThread > 0);
+	std::lock_guard<std::mutex> lock(s_traceMutex);
+	s_nEventsPerThread = nEventsPerThread;
+	g_isTraceEnabled = isEnabled;
+}
+
+void setTraceThreadName(const char* sName)
+{
+	strncpy(t_sThreadName, sName, sizeof(t_sThreadName) - 1);
+	if (t_pBuffer)
+	{
+		std::lock_guard<std::mutex> lock(s_traceMutex);
+		memcpy(t_pBuffer->m_sThreadName, t_sThreadName, sizeof(t_sThreadName));
+	}
+}
+
+static TraceBuffer* allocateBuffer()
+{
+	std::lock_guard<std::mutex> lock(s_traceMutex);
+	s_pBuffers.push_back(std::make_unique<TraceBuffer>());
+	TraceBuffer* pBuffer = s_pBuffers.back().get();
+	pBuffer->m_events.resize(s_nEventsPerThread);
+	pBuffer->m_tid = (NvU32)s_pBuffers.size();
+	memcpy(pBuffer->m_sThreadName, t_sThreadName, sizeof(t_sThreadName));
+	return pBuffer;
+}
+
+void recordTraceEvent(const char* sName, NvU64 startNs, NvU64 endNs)
+{
+	TraceBuffer* pBuffer = t_pBuffer;
+	if (!pBuffer)
+	{
+		t_pBuffer = pBuffer = allocateBuffer();
+	}
+	TraceEvent& event = pBuffer->m_events[pBuffer->m_nWritten++ & (pBuffer->m_events.size() - 1)];
+	event.m_sName = sName;
+	event.m_startNs = startNs;
+	event.m_durationNs = endNs - startNs;
+}
+
+bool writeChromeTrace(const char* sPath)
+{
+	std::lock_guard<std::mutex> lock(s_traceMutex);
+	FILE* pFile = fopen(sPath, "w");
+	if (!pFile)
+		return false;
+	fprintf(pFile, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+	const char* sSeparator = "";
+	for (const auto& pBuffer : s_pBuffers)
+	{
+		if (pBuffer->m_sThreadName[0])
+		{
+			fprintf(pFile, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %u, \"args\": {\"name\": \"%s\"}}", sSeparator,
+				pBuffer->m_tid, pBuffer->m_sThreadName);
+			sSeparator = ",\n";
+		}
+		// complete events ("X") carry their own duration, so losing the oldest ones to the ring never unbalances scopes
+		NvU64 nEvents = std::min<NvU64>(pBuffer->m_nWritten, pBuffer->m_events.size());
+		for (NvU64 u = pBuffer->m_nWritten - nEvents; u < pBuffer->m_nWritten; ++u)
+		{
+			const TraceEvent& event = pBuffer->m_events[u & (pBuffer->m_events.size() - 1)];
+			fprintf(pFile, "%s{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %u, \"ts\": %.3f, \"dur\": %.3f}", sSeparator,
+				event.m_sName, pBuffer->m_tid, (event.m_startNs - s_startNs) / 1000., event.m_durationNs / 1000.);
+			sSeparator = ",\n";
+		}
+	}
+	fprintf(pFile, "\n]}\n");
+	return fclose(pFile) == 0;
+}
+
+NvU64 getNTraceEvents()
+{
+	std::lock_guard<std::mutex> lock(s_traceMutex);
+	NvU64 nEvents = 0;
+	for (const auto& pBuffer : s_pBuffers)
+	{
+		nEvents += pBuffer->m_nWritten;
+	}
+	return nEvents;
+}
+
+void clearTrace()
+{
+	std::lock_guard<std::mutex> lock(s_traceMutex);
+	for (const auto& pBuffer : s_pBuffers)
+	{
+		pBuffer->m_nWritten = 0;
+	}
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include "MyMisc.h"
+
+// timeline of scopes for chrome://tracing or Perfetto. every thread writes into its own ring buffer, so recording
+// takes no locks - when a buffer is full the oldest events are overwritten. build with WAVE_TRACE=0 and scopes
+// compile to nothing. with tracing disabled at run time a scope costs one relaxed load
+#ifndef WAVE_TRACE
+#define WAVE_TRACE 1
+#endif
+
+// one scope. m_sName must be a string literal - only the pointer is kept
+struct TraceEvent
+{
+	const char* m_sName;
+	NvU64 m_startNs, m_durationNs;
+};
+
+extern std::atomic<bool> g_isTraceEnabled;
+inline bool isTraceEnabled() { return g_isTraceEnabled.load(std::memory_order_relaxed); }
+// buffers are allocated on the first event of each thread, events recorded earlier are dropped
+void setTraceEnabled(bool isEnabled, NvU32 nEventsPerThread = 1 << 16);
+// name shown for the calling thread. sName is copied
+void setTraceThreadName(const char* sName);
+// events of all threads, including finished ones. must not be called while other threads record
+bool writeChromeTrace(const char* sPath);
+void clearTrace();
+// events recorded since the last clearTrace(), including the ones already overwritten
+NvU64 getNTraceEvents();
+
+inline NvU64 getTraceNs()
+{
+	return (NvU64)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+void recordTraceEvent(const char* sName, NvU64 startNs, NvU64 endNs);
+
+struct ScopedTraceEvent
+{
+	ScopedTraceEvent(const char* sName) : m_sName(sName), m_startNs(isTraceEnabled() ? getTraceNs() : 0) { }
+	~ScopedTraceEvent()
+	{
+		if (m_startNs != 0 && isTraceEnabled())
+		{
+			recordTraceEvent(m_sName, m_startNs, getTraceNs());
+		}
+	}
+private:
+	const char* m_sName;
+	NvU64 m_startNs;
+};
+
+#if WAVE_TRACE
+#define WAVE_TRACE_SCOPE_NAME2(line) traceScope##line
+#define WAVE_TRACE_SCOPE_NAME(line) WAVE_TRACE_SCOPE_NAME2(line)
+#define WAVE_TRACE_SCOPE(sName) ScopedTraceEvent WAVE_TRACE_SCOPE_NAME(__LINE__)(sName)
+#else
+#define WAVE_TRACE_SCOPE(sName) ((void)0)
+#endif
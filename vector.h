@@ -2,6 +2,9 @@
 #include <cmath>
 #include "MyMisc.h"
 
+// default tolerance of isnear()
+const float VECTOR_EPSILON = 1e-6f;
+
 #ifdef max
 #undef max
 #endif
@@ -37,8 +40,10 @@ struct rtvector
 	VECTOR_MEMBERS(T, n)
 };
 
+#ifdef _MSC_VER
 #pragma warning(push)
 #pragma warning(disable: 4201)	// Nameless struct/union
+#endif
 
 template <typename T>
 struct rtvector<T, 2>
@@ -81,7 +86,9 @@ struct rtvector<T, 4>
 	VECTOR_MEMBERS(T, 4)
 };
 
+#ifdef _MSC_VER
 #pragma warning(pop)
+#endif
 #undef VECTOR_MEMBERS
 
 // Generic maker functions
@@ -108,7 +115,7 @@ template <typename T, int n, typename U, int n_from>
 rtvector<T, n> makevector(rtvector<U, n_from> const& a)
 {
 	auto result = makevector<T, n>(T(0));
-	for (int i = 0; i < min(n, n_from); ++i)
+	for (int i = 0; i < mymin(n, n_from); ++i)
 		result[i] = T(a[i]);
 	return result;
 }
@@ -325,7 +332,7 @@ rtvector<T, n> pow(rtvector<T, n> const& a, float p)
 }
 
 template <typename T, int n>
-rtvector<bool, n> isnear(rtvector<T, n> const& a, rtvector<T, n> const& b, float epsilon = util::epsilon)
+rtvector<bool, n> isnear(rtvector<T, n> const& a, rtvector<T, n> const& b, float epsilon = VECTOR_EPSILON)
 {
 	rtvector<bool, n> result;
 	for (int i = 0; i < n; ++i)
@@ -334,7 +341,7 @@ rtvector<bool, n> isnear(rtvector<T, n> const& a, rtvector<T, n> const& b, float
 }
 
 template <typename T, int n>
-rtvector<bool, n> isnear(rtvector<T, n> const& a, T b, float epsilon = util::epsilon)
+rtvector<bool, n> isnear(rtvector<T, n> const& a, T b, float epsilon = VECTOR_EPSILON)
 {
 	rtvector<bool, n> result;
 	for (int i = 0; i < n; ++i)
@@ -343,7 +350,7 @@ rtvector<bool, n> isnear(rtvector<T, n> const& a, T b, float epsilon = util::eps
 }
 
 template <typename T, int n>
-rtvector<bool, n> isnear(T a, rtvector<T, n> const& b, float epsilon = util::epsilon)
+rtvector<bool, n> isnear(T a, rtvector<T, n> const& b, float epsilon = VECTOR_EPSILON)
 {
 	rtvector<bool, n> result;
 	for (int i = 0; i < n; ++i)
@@ -474,7 +481,7 @@ T minComponent(rtvector<T, n> const& a)
 {
 	T result = a[0];
 	for (int i = 1; i < n; ++i)
-		result = min(result, a[i]);
+		result = mymin(result, a[i]);
 	return result;
 }
 
@@ -483,6 +490,6 @@ T maxComponent(rtvector<T, n> const& a)
 {
 	T result = a[0];
 	for (int i = 1; i < n; ++i)
-		result = max(result, a[i]);
+		result = mymax(result, a[i]);
 	return result;
 }
@@ -1,74 +1,6 @@
 #include "wave.h"
 #include "Power2Distribution.h"
 
-static double s_fQConst = 1;
-static double s_fMConst = 1;
-
-void generatePathTime(const float3 &fromP, const float3 &toP, double f01Number, double &fPathAction, double &fPathTime, double &fPathWeight)
-{
-	float3 d = toP - fromP;
-	// in general case action at each point p is computed as:
-	// fAction(p) = fKineticConstant * sqr(fSpeed(p)) - fPotential(p);
-	//
-	// for simplicity we assume that speed is constant between two points. potential is not
-	// though because then force would be zero (force is derivative of potential), so:
-	// fAction(p) = fKineticConstant * sqr(fSpeed) - fPotential(p)
-	//
-	// if T is the time it takes for electron to fly between the two points, then path action
-	// would be equal to:
-	// fPathAction(T) = ntgrl_t_0_T(fKineticConstant * sqr(fSpeed) - fPotential(p))
-	//
-	// let's introduce those variables:
-	double dd = dot(d, d);
-	double dp = dot(d, fromP);
-	double pp = dot(fromP, fromP);
-	// We use matlab to compute all of the above integrals symbolically:
-	// syms px py pz dx dy dz t T
-	// rx = px + dx * (t/T)
-	// ry = py + dy * (t/T)
-	// rz = pz + dz * (t/T)
-	// collect(expand(rx^2+ry^2+rz^2),t) = (dd / T^2) * t^2 + (2 * dp / T) * t + pp
-	//
-	// syms t dd dp pp fQConst T fMConst
-	// rr = (dd / T^2) * t^2 + (2 * dp / T) * t + pp
-	//
-	// potential energy: V = fQConst / sqrt(rr)
-	// intV = int(V,t)
-	// pathV = subs(intV,t,T) - subs(intV,t,0)
-	// pathV = T * fQConst * log((dd + dp + sqrt(dd * (dd + 2 * dp + pp)))/(dp + sqrt(dd*pp)))/sqrt(dd)
-	// Few things to notice about pathV:
-	// * it is proportional to T, so it changes from 0 to inf as T grows
-	// * it must be > 0 because we're integrating positive function: fQConst / sqrt(rr)
-	//
-	// kinetic energy: P = fMConst * dd / T^2
-	// intP = int(P,t)
-	// pathP = subs(intP,t,T) - subs(intP,t,0)
-	// pathP = dd * fMConst / T
-	// Few things to note about pathP:
-	// * it is proportional to 1 / T, so it changes from inf to 0 as T grows
-	// * it must be > 0
-	//
-	// pathA = pathP - pathV
-	double Thelper = s_fQConst * log((dd + dp + sqrt(dd * (dd + 2 * dp + pp))) / (dp + sqrt(dd * pp)));
-	nvAssert(Thelper >= 0);
-	// pathA = (dd * fMConst)/T - T * Thelper/ dd^(1/2)
-	// syms dd fMConst T Thelper
-	// due to properties of pathP and pathV, there must be a point T0 where pathA = 0
-	// we find that point T0 and then we generate random T sample around that point. that
-	// sample will represent path between two points
-	//
-	// pathAeq = pathA == 0
-	double fT0 = sqrt(Thelper * dd * sqrt(dd) * s_fMConst) / Thelper;
-
-	double fTMin = fT0 / 2, fTMax = fT0 * 2;
-	fPathWeight = 1;
-	while (f01Number >= 0.5)
-	{
-		f01Number = (f01Number - 0.5) * 2;
-		fPathWeight *= 2;
-	}
-}
-
 static inline void copyDim(float3Box& dstBox, const float3Box& srcBox, NvU32 uDim)
 {
 	dstBox[0][uDim] = srcBox[0][uDim];
@@ -80,14 +12,14 @@ static inline void combineDim(float3Box& dstBox, const float3Box& smallBox, cons
 	dstBox[1][uDim] = box[1][uDim];
 }
 
-void GridElem::split(const World &world, Storage &storage, const float3Box &_box)
+void GridElem::split(const World &, Storage &storage, const float3Box &_box)
 {
 	float3Box box = _box;
 	float3Box smallBox(box[0], (box[0] + box[1]) / 2.f), tmpBox;
 
 	m_firstChildIndex = storage.allocate8Children();
+	WAVE_COUNT(m_nSplits, 1);
 
-	auto boxCenter = (box[0] + box[1]) / 2.f;
 	copyDim(tmpBox, smallBox, 2);
 	for (NvU32 z = 0, childIndex = m_firstChildIndex, myIndex = isRoot() ? storage.getRootIndex(*this) : storage.getChildIndex(*this); z < 2; ++z)
 	{
@@ -104,6 +36,34 @@ void GridElem::split(const World &world, Storage &storage, const float3Box &_box
 		}
 		combineDim(tmpBox, smallBox, box, 2);
 	}
+	storage.updateSoA(m_firstChildIndex, 8);
+	if (!isRoot())
+	{
+		storage.updateSoA(storage.getChildIndex(*this), 1);
+	}
+	storage.splitTimeGrid(*this);
+	storage.markChanged(storage.getElemSlot(*this), 1);
+}
+
+void GridElem::merge(const World&, Storage& storage)
+{
+	float2 timePhase = makefloat2(0.f);
+	for (NvU32 uChild = 0; uChild < 8; ++uChild)
+	{
+		const GridElem& child = storage[m_firstChildIndex + uChild];
+		nvAssert(!child.hasChildren());
+		timePhase += child.getTimePhase();
+	}
+	m_timePhase = timePhase / 8.f;
+	storage.mergeTimeGrids(*this);
+	storage.free8Children(m_firstChildIndex);
+	WAVE_COUNT(m_nMerges, 1);
+	m_firstChildIndex = INVALID_CHILD_INDEX;
+	if (!isRoot())
+	{
+		storage.updateSoA(storage.getChildIndex(*this), 1);
+	}
+	storage.markChanged(storage.getElemSlot(*this), 1);
 }
 
 NvU32 GridElem::computeRootIndex(const Storage& storage) const
@@ -118,11 +78,18 @@ NvU32 Storage::allocateRoot(const float2& timePhase, const float3Box& box)
 	m_pRoots.resize(rootIndex + 1);
 	m_pRootBoxes.push_back(box);
 	m_pRoots[rootIndex].initAsRoot(timePhase, (box[0] + box[1]) / 2.f);
+	m_areAllChanged = true; // slots of all children have moved
+	++m_topologyVersion;
+	if (m_useTimeGrids)
+	{
+		m_rootTimeGrids.push_back(m_timeGrids.allocateGrid());
+	}
 	return rootIndex;
 }
 
 NvU32 Storage::allocate8Children()
 {
+	++m_topologyVersion;
 	if (m_firstFreeChild >= m_pChildren.size())
 	{
 		m_firstFreeChild = m_pChildren.size();
@@ -131,6 +98,10 @@ NvU32 Storage::allocate8Children()
 		{
 			m_pChildren[u].setFirstChild(u + 8);
 		}
+		if (m_useTimeGrids)
+		{
+			m_childTimeGrids.resize(m_pChildren.size(), (NvU32)LeafTimeGrids::INVALID_GRID);
+		}
 	}
 	NvU32 firstElemIndex = m_firstFreeChild;
 	auto *pFirstElem = &m_pChildren[m_firstFreeChild];
@@ -140,11 +111,101 @@ NvU32 Storage::allocate8Children()
 	{
 		pFirstElem[u] = GridElem();
 	}
+	m_nUsedChildren += 8;
+	WAVE_COUNT(m_nAllocations, 1);
+	markChanged(getNRoots() + firstElemIndex, 8);
 	return firstElemIndex;
 }
 
+void Storage::free8Children(NvU32 firstChildIndex)
+{
+	++m_topologyVersion;
+	nvAssert(firstChildIndex % 8 == 0 && m_nUsedChildren >= 8);
+	for (NvU32 u = 0; u < 8; ++u)
+	{
+		m_pChildren[firstChildIndex + u] = GridElem();
+	}
+	// list is threaded through the first element of each group - same as in allocate8Children()
+	m_pChildren[firstChildIndex].setFirstChild(m_firstFreeChild);
+	m_firstFreeChild = firstChildIndex;
+	m_nUsedChildren -= 8;
+	WAVE_COUNT(m_nFrees, 1);
+	markChanged(getNRoots() + firstChildIndex, 8);
+}
+
+void Storage::markChanged(NvU32 firstSlot, NvU32 nSlots)
+{
+	if (!m_trackChanges || m_areAllChanged)
+		return;
+	for (NvU32 u = firstSlot; u < firstSlot + nSlots; ++u)
+	{
+		m_changedSlots.push_back(u);
+	}
+}
+
+bool Storage::takeChanges(std::vector<NvU32>& slots)
+{
+	slots.swap(m_changedSlots);
+	m_changedSlots.clear();
+	bool areAllChanged = m_areAllChanged;
+	m_areAllChanged = false;
+	return areAllChanged;
+}
+
+float3Box Storage::computeBox(const GridElem& elem) const
+{
+	if (elem.isRoot())
+		return m_pRootBoxes[getRootIndex(elem)];
+	const GridElem& parent = elem.isChildOfRoot() ? m_pRoots[elem.getParentIndex()] : m_pChildren[elem.getParentIndex()];
+	return computeChildBox(computeBox(parent), getChildIndex(elem) - parent.getFirstChild());
+}
+
+void Storage::setLayout(GridLayout layout)
+{
+	m_layout = layout;
+	m_soa.clear();
+	updateSoA(0, m_pChildren.size());
+}
+
+void Storage::setTimePhase(GridElem& elem, const float2& timePhase)
+{
+	elem.setTimePhase(timePhase);
+	if (m_layout == GRID_LAYOUT_SOA && !elem.isRoot())
+	{
+		NvU32 childIndex = getChildIndex(elem);
+		m_soa.m_phaseX[childIndex] = timePhase.x;
+		m_soa.m_phaseY[childIndex] = timePhase.y;
+	}
+	markChanged(getElemSlot(elem), 1);
+}
+
+void Storage::updateSoA(NvU32 firstChildIndex, NvU32 n)
+{
+	if (m_layout != GRID_LAYOUT_SOA)
+		return;
+	NvU32 oldSize = m_soa.size();
+	if (oldSize < m_pChildren.size())
+	{
+		// children added since the last update have to be copied too
+		m_soa.resize(m_pChildren.size());
+		updateSoA(oldSize, m_pChildren.size() - oldSize);
+	}
+	for (NvU32 u = firstChildIndex; u < firstChildIndex + n; ++u)
+	{
+		const GridElem& elem = m_pChildren[u];
+		m_soa.m_centerX[u] = elem.getCenter().x;
+		m_soa.m_centerY[u] = elem.getCenter().y;
+		m_soa.m_centerZ[u] = elem.getCenter().z;
+		m_soa.m_phaseX[u] = elem.getTimePhase().x;
+		m_soa.m_phaseY[u] = elem.getTimePhase().y;
+		m_soa.m_firstChild[u] = elem.hasChildren() ? elem.getFirstChild() : (NvU32)GridSoA::INVALID_CHILD_INDEX;
+		m_soa.m_parent[u] = elem.getParentIndex() | (elem.isChildOfRoot() ? (NvU32)GridSoA::CHILD_OF_ROOT_BIT : 0);
+	}
+}
+
 void Storage::visitInternal(GridElem* pElem, const float3Box& box, IVisitor& visitor)
 {
+	WAVE_COUNT(m_nEntered, 1);
 	if (!visitor.notifyEntering(*pElem, box))
 		return;
 
@@ -171,14 +232,160 @@ void Storage::visitInternal(GridElem* pElem, const float3Box& box, IVisitor& vis
 		}
 	}
 
+	WAVE_COUNT(m_nLeft, 1);
 	visitor.notifyLeaving(*pElem, box);
 }
 
-struct SplitVisitor : public Storage::IVisitor
+void Storage::collectSubtrees(NvU32 rootIndex, NvU32 depth, std::vector<Subtree>& subtrees)
+{
+	collectSubtreesInternal(m_pRoots[rootIndex], m_pRootBoxes[rootIndex], depth, subtrees);
+}
+
+void Storage::collectSubtreesInternal(GridElem& elem, const float3Box& box, NvU32 depth, std::vector<Subtree>& subtrees)
+{
+	if (depth == 0 || !elem.hasChildren())
+	{
+		subtrees.push_back({ &elem, box });
+		return;
+	}
+	for (NvU32 uChild = 0, firstChildIndex = elem.getFirstChild(); uChild < 8; ++uChild)
+	{
+		collectSubtreesInternal(m_pChildren[firstChildIndex + uChild], computeChildBox(box, uChild), depth - 1, subtrees);
+	}
+}
+
+void Storage::compact()
+{
+	BlockArray<GridElem> children;
+	children.setUseHugePages(m_pChildren.getUseHugePages());
+	children.reserve(m_nUsedChildren);
+	std::vector<NvU32> childTimeGrids;
+	for (NvU32 rootIndex = 0; rootIndex < m_pRoots.size(); ++rootIndex)
+	{
+		compactInternal(m_pRoots[rootIndex], rootIndex, children, childTimeGrids);
+	}
+	nvAssert(children.size() == m_nUsedChildren);
+	m_pChildren = std::move(children);
+	m_childTimeGrids = std::move(childTimeGrids);
+	m_firstFreeChild = ~0;
+	++m_topologyVersion;
+	m_areAllChanged = true;
+	setLayout(m_layout);
+}
+
+// elem is already in its final place. its children are appended to the new array and then the same is done for
+// every one of them, so the groups end up in depth-first order
+void Storage::compactInternal(GridElem& elem, NvU32 elemIndex, BlockArray<GridElem>& children, std::vector<NvU32>& childTimeGrids)
+{
+	if (!elem.hasChildren())
+		return;
+	NvU32 oldFirstChild = elem.m_firstChildIndex, newFirstChild = children.size();
+	children.resize(newFirstChild + 8);
+	for (NvU32 uChild = 0; uChild < 8; ++uChild)
+	{
+		GridElem& child = children[newFirstChild + uChild];
+		child = m_pChildren[oldFirstChild + uChild];
+		child.m_parentIndex = elemIndex; // for children of roots the root index doesn't change
+		if (m_useTimeGrids)
+		{
+			childTimeGrids.push_back(m_childTimeGrids[oldFirstChild + uChild]);
+		}
+	}
+	elem.m_firstChildIndex = newFirstChild;
+	for (NvU32 uChild = 0; uChild < 8; ++uChild)
+	{
+		compactInternal(children[newFirstChild + uChild], newFirstChild + uChild, children, childTimeGrids);
+	}
+}
+
+void Storage::setUseTimeGrids(bool useTimeGrids)
+{
+	m_useTimeGrids = useTimeGrids;
+	m_timeGrids = LeafTimeGrids();
+	m_rootTimeGrids.assign(useTimeGrids ? getNRoots() : 0, (NvU32)LeafTimeGrids::INVALID_GRID);
+	m_childTimeGrids.assign(useTimeGrids ? getNChildren() : 0, (NvU32)LeafTimeGrids::INVALID_GRID);
+	if (!useTimeGrids)
+		return;
+	struct AllocateGrids : public InlineVisitor
+	{
+		AllocateGrids(Storage& storage) : m_storage(storage) { }
+		bool notifyEntering(GridElem& elem, const float3Box&)
+		{
+			if (!elem.hasChildren())
+			{
+				m_storage.accessTimeGrid(elem) = m_storage.m_timeGrids.allocateGrid();
+			}
+			return true;
+		}
+		Storage& m_storage;
+	};
+	AllocateGrids allocateGrids(*this);
+	for (NvU32 rootIndex = 0; rootIndex < getNRoots(); ++rootIndex)
+	{
+		visit(rootIndex, allocateGrids);
+	}
+}
+
+void Storage::splitTimeGrid(const GridElem& elem)
+{
+	if (!m_useTimeGrids)
+		return;
+	NvU32& grid = accessTimeGrid(elem);
+	for (NvU32 uChild = 0, firstChildIndex = elem.getFirstChild(); uChild < 8; ++uChild)
+	{
+		NvU32 childGrid = m_timeGrids.allocateGrid();
+		m_timeGrids.copyGrid(childGrid, grid);
+		m_childTimeGrids[firstChildIndex + uChild] = childGrid;
+	}
+	m_timeGrids.freeGrid(grid);
+	grid = LeafTimeGrids::INVALID_GRID;
+}
+
+void Storage::mergeTimeGrids(const GridElem& elem)
+{
+	if (!m_useTimeGrids)
+		return;
+	NvU32 firstChildIndex = elem.getFirstChild();
+	NvU32* pChildGrids = &m_childTimeGrids[firstChildIndex];
+	NvU32 grid = m_timeGrids.allocateGrid();
+	m_timeGrids.averageGrids(grid, pChildGrids, 8);
+	for (NvU32 uChild = 0; uChild < 8; ++uChild)
+	{
+		m_timeGrids.freeGrid(pChildGrids[uChild]);
+		pChildGrids[uChild] = LeafTimeGrids::INVALID_GRID;
+	}
+	accessTimeGrid(elem) = grid;
+}
+
+float Storage::computeFragmentation() const
+{
+	NvU32 prevFirstChild = (NvU32)-8, nGroups = 0, nJumps = 0;
+	for (const GridElem& root : m_pRoots)
+	{
+		countJumps(root, prevFirstChild, nGroups, nJumps);
+	}
+	return nGroups == 0 ? 0.f : (float)nJumps / nGroups;
+}
+
+void Storage::countJumps(const GridElem& elem, NvU32& prevFirstChild, NvU32& nGroups, NvU32& nJumps) const
+{
+	if (!elem.hasChildren())
+		return;
+	NvU32 firstChild = elem.getFirstChild();
+	nJumps += firstChild != prevFirstChild + 8 ? 1 : 0;
+	++nGroups;
+	prevFirstChild = firstChild;
+	for (NvU32 uChild = 0; uChild < 8; ++uChild)
+	{
+		countJumps(m_pChildren[firstChild + uChild], prevFirstChild, nGroups, nJumps);
+	}
+}
+
+struct SplitVisitor : public Storage::InlineVisitor
 {
 	SplitVisitor(World &world, Storage &storage, NvU32 depth) : m_world(world), m_storage(storage), m_depth(depth) { }
 
-	virtual bool notifyEntering(GridElem& elem, const float3Box& box)
+	bool notifyEntering(GridElem& elem, const float3Box& box)
 	{
 		if (m_depth == 0)
 			return false;
@@ -186,94 +393,794 @@ struct SplitVisitor : public Storage::IVisitor
 		--m_depth;
 		return true;
 	}
-	virtual void notifyLeaving(GridElem& elem, const float3Box& box)
+	void notifyLeaving(GridElem&, const float3Box&)
 	{
 		++m_depth;
 	}
 
 private:
-	NvU32 m_depth;
 	World& m_world;
 	Storage& m_storage;
+	NvU32 m_depth;
+};
+
+// finds leaves to split and parents to merge without changing anything, so different roots can be looked at by
+// different threads - allocation of children is not thread-safe, World::adapt() applies the changes afterwards.
+// decisions are the same as if splits were done on the way down and merges on the way up: new children only have
+// a copy of the parent's timePhase, so they are not looked at until the next pass, and a parent whose children are
+// all going to be merged sees them as leaves with their average timePhase
+struct AdaptVisitor : public Storage::InlineVisitor
+{
+	AdaptVisitor(const AdaptParams& params) : m_params(params) { }
+
+	bool notifyEntering(GridElem& elem, const float3Box& box)
+	{
+		if (!elem.hasChildren() && m_depth < m_params.m_maxDepth &&
+			length(elem.getTimePhase()) * (box[1].x - box[0].x) > m_params.m_fRefineError)
+		{
+			m_splits.push_back({ &elem, box });
+			addToParent(false, makefloat2(0.f));
+			return false;
+		}
+		if (elem.hasChildren())
+		{
+			m_levels[m_depth] = Level();
+		}
+		++m_depth;
+		return true;
+	}
+	void notifyLeaving(GridElem& elem, const float3Box& box)
+	{
+		--m_depth;
+		if (!elem.hasChildren())
+		{
+			addToParent(true, elem.getTimePhase());
+			return;
+		}
+		// |average| <= max, so the merged leaf won't be split again on the next pass
+		const Level& level = m_levels[m_depth];
+		if (level.m_canMerge && sqrtf(level.m_fMaxAmplitude2) * (box[1].x - box[0].x) < m_params.m_fCoarsenError)
+		{
+			m_merges.push_back(&elem);
+			addToParent(true, level.m_timePhaseSum / 8.f);
+			return;
+		}
+		addToParent(false, makefloat2(0.f));
+	}
+	std::vector<Storage::Subtree> m_splits;
+	std::vector<GridElem*> m_merges; // children go before parents
+
+private:
+	// children of the element at that depth seen so far
+	struct Level
+	{
+		bool m_canMerge = true;
+		float m_fMaxAmplitude2 = 0; // squared
+		float2 m_timePhaseSum = makefloat2(0.f);
+	};
+	void addToParent(bool isLeaf, const float2& timePhase)
+	{
+		if (m_depth == 0)
+			return;
+		Level& parent = m_levels[m_depth - 1];
+		parent.m_canMerge = parent.m_canMerge && isLeaf;
+		if (!parent.m_canMerge)
+			return;
+		parent.m_fMaxAmplitude2 = mymax(parent.m_fMaxAmplitude2, dot(timePhase, timePhase));
+		parent.m_timePhaseSum += timePhase;
+	}
+
+	const AdaptParams& m_params;
+	NvU32 m_depth = 0;
+	Level m_levels[Storage::MAX_DEPTH];
 };
 
-void World::initialize()
+void World::reset(StorageBackend backend)
 {
+	m_backend = backend;
 	m_storage = Storage();
-	NvU32 rootIndex = m_storage.allocateRoot(makefloat2(-1.f, 1.f), float3Box(makefloat3(-1.f), makefloat3(1.f)));
+	m_storage.setLayout(m_layout);
+	m_storage.setUseTimeGrids(m_useTimeGrids);
+	m_linearStorage = LinearStorage();
+	m_interactions = InteractionLists();
+	m_stepIndex = 0;
+	m_stats = WorldStats();
+#if WAVE_STATS
+	m_prevCounters = sumCounters();
+#endif
+}
 
-	SplitVisitor splitVisitor(*this, m_storage, 3);
-	m_storage.visit(0, splitVisitor);
+void World::initialize(NvU32 depth, StorageBackend backend, NvU32 nRootsPerDim)
+{
+	nvAssert(nRootsPerDim > 0 && (nRootsPerDim == 1 || backend == STORAGE_POINTER));
+	reset(backend);
+	WAVE_TIME_SCOPE(m_stats, TIMER_INITIALIZE);
+	WAVE_TRACE_SCOPE("initialize");
+	float2 timePhase = makefloat2(-1.f, 1.f);
+	float3Box rootBox(makefloat3(-1.f), makefloat3(1.f));
+	if (m_backend == STORAGE_LINEAR)
+	{
+		m_linearStorage.allocateRoot(timePhase, rootBox);
+		for (NvU32 u = 0; u < depth; ++u)
+		{
+			m_linearStorage.refine(0, [](const GridElem&, const float3Box&) { return true; });
+		}
+		return;
+	}
+	// neighboring roots compute their common face the same way, so their boxes touch exactly. codes that are
+	// outside of the tiling are skipped when nRootsPerDim isn't a power of 2
+	float fRootWidth = 2.f / nRootsPerDim;
+	for (NvU32 code = 0, nRoots = nRootsPerDim * nRootsPerDim * nRootsPerDim; m_storage.getNRoots() < nRoots; ++code)
+	{
+		NvU32 coords[3] = { };
+		for (NvU32 uBit = 0; uBit < 30; ++uBit)
+		{
+			coords[uBit % 3] |= ((code >> uBit) & 1) << (uBit / 3);
+		}
+		if (coords[0] >= nRootsPerDim || coords[1] >= nRootsPerDim || coords[2] >= nRootsPerDim)
+			continue;
+		for (NvU32 uDim = 0; uDim < 3; ++uDim)
+		{
+			rootBox[0][uDim] = -1.f + coords[uDim] * fRootWidth;
+			rootBox[1][uDim] = coords[uDim] + 1 == nRootsPerDim ? 1.f : -1.f + (coords[uDim] + 1) * fRootWidth;
+		}
+		m_storage.allocateRoot(timePhase, rootBox);
+	}
+	NvU32 nChildren = 0;
+	for (NvU32 u = 0, nLevelChildren = 8; u < depth; ++u, nLevelChildren *= 8)
+	{
+		nChildren += nLevelChildren;
+	}
+	m_storage.reserveChildren(nChildren * (getEndOwnedRoot() - mymin(m_firstOwnedRoot, getEndOwnedRoot())));
+
+	for (NvU32 rootIndex = m_firstOwnedRoot; rootIndex < getEndOwnedRoot(); ++rootIndex)
+	{
+		SplitVisitor splitVisitor(*this, m_storage, depth);
+		m_storage.visit(rootIndex, splitVisitor);
+	}
 }
 
 void World::readPoints(std::vector<float3>& points)
 {
-	struct CollectPoints : public Storage::IVisitor
+	WAVE_TIME_SCOPE(m_stats, TIMER_READ_POINTS);
+	WAVE_TRACE_SCOPE("readPoints");
+	readLeaves(points, nullptr);
+}
+
+void World::readLeaves(std::vector<float3>& points, std::vector<float2>* pTimePhases)
+{
+	struct CollectPoints : public Storage::InlineVisitor
 	{
-		CollectPoints(std::vector<float3>& points) : m_points(points) { }
-		virtual bool notifyEntering(GridElem& elem, const float3Box& box)
+		CollectPoints(std::vector<float3>& points, std::vector<float2>* pTimePhases) : m_points(points), m_pTimePhases(pTimePhases) { }
+		bool notifyEntering(GridElem& elem, const float3Box& box)
 		{
 			if (!elem.hasChildren())
 			{
-				for (NvU32 uDim = 0; uDim < 3; ++uDim)
+				m_points.resize(m_points.size() + 6);
+				getBoxLines(box, &m_points[m_points.size() - 6]);
+				if (m_pTimePhases)
 				{
-					m_points.push_back(box[0]);
-					float3 otherPoint = box[0];
-					otherPoint[uDim] = box[1][uDim];
-					m_points.push_back(otherPoint);
+					m_pTimePhases->push_back(elem.getTimePhase());
 				}
 			}
 			return true;
 		}
 		std::vector<float3>& m_points;
+		std::vector<float2>* m_pTimePhases;
 	};
-	CollectPoints visitor(points);
-	m_storage.visit(0, visitor);
+	CollectPoints visitor(points, pTimePhases);
+	if (m_backend == STORAGE_LINEAR)
+	{
+		m_linearStorage.visit(0, visitor);
+		return;
+	}
+	for (NvU32 rootIndex = 0; rootIndex < m_storage.getNRoots(); ++rootIndex)
+	{
+		m_storage.visit(rootIndex, visitor);
+	}
+}
+
+void World::updatePoints(std::vector<float3>& points, std::vector<PointRange>& changedRanges, std::vector<float2>* pTimePhases)
+{
+	changedRanges.clear();
+	if (m_backend == STORAGE_LINEAR)
+	{
+		// LinearStorage rewrites all leaves on every refinement anyway
+		WAVE_TIME_SCOPE(m_stats, TIMER_READ_POINTS);
+		WAVE_TRACE_SCOPE("readPoints");
+		points.clear();
+		if (pTimePhases)
+		{
+			pTimePhases->clear();
+		}
+		readLeaves(points, pTimePhases);
+		changedRanges.push_back({ 0, (NvU32)points.size() });
+		return;
+	}
+	WAVE_TIME_SCOPE(m_stats, TIMER_READ_POINTS);
+	WAVE_TRACE_SCOPE("readPoints");
+	if (!m_storage.isTrackingChanges())
+	{
+		m_storage.setTrackChanges(true);
+	}
+	NvU32 nRoots = m_storage.getNRoots(), nSlots = m_storage.getNElemSlots();
+	if (m_storage.takeChanges(m_changedSlots))
+	{
+		struct WriteLeaves : public Storage::InlineVisitor
+		{
+			WriteLeaves(const Storage& storage, std::vector<float3>& points, std::vector<float2>* pTimePhases) :
+				m_storage(storage), m_points(points), m_pTimePhases(pTimePhases) { }
+			bool notifyEntering(GridElem& elem, const float3Box& box)
+			{
+				if (!elem.hasChildren())
+				{
+					NvU32 slot = m_storage.getElemSlot(elem);
+					getBoxLines(box, &m_points[6 * slot]);
+					if (m_pTimePhases)
+					{
+						(*m_pTimePhases)[slot] = elem.getTimePhase();
+					}
+				}
+				return true;
+			}
+			const Storage& m_storage;
+			std::vector<float3>& m_points;
+			std::vector<float2>* m_pTimePhases;
+		};
+		points.assign(6 * nSlots, makefloat3(0.f));
+		if (pTimePhases)
+		{
+			pTimePhases->assign(nSlots, makefloat2(0.f));
+		}
+		WriteLeaves writeLeaves(m_storage, points, pTimePhases);
+		for (NvU32 rootIndex = 0; rootIndex < nRoots; ++rootIndex)
+		{
+			m_storage.visit(rootIndex, writeLeaves);
+		}
+		changedRanges.push_back({ 0, (NvU32)points.size() });
+		return;
+	}
+	// new slots are free elements until they show up in the list of changes
+	points.resize(6 * nSlots, makefloat3(0.f));
+	if (pTimePhases)
+	{
+		pTimePhases->resize(nSlots, makefloat2(0.f));
+	}
+	std::sort(m_changedSlots.begin(), m_changedSlots.end());
+	m_changedSlots.erase(std::unique(m_changedSlots.begin(), m_changedSlots.end()), m_changedSlots.end());
+	for (NvU32 slot : m_changedSlots)
+	{
+		const GridElem& elem = slot < nRoots ? m_storage.accessRoot(slot) : m_storage[slot - nRoots];
+		float3* pPoints = &points[6 * slot];
+		// free children look like roots
+		bool isLeaf = !elem.hasChildren() && !(slot >= nRoots && elem.isRoot());
+		if (isLeaf)
+		{
+			getBoxLines(m_storage.computeBox(elem), pPoints);
+		}
+		else
+		{
+			std::fill(pPoints, pPoints + 6, makefloat3(0.f));
+		}
+		if (pTimePhases)
+		{
+			(*pTimePhases)[slot] = isLeaf ? elem.getTimePhase() : makefloat2(0.f);
+		}
+		if (!changedRanges.empty() && changedRanges.back().m_firstPoint + changedRanges.back().m_nPoints == 6 * slot)
+		{
+			changedRanges.back().m_nPoints += 6;
+			continue;
+		}
+		changedRanges.push_back({ 6 * slot, 6 });
+	}
+}
+
+void World::setStorageLayout(GridLayout layout)
+{
+	m_layout = layout;
+	m_storage.setLayout(layout);
+}
+
+void World::setTimeGrids(bool useTimeGrids, double fAnglePerStep)
+{
+	m_useTimeGrids = useTimeGrids;
+	m_fTimeGridAngle = fAnglePerStep;
+	if (m_storage.getUseTimeGrids() != useTimeGrids)
+	{
+		m_storage.setUseTimeGrids(useTimeGrids);
+	}
+}
+
+void World::setOwnedRoots(NvU32 firstRoot, NvU32 endRoot)
+{
+	nvAssert(firstRoot <= endRoot);
+	m_firstOwnedRoot = firstRoot;
+	m_endOwnedRoot = endRoot;
+	m_farField.setReceivingRoots(firstRoot, endRoot);
+}
+
+void World::getOwnedSlots(NvU32& firstSlot, NvU32& endSlot) const
+{
+	if (m_backend == STORAGE_LINEAR)
+	{
+		firstSlot = 0;
+		endSlot = m_interactions.getNLeaves();
+		return;
+	}
+	NvU32 endRoot = getEndOwnedRoot();
+	firstSlot = m_interactions.getRootFirstSlot(mymin(m_firstOwnedRoot, endRoot));
+	endSlot = m_interactions.getRootFirstSlot(endRoot);
+}
+
+void World::setAdaptParams(const AdaptParams& params)
+{
+	nvAssert(params.m_fCoarsenError < params.m_fRefineError || params.m_fRefineError == 0);
+	nvAssert(params.m_maxDepth < Storage::MAX_DEPTH);
+	m_adaptParams = params;
+}
+
+NvU32 World::adapt()
+{
+	nvAssert(m_backend == STORAGE_POINTER);
+	NvU32 firstRoot = m_firstOwnedRoot, nRoots = getEndOwnedRoot() - mymin(m_firstOwnedRoot, getEndOwnedRoot());
+	std::vector<AdaptVisitor> adaptVisitors(nRoots, AdaptVisitor(m_adaptParams));
+	parallelFor(m_pThreadPool.get(), nRoots, [&](NvU32 u)
+	{
+		m_storage.visit(firstRoot + u, adaptVisitors[u]);
+	});
+	// children of split leaves come from the free list, so merges go last - they only free children of the merged
+	// elements and can't invalidate anything recorded
+	NvU32 nChanges = 0;
+	for (AdaptVisitor& adaptVisitor : adaptVisitors)
+	{
+		for (const Storage::Subtree& split : adaptVisitor.m_splits)
+		{
+			split.m_pElem->split(*this, m_storage, split.m_box);
+		}
+		nChanges += (NvU32)adaptVisitor.m_splits.size();
+	}
+	for (AdaptVisitor& adaptVisitor : adaptVisitors)
+	{
+		for (GridElem* pElem : adaptVisitor.m_merges)
+		{
+			pElem->merge(*this, m_storage);
+		}
+		nChanges += (NvU32)adaptVisitor.m_merges.size();
+	}
+	if (nChanges > 0 && m_adaptParams.m_fMaxFragmentation > 0 &&
+		m_storage.computeFragmentation() > m_adaptParams.m_fMaxFragmentation)
+	{
+		m_storage.compact();
+	}
+	return nChanges;
+}
+
+void World::setNThreads(NvU32 nThreads)
+{
+	m_pThreadPool.reset(nThreads > 1 ? new ThreadPool(nThreads) : nullptr);
 }
 
 void World::makeSimulationStep()
 {
-	struct SimVisitor2 : public Storage::IVisitor
+	++m_stepIndex;
+	{
+		WAVE_TIME_SCOPE(m_stats, TIMER_STEP);
+		WAVE_TRACE_SCOPE("step");
+		simulateStep();
+	}
+	finishStepStats();
+}
+
+void World::simulateStep()
+{
+	if (m_backend == STORAGE_LINEAR)
+	{
+		if (!m_interactions.isValid(m_linearStorage, 0))
+		{
+			WAVE_TIME_SCOPE(m_stats, TIMER_INTERACTIONS);
+			WAVE_TRACE_SCOPE("interactions");
+			m_interactions.build(m_linearStorage, 0);
+			clearLeafArrays();
+		}
+		{
+			WAVE_TIME_SCOPE(m_stats, TIMER_LEAF_INFLUENCE);
+			WAVE_TRACE_SCOPE("leafInfluence");
+			computeLeafInfluence(m_linearStorage, nullptr);
+		}
+		{
+			WAVE_TIME_SCOPE(m_stats, TIMER_PATH_SAMPLING);
+			WAVE_TRACE_SCOPE("pathSampling");
+			samplePaths(m_linearStorage);
+		}
+		return;
+	}
+	if (m_adaptParams.m_fRefineError > 0)
+	{
+		WAVE_TIME_SCOPE(m_stats, TIMER_ADAPT);
+		WAVE_TRACE_SCOPE("adapt");
+		adapt();
+	}
+	if (!m_interactions.isValid(m_storage, Storage::ALL_ROOTS))
+	{
+		WAVE_TIME_SCOPE(m_stats, TIMER_INTERACTIONS);
+		WAVE_TRACE_SCOPE("interactions");
+		m_interactions.build(m_storage, Storage::ALL_ROOTS, m_pThreadPool.get());
+		clearLeafArrays();
+	}
+	{
+		WAVE_TIME_SCOPE(m_stats, TIMER_FAR_FIELD);
+		WAVE_TRACE_SCOPE("farField");
+		m_farField.compute(m_storage, Storage::ALL_ROOTS, m_pThreadPool.get());
+	}
+	{
+		WAVE_TIME_SCOPE(m_stats, TIMER_LEAF_INFLUENCE);
+		WAVE_TRACE_SCOPE("leafInfluence");
+		if (m_storage.getLayout() == GRID_LAYOUT_SOA)
+		{
+			computeLeafInfluence(m_storage.getSoA(), &m_farField);
+		}
+		else
+		{
+			computeLeafInfluence(m_storage, &m_farField);
+		}
+	}
+	{
+		WAVE_TIME_SCOPE(m_stats, TIMER_PATH_SAMPLING);
+		WAVE_TRACE_SCOPE("pathSampling");
+		if (m_storage.getLayout() == GRID_LAYOUT_SOA)
+		{
+			samplePaths(m_storage.getSoA());
+		}
+		else
+		{
+			samplePaths(m_storage);
+		}
+	}
+	if (m_storage.getUseTimeGrids())
+	{
+		WAVE_TIME_SCOPE(m_stats, TIMER_TIME_GRIDS);
+		WAVE_TRACE_SCOPE("timeGrids");
+		updateTimeGrids();
+	}
+}
+
+void World::updateTimeGrids()
+{
+	// influence of this step goes to its slot, then everything rotates - slots written earlier have rotated more
+	LeafTimeGrids& timeGrids = m_storage.accessTimeGrids();
+	NvU32 uTimeSlot = (NvU32)(m_stepIndex % N_TIME_SLOTS);
+	NvU32 firstSlot, endSlot;
+	getOwnedSlots(firstSlot, endSlot);
+	for (NvU32 uSlot = firstSlot; uSlot < endSlot; ++uSlot)
+	{
+		NvU32 leafIndex = m_interactions.getLeafIndex(uSlot);
+		NvU32 timeGrid = InteractionLists::isRootLeaf(leafIndex) ? m_storage.getRootTimeGrid(InteractionLists::getRootOfLeaf(leafIndex)) :
+			m_storage.getChildTimeGrid(leafIndex);
+		timeGrids.addToBox(timeGrid, uTimeSlot, m_leafInfluence[uSlot], 1.);
+	}
+	timeGrids.rotate(m_fTimeGridAngle);
+}
+
+void World::finishStepStats()
+{
+	m_stats.m_stepIndex = m_stepIndex;
+	m_stats.m_nLeaves = m_interactions.getNLeaves();
+	if (m_backend == STORAGE_POINTER)
+	{
+		// every free element is on the free list
+		m_stats.m_nUsedChildren = m_storage.getNUsedChildren();
+		m_stats.m_nFreeGroups = (m_storage.getNChildren() - m_storage.getNUsedChildren()) / 8;
+	}
+#if WAVE_STATS
+	WaveCounters counters = sumCounters();
+	m_stats.m_counters = counters;
+	m_stats.m_counters.subtract(m_prevCounters);
+	m_prevCounters = counters;
+#endif
+	m_stepStats = m_stats;
+	m_stats = WorldStats();
+}
+
+void World::setPrecision(Precision precision)
+{
+	nvAssert(precision < PRECISION_COUNT);
+	if (precision != m_precision)
 	{
-		SimVisitor2(GridElem& elemOfInterest, const float3Box& boxOfInterest) : m_elemOfInterest(elemOfInterest), m_boxOfInterest(boxOfInterest) { }
-		virtual bool notifyEntering(GridElem& elem, const float3Box& box)
+		// cached 1 / distance was computed with the old precision
+		m_interactions.clearPairCache();
+	}
+	m_precision = precision;
+}
+
+template <class ELEMS>
+void World::computeLeafInfluence(const ELEMS& storage, const FarField* pFarField)
+{
+	switch (m_precision)
+	{
+	case PRECISION_FLOAT: computeLeafInfluenceAs<FloatPrecision>(storage, pFarField); break;
+	case PRECISION_DOUBLE: computeLeafInfluenceAs<DoublePrecision>(storage, pFarField); break;
+	default: computeLeafInfluenceAs<MixedPrecision>(storage, pFarField); break;
+	}
+}
+
+void World::clearLeafArrays()
+{
+	std::get<LeafArrays<MixedPrecision>>(m_leafArrays).clear();
+	std::get<LeafArrays<FloatPrecision>>(m_leafArrays).clear();
+	std::get<LeafArrays<DoublePrecision>>(m_leafArrays).clear();
+}
+
+template <class ELEMS>
+float3 World::getLeafCenter(const ELEMS& storage, NvU32 leafIndex) const
+{
+	if (InteractionLists::isRootLeaf(leafIndex))
+	{
+		return m_storage.accessRoot(InteractionLists::getRootOfLeaf(leafIndex)).getCenter();
+	}
+	return storage[leafIndex].getCenter();
+}
+template <class ELEMS>
+float2 World::getLeafTimePhase(const ELEMS& storage, NvU32 leafIndex) const
+{
+	if (InteractionLists::isRootLeaf(leafIndex))
+	{
+		return m_storage.accessRoot(InteractionLists::getRootOfLeaf(leafIndex)).getTimePhase();
+	}
+	return storage[leafIndex].getTimePhase();
+}
+
+// phases of leaves in slot order. the generic version goes through the accessors of the leaves
+template <class ELEMS, class A>
+static void copyTimePhases(const ELEMS& storage, const NvU32* pLeafIndices, NvU32 nSlots, A* pPhaseX, A* pPhaseY)
+{
+	for (NvU32 uSlot = 0; uSlot < nSlots; ++uSlot)
+	{
+		float2 timePhase = storage[pLeafIndices[uSlot]].getTimePhase();
+		pPhaseX[uSlot] = (A)timePhase.x;
+		pPhaseY[uSlot] = (A)timePhase.y;
+	}
+}
+// with SoA layout and double phases V::WIDTH of them are gathered from the arrays at once
+struct PhaseGatherKernel
+{
+	const GridSoA& m_soa;
+	const NvU32* m_pLeafIndices;
+	double* m_pPhaseX, * m_pPhaseY;
+	template <class V> void run(size_t u)
+	{
+		V::gatherFloat(m_soa.m_phaseX.data(), m_pLeafIndices + u).store(m_pPhaseX + u);
+		V::gatherFloat(m_soa.m_phaseY.data(), m_pLeafIndices + u).store(m_pPhaseY + u);
+	}
+};
+static void copyTimePhases(const GridSoA& soa, const NvU32* pLeafIndices, NvU32 nSlots, double* pPhaseX, double* pPhaseY)
+{
+	PhaseGatherKernel kernel = { soa, pLeafIndices, pPhaseX, pPhaseY };
+	simdFor(getMaxSimdLevel(), nSlots, kernel);
+}
+
+// 1 / distance from the leaf of uSlot to each of its neighbors. float geometry is done one neighbor at a time, so
+// each distance is rounded the way the policy says
+template <class A, class G>
+static void computeInvDistances(const LeafArrays<G>& leaves, NvU32 uSlot, const NvU32* pNeighbors, NvU32 nNeighbors, double* pOut)
+{
+	typedef typename LeafArrays<G>::GeomReal GeomReal;
+	for (NvU32 u = 0; u < nNeighbors; ++u)
+	{
+		NvU32 uNeighbor = pNeighbors[u];
+		rtvector<GeomReal, 3> d = { leaves.m_centerX[uSlot] - leaves.m_centerX[uNeighbor], leaves.m_centerY[uSlot] - leaves.m_centerY[uNeighbor],
+			leaves.m_centerZ[uSlot] - leaves.m_centerZ[uNeighbor] };
+		pOut[u] = (A)(1 / (A)length(d));
+	}
+}
+// double geometry: V::WIDTH neighbors at once
+struct InvDistanceKernel
+{
+	const LeafArrays<DoublePrecision>& m_leaves;
+	const NvU32* m_pNeighbors;
+	double* m_pOut;
+	double m_fX, m_fY, m_fZ;
+	template <class V> void run(size_t u)
+	{
+		V index = V::loadIndices(m_pNeighbors + u);
+		V dX = V(m_fX) - V::gather(m_leaves.m_centerX.data(), index);
+		V dY = V(m_fY) - V::gather(m_leaves.m_centerY.data(), index);
+		V dZ = V(m_fZ) - V::gather(m_leaves.m_centerZ.data(), index);
+		(V(1.) / sqrt(dX * dX + dY * dY + dZ * dZ)).store(m_pOut + u);
+	}
+};
+template <class A>
+static void computeInvDistances(const LeafArrays<DoublePrecision>& leaves, NvU32 uSlot, const NvU32* pNeighbors, NvU32 nNeighbors, double* pOut)
+{
+	InvDistanceKernel kernel = { leaves, pNeighbors, pOut, leaves.m_centerX[uSlot], leaves.m_centerY[uSlot], leaves.m_centerZ[uSlot] };
+	simdFor(getMaxSimdLevel(), nNeighbors, kernel);
+}
+
+// sum of phase * 1 / distance over the neighbors. float sums go one neighbor at a time
+static void sumNeighbors(const float* pPhaseX, const float* pPhaseY, const NvU32* pNeighbors, const double* pInvDistances,
+	NvU32 nNeighbors, float& fX, float& fY)
+{
+	for (NvU32 u = 0; u < nNeighbors; ++u)
+	{
+		fX += pPhaseX[pNeighbors[u]] * (float)pInvDistances[u];
+		fY += pPhaseY[pNeighbors[u]] * (float)pInvDistances[u];
+	}
+}
+// double sums: phases of V::WIDTH neighbors are gathered at once, every lane keeps its own partial sum and lanes
+// are added in order at the end - the result doesn't depend on whether distances came from the cache
+struct NeighborSumKernel
+{
+	const double* m_pPhaseX, * m_pPhaseY;
+	const NvU32* m_pNeighbors;
+	const double* m_pInvDistances;
+	double m_laneX[8], m_laneY[8];
+	template <class V> void run(size_t u)
+	{
+		V index = V::loadIndices(m_pNeighbors + u);
+		V fInvDistance = V::load(m_pInvDistances + u);
+		(V::load(m_laneX) + V::gather(m_pPhaseX, index) * fInvDistance).store(m_laneX);
+		(V::load(m_laneY) + V::gather(m_pPhaseY, index) * fInvDistance).store(m_laneY);
+	}
+};
+static void sumNeighbors(const double* pPhaseX, const double* pPhaseY, const NvU32* pNeighbors, const double* pInvDistances,
+	NvU32 nNeighbors, double& fX, double& fY)
+{
+	NeighborSumKernel kernel = { pPhaseX, pPhaseY, pNeighbors, pInvDistances, { }, { } };
+	simdFor(getMaxSimdLevel(), nNeighbors, kernel);
+	for (NvU32 uLane = 0; uLane < 8; ++uLane)
+	{
+		fX += kernel.m_laneX[uLane];
+		fY += kernel.m_laneY[uLane];
+	}
+}
+
+template <class PRECISION, class ELEMS>
+void World::computeLeafInfluenceAs(const ELEMS& storage, const FarField* pFarField)
+{
+	typedef typename PRECISION::AccumReal A;
+	LeafArrays<PRECISION>& leaves = std::get<LeafArrays<PRECISION>>(m_leafArrays);
+	// leaf slots go in depth-first order, so each range of slots is a group of neighboring subtrees. every leaf
+	// only writes its own slot, so ranges can be processed by different threads
+	NvU32 nLeaves = m_interactions.getNLeaves(), firstSlot, endSlot;
+	getOwnedSlots(firstSlot, endSlot);
+	NvU32 nRanges = getNThreads() * 16, nSlotsPerRange = NV_ALIGN_UP(nLeaves, nRanges) / nRanges;
+	// owned leaves read phases of all of them. centers are copied once after the lists were built
+	bool hasCenters = leaves.size() == nLeaves;
+	leaves.resize(nLeaves);
+	parallelFor(m_pThreadPool.get(), nRanges, [&](NvU32 uRange)
+	{
+		NvU32 uSlot = uRange * nSlotsPerRange, uSlotEnd = mymin(uSlot + nSlotsPerRange, nLeaves);
+		if (uSlot >= uSlotEnd)
+		{
+			return;
+		}
+		for (NvU32 u = uSlot; !hasCenters && u < uSlotEnd; ++u)
+		{
+			leaves.setCenter(u, getLeafCenter(storage, m_interactions.getLeafIndex(u)));
+		}
+		// root leaves aren't in storage, so the fast copy only works without them
+		if (m_interactions.getNRootLeaves() == 0)
+		{
+			copyTimePhases(storage, m_interactions.getLeafIndices() + uSlot, uSlotEnd - uSlot, leaves.m_phaseX.data() + uSlot, leaves.m_phaseY.data() + uSlot);
+			return;
+		}
+		for (NvU32 u = uSlot; u < uSlotEnd; ++u)
+		{
+			leaves.setTimePhase(u, getLeafTimePhase(storage, m_interactions.getLeafIndex(u)));
+		}
+	});
+	// the first step after the lists were built fills the cache, the following ones only read it
+	bool isPairCacheFilled = m_usePairCache && m_interactions.hasPairCache();
+	if (m_usePairCache && !isPairCacheFilled)
+	{
+		m_interactions.allocatePairCache();
+	}
+	nSlotsPerRange = NV_ALIGN_UP(endSlot - firstSlot, nRanges) / nRanges;
+	parallelFor(m_pThreadPool.get(), nRanges, [&](NvU32 uRange)
+	{
+		std::vector<double> invDistances;
+		for (NvU32 uSlot = firstSlot + uRange * nSlotsPerRange, uSlotEnd = mymin(uSlot + nSlotsPerRange, endSlot); uSlot < uSlotEnd; ++uSlot)
 		{
-			if (!doTouch(box, m_boxOfInterest))
+			NvU32 leafIndex = m_interactions.getLeafIndex(uSlot);
+			double2 farInfluence = makedouble2(0.);
+			if (pFarField)
 			{
-				return false;
+				farInfluence = InteractionLists::isRootLeaf(leafIndex) ? pFarField->getRootInfluence(InteractionLists::getRootOfLeaf(leafIndex)) :
+					pFarField->getInfluence(leafIndex);
 			}
-			if (elem.hasChildren())
+			rtvector<A, 2> influence = toReal2<A>(farInfluence);
+			const NvU32* pNeighbors = m_interactions.getNeighbors(uSlot);
+			NvU32 nNeighbors = m_interactions.getNNeighbors(uSlot);
+			const double* pInvDistances = nullptr;
+			if (isPairCacheFilled)
 			{
-				return true;
+				pInvDistances = m_interactions.getPairInvDistances(uSlot);
 			}
-			if (&elem == &m_elemOfInterest)
+			else
 			{
-				return false;
+				// without the cache distances go to a temporary, so both ways sum the same numbers the same way
+				double* pOut = nullptr;
+				if (m_usePairCache)
+				{
+					pOut = m_interactions.accessPairInvDistances(uSlot);
+				}
+				else
+				{
+					invDistances.resize(nNeighbors);
+					pOut = invDistances.data();
+				}
+				computeInvDistances<A>(leaves, uSlot, pNeighbors, nNeighbors, pOut);
+				pInvDistances = pOut;
 			}
-			// collect influence from elem to m_elemOfInterest
-			return false;
+			sumNeighbors(leaves.m_phaseX.data(), leaves.m_phaseY.data(), pNeighbors, pInvDistances, nNeighbors, influence.x, influence.y);
+			leaves.m_influenceX[uSlot] = influence.x;
+			leaves.m_influenceY[uSlot] = influence.y;
 		}
-        private:
-			GridElem& m_elemOfInterest;
-            const float3Box& m_boxOfInterest;
-	};
-	struct SimVisitor1 : public Storage::IVisitor
+	});
+	m_leafInfluence.resize(nLeaves);
+	std::fill(m_leafInfluence.begin(), m_leafInfluence.begin() + firstSlot, makedouble2(0.));
+	std::fill(m_leafInfluence.begin() + endSlot, m_leafInfluence.end(), makedouble2(0.));
+	for (NvU32 uSlot = firstSlot; uSlot < endSlot; ++uSlot)
+	{
+		m_leafInfluence[uSlot] = makedouble2((double)leaves.m_influenceX[uSlot], (double)leaves.m_influenceY[uSlot]);
+	}
+}
+
+template <class ELEMS>
+void World::samplePaths(const ELEMS& storage)
+{
+	NvU32 nSamples = m_nPathSamples, nLeaves = m_interactions.getNLeaves(), firstSlot, endSlot;
+	if (nSamples == 0)
+	{
+		m_leafPathSums.resize(0);
+		return;
+	}
+	getOwnedSlots(firstSlot, endSlot);
+	m_leafPathSums.assign(nLeaves, makedouble2(0.));
+	// as with 1 / distance: the first step after the lists were built fills the cache, the following ones only read it
+	bool isGeometryFilled = m_usePairCache && m_interactions.hasPathGeometries();
+	if (m_usePairCache && !isGeometryFilled)
+	{
+		m_interactions.allocatePathGeometries();
+	}
+	NvU32 nRanges = getNThreads() * 16, nSlotsPerRange = NV_ALIGN_UP(endSlot - firstSlot, nRanges) / nRanges;
+	parallelFor(m_pThreadPool.get(), nRanges, [&](NvU32 uRange)
 	{
-		SimVisitor1(Storage& storage) : m_storage(storage) { }
-		virtual bool notifyEntering(GridElem& elem, const float3Box& box)
+		std::vector<double> f01Numbers;
+		for (NvU32 uSlot = firstSlot + uRange * nSlotsPerRange, uSlotEnd = mymin(uSlot + nSlotsPerRange, endSlot); uSlot < uSlotEnd; ++uSlot)
 		{
-			if (elem.hasChildren())
+			NvU32 leafIndex = m_interactions.getLeafIndex(uSlot);
+			const NvU32* pNeighbors = m_interactions.getNeighbors(uSlot);
+			NvU32 nNeighbors = m_interactions.getNNeighbors(uSlot);
+			f01Numbers.resize(nNeighbors * nSamples);
+			m_pathRandom.generate01(m_stepIndex, leafIndex, 0, f01Numbers.data(), f01Numbers.size());
+			const PathGeometry* pCached = isGeometryFilled ? m_interactions.getPathGeometries(uSlot) : nullptr;
+			PathGeometry* pToFill = m_usePairCache && !isGeometryFilled ? m_interactions.accessPathGeometries(uSlot) : nullptr;
+			float3 vCenterOfInterest = getLeafCenter(storage, leafIndex);
+			double2 sum = makedouble2(0.);
+			for (NvU32 u = 0; u < nNeighbors; ++u)
 			{
-				return true;
+				NvU32 neighborIndex = m_interactions.getLeafIndex(pNeighbors[u]);
+				PathGeometry geometry = pCached ? pCached[u] : computePathGeometry(getLeafCenter(storage, neighborIndex), vCenterOfInterest);
+				if (pToFill)
+				{
+					pToFill[u] = geometry;
+				}
+				// straight path through the charge at the origin has infinite potential - there is no T0 to sample around
+				if (!std::isfinite(geometry.m_fT0))
+				{
+					continue;
+				}
+				float2 timePhase = getLeafTimePhase(storage, neighborIndex);
+				for (NvU32 uSample = 0; uSample < nSamples; ++uSample)
+				{
+					double fAction, fTime, fWeight;
+					generatePathTime(geometry, f01Numbers[u * nSamples + uSample], fAction, fTime, fWeight);
+					double fCos = cos(fAction), fSin = sin(fAction);
+					sum.x += fWeight * (timePhase.x * fCos - timePhase.y * fSin);
+					sum.y += fWeight * (timePhase.x * fSin + timePhase.y * fCos);
+				}
 			}
-			// find all the neighbors of that elem
-			SimVisitor2 visitor(elem, box);
-			m_storage.visit(0, visitor);
-			return false;
+			m_leafPathSums[uSlot] = sum / (double)nSamples;
 		}
-	private:
-		Storage& m_storage;
-	};
-	SimVisitor1 visitor(m_storage);
-	m_storage.visit(0, visitor);
-}
\ No newline at end of file
+	});
+}
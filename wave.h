@@ -1,7 +1,19 @@
 #pragma once
 
+#include <tuple>
+#include <type_traits>
 #include "box.h"
 #include "blockArray.h"
+#include "gridSoA.h"
+#include "interactionLists.h"
+#include "farField.h"
+#include "threadPool.h"
+#include "philox.h"
+#include "snapshot.h"
+#include "stats.h"
+#include "trace.h"
+#include "spaceTimeGrid.h"
+#include "precision.h"
 
 struct Storage;
 struct World;
@@ -11,6 +23,8 @@ struct GridElem
 	inline GridElem() : m_isChildOfRoot(0), m_parentIndex(INVALID_PARENT_INDEX) { }
 
 	void split(const World& world, Storage& storage, const float3Box &box);
+	// opposite of split(): all 8 children must be leaves. their average timePhase (and time grid) goes to this element
+	void merge(const World& world, Storage& storage);
 
 	bool isRoot() const { return m_parentIndex == INVALID_PARENT_INDEX; }
 	bool hasChildren() const { return m_firstChildIndex != INVALID_CHILD_INDEX; }
@@ -20,10 +34,16 @@ struct GridElem
 	NvU32 getParentIndex() const { return m_parentIndex; }
 	NvU32 computeRootIndex(const Storage& storage) const;
 	const float3& getCenter() const { return m_vCenter; }
+	const float2& getTimePhase() const { return m_timePhase; }
+	void setTimePhase(const float2& timePhase) { m_timePhase = timePhase; }
+	// for ghost leaves that stand for a whole subtree of another process - they sit where its amplitude is.
+	// with GRID_LAYOUT_SOA Storage::updateSoA() must be called after
+	void setCenter(const float3& vCenter) { m_vCenter = vCenter; }
 
 	void initAsRoot(const float2& timePhase, const float3& vCenter)	{ m_timePhase = timePhase; m_vCenter = vCenter;	}
 
 private:
+	friend struct Storage;
 	static const NvU32 INVALID_PARENT_INDEX = 0x7fffffffU;
 	static const NvU32 INVALID_CHILD_INDEX = 0xffffffffU;
 	void initAsChild(const float2& timePhase, const float3& vCenter, NvU32 isChildOfRoot, NvU32 parentIndex)
@@ -37,14 +57,106 @@ private:
 	NvU32 m_parentIndex : 31;
 };
 
+// time grids of leaves, see spaceTimeGrid.h
+static const NvU32 N_TIME_SLOTS = 8;
+typedef TimeGridPool<N_TIME_SLOTS> LeafTimeGrids;
+
+// how Storage keeps its children
+enum GridLayout
+{
+	GRID_LAYOUT_AOS, // only array of GridElem
+	GRID_LAYOUT_SOA, // GridElem array is kept for traversal, plus GridSoA which kernels read
+};
+
 struct Storage
 {
 	NvU32 allocateRoot(const float2& timePhase, const float3Box& box);
 	const GridElem& accessRoot(NvU32 u) const { return m_pRoots[u]; }
 	GridElem& accessRoot(NvU32 u) { return m_pRoots[u]; }
 	const float3Box& getRootBox(NvU32 u) const { return m_pRootBoxes[u]; }
+	NvU32 getNRoots() const { return (NvU32)m_pRoots.size(); }
+	// passed instead of root index to things that can work on the whole forest at once
+	static const NvU32 ALL_ROOTS = ~0U;
 
 	NvU32 allocate8Children();
+	// returns 8 children to the free list - allocate8Children() will reuse them before growing the array
+	void free8Children(NvU32 firstChildIndex);
+	// size of children array including free elements. getNUsedChildren() counts only the ones in the tree
+	NvU32 getNChildren() const { return m_pChildren.size(); }
+	NvU32 getNUsedChildren() const { return m_nUsedChildren; }
+	// allocating memory for many children at once is much cheaper than growing 8 children at a time
+	void reserveChildren(NvU32 nChildren) { m_pChildren.reserve(nChildren); }
+	void setUseHugePages(bool useHugePages) { m_pChildren.setUseHugePages(useHugePages); }
+	const BlockArray<GridElem>& getChildren() const { return m_pChildren; }
+	// writes everything to sPath (through a temporary file, so a snapshot that is currently mapped can be
+	// replaced). header comes with World fields filled, Storage fills the rest
+	bool saveSnapshot(const char* sPath, SnapshotHeader header) const;
+	// Storage must be empty. roots are read, children are mapped from the file. header gets World fields
+	bool loadSnapshot(const char* sPath, SnapshotHeader& header);
+	// renumbers groups of children in depth-first order (which for octree is morton order), so traversal reads
+	// the children array front to back. free elements are dropped. references to children and child indices
+	// kept outside of Storage become invalid
+	void compact();
+	// fraction of groups of children that are not stored right after the group visited before them in
+	// depth-first order. 0 right after compact(), close to 1 when groups are scattered
+	float computeFragmentation() const;
+
+	// switching to GRID_LAYOUT_SOA copies all children into GridSoA. after that Storage keeps it up to date as
+	// children are split. in that mode timePhase of children must be changed through Storage::setTimePhase(). it also
+	// marks the element changed for World::updatePoints()
+	void setLayout(GridLayout layout);
+	GridLayout getLayout() const { return m_layout; }
+	const GridSoA& getSoA() const { nvAssert(m_layout == GRID_LAYOUT_SOA); return m_soa; }
+	void setTimePhase(GridElem& elem, const float2& timePhase);
+	// copies children [firstChildIndex, firstChildIndex + n) to GridSoA - does nothing in GRID_LAYOUT_AOS
+	void updateSoA(NvU32 firstChildIndex, NvU32 n);
+	// incremented every time the tree changes shape - anything cached per leaf must be rebuilt when it changes
+	NvU32 getTopologyVersion() const { return m_topologyVersion; }
+	static float3Box computeChildBox(const float3Box& box, NvU32 uChild)
+	{
+		return computeChildBox(box, (box[0] + box[1]) / 2.f, uChild);
+	}
+	static float3Box computeChildBox(const float3Box& box, const float3& vMiddle, NvU32 uChild)
+	{
+		float3Box childBox;
+		for (NvU32 uDim = 0; uDim < 3; ++uDim)
+		{
+			bool isUpper = (uChild >> uDim) & 1;
+			childBox[0][uDim] = isUpper ? vMiddle[uDim] : box[0][uDim];
+			childBox[1][uDim] = isUpper ? box[1][uDim] : vMiddle[uDim];
+		}
+		return childBox;
+	}
+	// box of any element computed by walking up to its root - the same box visit() gives
+	float3Box computeBox(const GridElem& elem) const;
+
+	// with time grids every leaf owns a grid in LeafTimeGrids and interior nodes own none. split() copies the grid of
+	// the parent to its children, merge() averages grids of the children. not saved in snapshots
+	void setUseTimeGrids(bool useTimeGrids);
+	bool getUseTimeGrids() const { return m_useTimeGrids; }
+	LeafTimeGrids& accessTimeGrids() { return m_timeGrids; }
+	const LeafTimeGrids& getTimeGrids() const { return m_timeGrids; }
+	NvU32 getRootTimeGrid(NvU32 rootIndex) const { return m_rootTimeGrids[rootIndex]; }
+	NvU32 getChildTimeGrid(NvU32 childIndex) const { return m_childTimeGrids[childIndex]; }
+	NvU32 getTimeGrid(const GridElem& elem) const
+	{
+		return elem.isRoot() ? m_rootTimeGrids[getRootIndex(elem)] : m_childTimeGrids[getChildIndex(elem)];
+	}
+	// called by GridElem::split() and GridElem::merge() - elem already has children and they are still allocated
+	void splitTimeGrid(const GridElem& elem);
+	void mergeTimeGrids(const GridElem& elem);
+
+	// change tracking for incremental consumers like the viewer. elements are numbered roots first, then children
+	// (see getElemSlot()). split and merge record the parent and its 8 children, allocateRoot() and compact()
+	// record everything. nothing is recorded until tracking is enabled
+	void setTrackChanges(bool trackChanges) { m_trackChanges = trackChanges; m_changedSlots.clear(); m_areAllChanged = true; }
+	bool isTrackingChanges() const { return m_trackChanges; }
+	NvU32 getNElemSlots() const { return getNRoots() + getNChildren(); }
+	NvU32 getElemSlot(const GridElem& elem) const { return elem.isRoot() ? getRootIndex(elem) : getNRoots() + getChildIndex(elem); }
+	void markChanged(NvU32 firstSlot, NvU32 nSlots);
+	// moves recorded slots to the caller (unsorted, may repeat). returns true if everything has to be treated as changed
+	bool takeChanges(std::vector<NvU32>& slots);
+
 	inline NvU32 getRootIndex(const GridElem& elem) const { return (NvU32)(&elem - &m_pRoots[0]); }
 	inline NvU32 getChildIndex(const GridElem& elem) const
 	{
@@ -58,27 +170,281 @@ struct Storage
 	struct IVisitor
 	{
 		virtual bool notifyEntering(GridElem& elem, const float3Box& box) = 0;
-		virtual void notifyLeaving(GridElem& elem, const float3Box& box) { }
+		virtual void notifyLeaving(GridElem&, const float3Box&) { }
 	};
 	inline void visit(NvU32 rootIndex, IVisitor& visitor)
 	{
+		WAVE_TRACE_SCOPE("visit");
 		visitInternal(&m_pRoots[rootIndex], m_pRootBoxes[rootIndex], visitor);
 	}
+	inline void visitSubtree(GridElem& elem, const float3Box& box, IVisitor& visitor)
+	{
+		WAVE_TRACE_SCOPE("visitSubtree");
+		visitInternal(&elem, box, visitor);
+	}
+
+	// visitors known at compile time derive from this instead of IVisitor. their callbacks are not virtual
+	// and get inlined into the traversal loop. anything derived from IVisitor still takes the virtual overloads above
+	struct InlineVisitor
+	{
+		void notifyLeaving(GridElem&, const float3Box&) { }
+	};
+	template <class VISITOR, class = typename std::enable_if<!std::is_base_of<IVisitor, VISITOR>::value>::type>
+	inline void visit(NvU32 rootIndex, VISITOR& visitor)
+	{
+		visitSubtree(m_pRoots[rootIndex], m_pRootBoxes[rootIndex], visitor);
+	}
+	// same order of callbacks as with IVisitor, but the walk uses explicit stack instead of recursion
+	template <class VISITOR, class = typename std::enable_if<!std::is_base_of<IVisitor, VISITOR>::value>::type>
+	void visitSubtree(GridElem& elem, const float3Box& box, VISITOR& visitor)
+	{
+		WAVE_TRACE_SCOPE("visitSubtree");
+		WAVE_COUNT(m_nEntered, 1);
+		if (!visitor.notifyEntering(elem, box))
+			return;
+		if (!elem.hasChildren())
+		{
+			WAVE_COUNT(m_nLeft, 1);
+			visitor.notifyLeaving(elem, box);
+			return;
+		}
+		struct StackEntry
+		{
+			GridElem* m_pElem;
+			GridElem* m_pFirstChild;
+			float3Box m_box;
+			float3 m_vMiddle;
+			NvU32 m_uNextChild;
+		};
+		StackEntry stack[MAX_DEPTH];
+		NvU64 nEntered = 0, nLeft = 1; // counted locally - the loop is too hot for thread-local counters
+		stack[0] = { &elem, &m_pChildren[elem.getFirstChild()], box, (box[0] + box[1]) / 2.f, 0 };
+		for (NvU32 depth = 0; ; )
+		{
+			StackEntry& top = stack[depth];
+			if (top.m_uNextChild == 8)
+			{
+				visitor.notifyLeaving(*top.m_pElem, top.m_box);
+				if (depth-- == 0)
+					break;
+				++nLeft;
+				continue;
+			}
+			NvU32 uChild = top.m_uNextChild++;
+			GridElem& child = top.m_pFirstChild[uChild]; // 8 children are always in the same block
+			float3Box childBox = computeChildBox(top.m_box, top.m_vMiddle, uChild);
+			++nEntered;
+			if (!visitor.notifyEntering(child, childBox))
+				continue;
+			if (child.hasChildren())
+			{
+				nvAssert(depth + 1 < MAX_DEPTH);
+				stack[++depth] = { &child, &m_pChildren[child.getFirstChild()], childBox, (childBox[0] + childBox[1]) / 2.f, 0 };
+			}
+			else
+			{
+				++nLeft;
+				visitor.notifyLeaving(child, childBox);
+			}
+		}
+		WAVE_COUNT(m_nEntered, nEntered);
+		WAVE_COUNT(m_nLeft, nLeft);
+	}
+	// boxes are float, they can't be split more times than that anyway
+	static const NvU32 MAX_DEPTH = 32;
+
+	// pieces of the tree that can be processed independently by different threads
+	struct Subtree
+	{
+		GridElem* m_pElem;
+		float3Box m_box;
+	};
+	// subtrees starting at given depth below the root (and leaves that are above that depth) are appended to subtrees
+	void collectSubtrees(NvU32 rootIndex, NvU32 depth, std::vector<Subtree>& subtrees);
+	// the same pieces as collectSubtrees(), but the tree is split up by the workers: every node above depth is a task
+	// that calls pre(elem, box), submits its 8 children as tasks of their own, waits for them and then calls
+	// post(elem, box). the pieces go to subtree(elem, box). without a pool it is a plain depth-first walk
+	template <class PRE, class SUBTREE, class POST>
+	void forkSubtrees(ThreadPool* pPool, GridElem& elem, const float3Box& box, NvU32 depth, const PRE& pre,
+		const SUBTREE& subtree, const POST& post)
+	{
+		if (depth == 0 || !elem.hasChildren())
+		{
+			subtree(elem, box);
+			return;
+		}
+		pre(elem, box);
+		parallelFor(pPool, 8, [&](NvU32 uChild)
+		{
+			forkSubtrees(pPool, m_pChildren[elem.getFirstChild() + uChild], computeChildBox(box, uChild), depth - 1, pre, subtree, post);
+		});
+		post(elem, box);
+	}
 
 private:
 	void visitInternal(GridElem* pElem, const float3Box& box, IVisitor& visitor);
+	void collectSubtreesInternal(GridElem& elem, const float3Box& box, NvU32 depth, std::vector<Subtree>& subtrees);
+	void compactInternal(GridElem& elem, NvU32 elemIndex, BlockArray<GridElem>& children, std::vector<NvU32>& childTimeGrids);
+	NvU32& accessTimeGrid(const GridElem& elem)
+	{
+		return elem.isRoot() ? m_rootTimeGrids[getRootIndex(elem)] : m_childTimeGrids[getChildIndex(elem)];
+	}
+	void countJumps(const GridElem& elem, NvU32& prevFirstChild, NvU32& nGroups, NvU32& nJumps) const;
 	std::vector<GridElem> m_pRoots; 
 	std::vector<float3Box> m_pRootBoxes;
 	BlockArray<GridElem> m_pChildren; // this is primary grid everyone is working with
 	NvU32 m_firstFreeChild = ~0;
+	NvU32 m_nUsedChildren = 0;
+	NvU32 m_topologyVersion = 0;
+	GridLayout m_layout = GRID_LAYOUT_AOS;
+	GridSoA m_soa;
+	bool m_trackChanges = false, m_areAllChanged = true;
+	std::vector<NvU32> m_changedSlots;
+	bool m_useTimeGrids = false;
+	LeafTimeGrids m_timeGrids;
+	std::vector<NvU32> m_rootTimeGrids, m_childTimeGrids; // LeafTimeGrids::INVALID_GRID for interior and free elements
+};
+
+#include "linearStorage.h"
+
+// which storage World keeps its tree in
+enum StorageBackend
+{
+	STORAGE_POINTER, // Storage - interior nodes are kept, children are referenced by index
+	STORAGE_LINEAR,  // LinearStorage - only leaves are kept, sorted by morton code
+};
+
+// error-driven refinement. error of a leaf is |timePhase| * width of its box. leaves with error above
+// m_fRefineError are split, 8 sibling leaves are merged if the merged leaf would have error below m_fCoarsenError.
+// m_fCoarsenError must be less than m_fRefineError, otherwise merged leaves would be split right away
+struct AdaptParams
+{
+	float m_fRefineError = 0; // 0 disables adaptation
+	float m_fCoarsenError = 0;
+	NvU32 m_maxDepth = 8;
+	// Storage::compact() is called after a pass that changed the tree if fragmentation is above this. 0 disables
+	float m_fMaxFragmentation = 0;
 };
 
 struct World
 {
-	void initialize();
+	// with nRootsPerDim > 1 the domain is tiled into nRootsPerDim^3 roots, each refined to the given depth. roots are
+	// stepped in parallel and leaves touching across root boundaries see each other (see InteractionLists). roots
+	// are numbered along morton curve, so any range of root indices is a compact piece of space.
+	// only STORAGE_POINTER can be tiled
+	void initialize(NvU32 depth = 3, StorageBackend backend = STORAGE_POINTER, NvU32 nRootsPerDim = 1);
+	StorageBackend getStorageBackend() const { return m_backend; }
+	// only affects STORAGE_POINTER. survives initialize()
+	void setStorageLayout(GridLayout layout);
 	void readPoints(std::vector<float3>& points);
+	// same lines as readPoints(), but the buffer is kept by the caller between calls: element with slot s
+	// (Storage::getElemSlot()) owns points [6 * s, 6 * s + 6), which are degenerate for interior nodes and free
+	// elements. only points of elements changed since the previous call are rewritten and their ranges returned,
+	// so the cost is proportional to the number of splits and merges. with pTimePhases the element with slot s also
+	// owns (*pTimePhases)[s] - zero for interior nodes and free elements - which is rewritten together with its points
+	struct PointRange
+	{
+		NvU32 m_firstPoint, m_nPoints;
+	};
+	void updatePoints(std::vector<float3>& points, std::vector<PointRange>& changedRanges, std::vector<float2>* pTimePhases = nullptr);
 	void makeSimulationStep();
+	// only STORAGE_POINTER can adapt. if enabled, makeSimulationStep() calls adapt() before everything else
+	void setAdaptParams(const AdaptParams& params);
+	const AdaptParams& getAdaptParams() const { return m_adaptParams; }
+	// one refine/coarsen pass over the tree. returns number of splits plus number of merges
+	NvU32 adapt();
+	// STORAGE_POINTER only. roots outside of [firstRoot, endRoot) belong to somebody else (see multiProcess.h): they
+	// are not refined by initialize() or adapt() and get no influence - getLeafInfluence() is 0 for their leaves -
+	// but their leaves are sources for the owned ones. survives initialize()
+	void setOwnedRoots(NvU32 firstRoot, NvU32 endRoot);
+	NvU32 getFirstOwnedRoot() const { return m_firstOwnedRoot; }
+	NvU32 getEndOwnedRoot() const { return mymin(m_endOwnedRoot, m_backend == STORAGE_POINTER ? m_storage.getNRoots() : 1U); }
+	// 1 means everything runs on the calling thread
+	void setNThreads(NvU32 nThreads);
+	NvU32 getNThreads() const { return m_pThreadPool ? m_pThreadPool->getNThreads() : 1; }
+	Storage& accessStorage() { return m_storage; }
+	LinearStorage& accessLinearStorage() { return m_linearStorage; }
+	FarField& accessFarField() { return m_farField; }
+	// sum of amplitude(j) / distance over all other leaves j, indexed the same way as leaves in getInteractions().
+	// far field is only computed with STORAGE_POINTER - with STORAGE_LINEAR only touching leaves are summed
+	const std::vector<double2>& getLeafInfluence() const { return m_leafInfluence; }
+	const InteractionLists& getInteractions() const { return m_interactions; }
+	// with nSamples > 0 every step samples nSamples paths from each touching leaf to each leaf and sums
+	// amplitude * weight * e^(i * action) / nSamples over them (see generatePathTime()). sample s from the u-th
+	// neighbor of a leaf uses number u * nSamples + s of that leaf from getPathRandom(). 0 turns sampling off.
+	// survives initialize()
+	void setPathSamples(NvU32 nSamples) { m_nPathSamples = nSamples; }
+	NvU32 getPathSamples() const { return m_nPathSamples; }
+	// indexed the same way as getLeafInfluence(), empty when sampling is off
+	const std::vector<double2>& getLeafPathSums() const { return m_leafPathSums; }
+	// random numbers for path sampling are addressed by (step index, leaf index, sample index), so they are
+	// the same no matter how many threads are used
+	const PathRandom& getPathRandom() const { return m_pathRandom; }
+	void setSeed(NvU64 seed) { m_pathRandom.setSeed(seed); }
+	NvU64 getStepIndex() const { return m_stepIndex; }
+	// STORAGE_POINTER only. after loading, children are paged in from the file as they are touched, so restart
+	// doesn't depend on the size of the tree. return false if the file can't be written or used
+	bool saveSnapshot(const char* sPath) const;
+	bool loadSnapshot(const char* sPath);
+	// STORAGE_POINTER only. with time grids every step adds leaf influence to slot (step index % N_TIME_SLOTS) of the
+	// time grid of each leaf and then rotates all grids by fAnglePerStep. survives initialize()
+	void setTimeGrids(bool useTimeGrids, double fAnglePerStep);
+	double getTimeGridAngle() const { return m_fTimeGridAngle; }
+	// 1 / distance and path geometry of touching pairs are kept in InteractionLists between steps instead of being
+	// computed every step. on by default, results are the same either way
+	void setUsePairCache(bool usePairCache) { m_usePairCache = usePairCache; }
+	// arithmetic and per-leaf arrays of leaf influence (see precision.h). survives initialize()
+	void setPrecision(Precision precision);
+	Precision getPrecision() const { return m_precision; }
+	// counters and timers of everything since the previous step ended (initialize() and readPoints() included),
+	// updated at the end of every makeSimulationStep(). counters stay zero in builds with WAVE_STATS=0
+	const WorldStats& getStepStats() const { return m_stepStats; }
 
 private:
+	// empty tree with the given backend
+	void reset(StorageBackend backend);
+	// readPoints() that also collects time phases of the leaves in the same order if pTimePhases isn't null
+	void readLeaves(std::vector<float3>& points, std::vector<float2>* pTimePhases);
+	void simulateStep();
+	void updateTimeGrids();
+	void finishStepStats();
+	// slots of leaves of owned roots in getInteractions()
+	void getOwnedSlots(NvU32& firstSlot, NvU32& endSlot) const;
+	// ELEMS is anything that gives access to leaves by index: Storage, LinearStorage or GridSoA. calls
+	// computeLeafInfluenceAs() with the policy of m_precision
+	template <class ELEMS>
+	void computeLeafInfluence(const ELEMS& storage, const FarField* pFarField);
+	template <class PRECISION, class ELEMS>
+	void computeLeafInfluenceAs(const ELEMS& storage, const FarField* pFarField);
+	template <class ELEMS>
+	void samplePaths(const ELEMS& storage);
+	void clearLeafArrays();
+	// leaf of getInteractions() by its leaf index - root leaves (InteractionLists::isRootLeaf()) come from m_storage
+	template <class ELEMS>
+	float3 getLeafCenter(const ELEMS& storage, NvU32 leafIndex) const;
+	template <class ELEMS>
+	float2 getLeafTimePhase(const ELEMS& storage, NvU32 leafIndex) const;
+
+	StorageBackend m_backend = STORAGE_POINTER;
+	GridLayout m_layout = GRID_LAYOUT_AOS;
+	AdaptParams m_adaptParams;
+	bool m_useTimeGrids = false;
+	double m_fTimeGridAngle = 0;
+	bool m_usePairCache = true;
+	NvU32 m_nPathSamples = 0;
+	Precision m_precision = PRECISION_MIXED;
+	NvU32 m_firstOwnedRoot = 0, m_endOwnedRoot = ~0U;
 	Storage m_storage;
+	LinearStorage m_linearStorage;
+	InteractionLists m_interactions;
+	FarField m_farField;
+	std::vector<double2> m_leafInfluence, m_leafPathSums;
+	// one set per policy, so switching precision doesn't mix types. dropped whenever interaction lists are rebuilt
+	std::tuple<LeafArrays<MixedPrecision>, LeafArrays<FloatPrecision>, LeafArrays<DoublePrecision>> m_leafArrays;
+	std::unique_ptr<ThreadPool> m_pThreadPool;
+	std::vector<NvU32> m_changedSlots;
+	PathRandom m_pathRandom;
+	NvU64 m_stepIndex = 0;
+	WorldStats m_stats, m_stepStats;
+	WaveCounters m_prevCounters;
 };